@@ -0,0 +1,116 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "ast_arena.h"
+#include "common.h"
+
+#include <algorithm> // max()
+#include <cstring> // memcpy()
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! Alignment of all allocations. Nodes hold nothing wider than pointers and doubles.
+const size_t kArenaAlignment = 2 * sizeof(void*) > sizeof(double) ? 2 * sizeof(void*) : sizeof(double);
+
+//! Rounds \a size up to a multiple of kArenaAlignment.
+inline size_t alignSize(size_t size)
+{
+	return (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ASTArena
+
+ASTArena::ASTArena(size_t blockSize)
+	: _cursor(nullptr)
+	, _end(nullptr)
+	, _blockSize(alignSize(blockSize))
+	, _firstBlockSize(0)
+	, _bytesUsed(0)
+{}
+
+ASTArena::~ASTArena()
+{
+	for (auto it = _blocks.begin(); it != _blocks.end(); ++it)
+		delete [] *it;
+}
+
+void* ASTArena::allocate(size_t size)
+{
+	size = alignSize(size);
+
+	// the strings leave the cursor unaligned
+	auto p = reinterpret_cast<char*>(alignSize(reinterpret_cast<size_t>(_cursor)));
+	if (p > _end || size > static_cast<size_t>(_end - p))
+	{
+		grow(size);
+		p = _cursor;
+	}
+
+	_bytesUsed += size + (p - _cursor);
+	_cursor = p + size;
+	return p;
+}
+
+ASTString ASTArena::intern(const char* text, size_t size)
+{
+	auto it = _strings.find(ASTString(text, size));
+	if (it != _strings.end())
+		return *it;
+
+	// the characters are not aligned, only the nodes are
+	if (size + 1 > static_cast<size_t>(_end - _cursor))
+		grow(size + 1);
+
+	auto copy = _cursor;
+	memcpy(copy, text, size);
+	copy[size] = '\0';
+	_cursor += size + 1;
+	_bytesUsed += size + 1;
+
+	ASTString interned(copy, size);
+	_strings.insert(interned);
+	return interned;
+}
+
+void ASTArena::clear()
+{
+	_strings.clear();
+	_bytesUsed = 0;
+
+	if (_blocks.empty())
+		return;
+
+	// keep the first block, so rebuilding a tree of similar size allocates nothing
+	for (auto it = _blocks.begin() + 1; it != _blocks.end(); ++it)
+		delete [] *it;
+	_blocks.resize(1);
+
+	_cursor = _blocks.front();
+	_end = _cursor + _firstBlockSize;
+}
+
+void ASTArena::grow(size_t size)
+{
+	// new[] aligns to the largest fundamental type which is enough for the nodes
+	auto blockSize = max(size, _blockSize);
+	auto block = new char[blockSize];
+
+	if (_blocks.empty())
+		_firstBlockSize = blockSize;
+
+	_blocks.push_back(block);
+	_cursor = block;
+	_end = block + blockSize;
+
+	trace("ASTArena: new block of %u bytes\n", static_cast<unsigned>(blockSize));
+}
+
+}} // chaos::cell
@@ -0,0 +1,132 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_ast_arena_H
+#define __CELL_ast_arena_H
+
+#include "boost/noncopyable.hpp"
+#include "boost/functional/hash.hpp"
+#include "boost/unordered_set.hpp"
+
+#include <cstddef> // size_t
+#include <cstring> // memcmp()
+#include <string>
+#include <vector>
+
+namespace chaos { namespace cell {
+
+//! A view of characters owned by an ASTArena. Copying it copies the view, not the characters.
+//! The characters are null terminated, so c_str() is free.
+class ASTString
+{
+public:
+	ASTString() : _data(""), _size(0) {}
+	ASTString(const char* data, size_t size) : _data(data), _size(size) {}
+
+	const char* c_str() const { return _data; }
+	const char* data() const { return _data; }
+	size_t size() const { return _size; }
+	size_t length() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	const char* begin() const { return _data; }
+	const char* end() const { return _data + _size; }
+	char operator[](size_t i) const { return _data[i]; }
+
+	//! Copies the characters.
+	std::string str() const { return std::string(_data, _size); }
+
+	//! The symbol tables of the generators are keyed by std::string.
+	operator std::string() const { return str(); }
+
+private:
+	const char* _data;
+	size_t      _size;
+};
+
+inline bool operator==(const ASTString& a, const ASTString& b)
+{
+	// strings interned in the same arena compare by address
+	return a.size() == b.size() && (a.data() == b.data() || std::memcmp(a.data(), b.data(), a.size()) == 0);
+}
+
+inline bool operator==(const ASTString& a, const std::string& b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator==(const ASTString& a, const char* b)
+{
+	return std::strcmp(a.c_str(), b) == 0;
+}
+
+inline bool operator==(const std::string& a, const ASTString& b) { return b == a; }
+inline bool operator==(const char* a, const ASTString& b) { return b == a; }
+inline bool operator!=(const ASTString& a, const ASTString& b) { return !(a == b); }
+inline bool operator!=(const ASTString& a, const std::string& b) { return !(a == b); }
+inline bool operator!=(const ASTString& a, const char* b) { return !(a == b); }
+inline bool operator!=(const std::string& a, const ASTString& b) { return !(b == a); }
+inline bool operator!=(const char* a, const ASTString& b) { return !(b == a); }
+
+//! Hashes the characters, for the interning table.
+inline size_t hash_value(const ASTString& s)
+{
+	return boost::hash_range(s.begin(), s.end());
+}
+
+//! Bump allocator owning the nodes and the strings of one AST.
+//! Memory is handed out from large blocks and is only released all at once,
+//! so building and tearing down a tree costs a handful of allocations.
+//! The arena never runs destructors, the owner of the objects must do that.
+class ASTArena : boost::noncopyable
+{
+public:
+	//! Default size of the blocks, large enough for the nodes of a typical script.
+	static const size_t kDefaultBlockSize = 64 * 1024;
+
+	//! Constructs an empty arena. No memory is allocated until the first request.
+	explicit ASTArena(size_t blockSize = kDefaultBlockSize);
+
+	//! Releases all memory.
+	~ASTArena();
+
+	//! Returns \a size bytes suitably aligned for any node.
+	void* allocate(size_t size);
+
+	//! Returns the single copy of the \a size characters at \a text owned by the arena.
+	//! The characters stay valid until clear() is called.
+	ASTString intern(const char* text, size_t size);
+
+	//! Returns the single copy of \a text owned by the arena.
+	ASTString intern(const std::string& text) { return intern(text.data(), text.size()); }
+
+	//! Releases all objects and strings. The first block is kept for reuse.
+	void clear();
+
+	//! Returns the number of bytes handed out since the last clear().
+	size_t bytesUsed() const { return _bytesUsed; }
+
+private:
+	//! Allocates a new block which can hold at least \a size bytes.
+	void grow(size_t size);
+
+private:
+	typedef boost::unordered_set<ASTString> StringSet;
+
+	std::vector<char*> _blocks; //! the allocated blocks, the current one is last
+	char*     _cursor;          //! the first free byte of the current block
+	char*     _end;             //! the end of the current block
+	size_t    _blockSize;       //! the size of regular blocks
+	size_t    _firstBlockSize;  //! the size of the block kept by clear()
+	size_t    _bytesUsed;       //! statistics
+	StringSet _strings;         //! views of the interned strings, the characters live in the blocks
+};
+
+}} // chaos::cell
+
+#endif // __CELL_ast_arena_H
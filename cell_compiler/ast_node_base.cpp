@@ -8,6 +8,7 @@
 
 #include "ast_node_base.h"
 #include "ast_visitor.h"
+#include "ast_tree.h"
 #include "common.h"
 
 namespace chaos { namespace cell {
@@ -18,17 +19,13 @@ namespace chaos { namespace cell {
 ASTContext::~ASTContext()
 {}
 
-////////////////////////////////////////////////////////////////////////////////
-// IAcceptor
-
-IAcceptor::~IAcceptor()
-{}
-
 ////////////////////////////////////////////////////////////////////////////////
 // ASTNode
 
 ASTNode::ASTNode()
-	: _rid(RID_START_SYMBOL)
+	: _arena(nullptr)
+	, _rid(RID_START_SYMBOL)
+	, _where(nullptr)
 	, _index(-1)
 	, _childCount(0)
 	, _parent(nullptr)
@@ -37,10 +34,14 @@ ASTNode::ASTNode()
 	, _firstChild(nullptr)
 	, _lastChild(nullptr)
 	, _isVisitable(1)
+	, _isArenaOwned(0)
+	, _kind(NK_NONE)
 {}
 
-ASTNode::ASTNode(ASTNode* parent, const TreeIterator& it)
-	: _rid(static_cast<RuleID>(it->value.id().to_long()))
+ASTNode::ASTNode(ASTNode* parent, const NodeSource& source)
+	: _arena(parent ? parent->_arena : nullptr)
+	, _rid(source.rid)
+	, _where(source.first)
 	, _index(-1)
 	, _childCount(0)
 	, _parent(parent)
@@ -49,10 +50,13 @@ ASTNode::ASTNode(ASTNode* parent, const TreeIterator& it)
 	, _firstChild(nullptr)
 	, _lastChild(nullptr)
 	, _isVisitable(1)
+	, _isArenaOwned(1)
+	, _kind(NK_NONE)
 {
+	assert_msg(_arena != nullptr, "Nodes must be built under a node with an arena\n");
+
 	if (parent)
 		parent->addChild(this);
-	_pos = it->value.begin().get_position();
 }
 
 ASTNode::~ASTNode()
@@ -66,13 +70,78 @@ void ASTNode::destroy()
 	while (child)
 	{
 		auto next = child->_nextSibling;
-		delete child;
+		destroyNode(child);
 		child = next;
 	}
 	_childCount = 0;
 	_firstChild = _lastChild = nullptr;
 }
 
+void ASTNode::destroyNode(ASTNode* node)
+{
+	if (node->_isArenaOwned)
+		node->~ASTNode(); // the arena releases the memory
+	else
+		delete node;
+}
+
+void ASTNode::unlink(ASTNode* child)
+{
+	assert_msg(child->_parent == this, "Unlinking a node from another parent\n");
+
+	if (child->_previousSibling)
+		child->_previousSibling->_nextSibling = child->_nextSibling;
+	else
+		_firstChild = child->_nextSibling;
+
+	if (child->_nextSibling)
+		child->_nextSibling->_previousSibling = child->_previousSibling;
+	else
+		_lastChild = child->_previousSibling;
+
+	for (auto next = child->_nextSibling; next != nullptr; next = next->_nextSibling)
+		--next->_index;
+
+	--_childCount;
+	child->_parent = child->_previousSibling = child->_nextSibling = nullptr;
+	child->_index = -1;
+}
+
+void ASTNode::setText(const NodeSource& source)
+{
+	// straight from the source, without a temporary string
+	_text = _arena->intern(source.first, source.last - source.first);
+}
+
+ParsePosition ASTNode::parsePosition() const
+{
+	// only errors ask for positions, they are not worth keeping in every node
+	if (_where)
+	{
+		for (auto node = _parent; node; node = node->_parent)
+		{
+			if (node->kind() == NK_ASTTree)
+				return static_cast<const ASTTree*>(node)->source().position(_where);
+		}
+	}
+
+	return ParsePosition();
+}
+
+void ASTNode::moveSource(const char* from, const char* to)
+{
+	if (_where)
+		_where = to + (_where - from);
+
+	for (auto child = _firstChild; child; child = child->_nextSibling)
+		child->moveSource(from, to);
+}
+
+ASTString ASTNode::intern(const std::string& text)
+{
+	return _arena->intern(text);
+}
+
 void ASTNode::addChild(ASTNode* node)
 {
 	if (node)
@@ -87,6 +156,35 @@ void ASTNode::addChild(ASTNode* node)
 	}
 }
 
+void ASTNode::replaceChild(ASTNode* child, ASTNode* node)
+{
+	node->_parent->unlink(node);
+
+	node->_parent = this;
+	node->_index = child->_index;
+	node->_previousSibling = child->_previousSibling;
+	node->_nextSibling = child->_nextSibling;
+
+	if (node->_previousSibling)
+		node->_previousSibling->_nextSibling = node;
+	else
+		_firstChild = node;
+
+	if (node->_nextSibling)
+		node->_nextSibling->_previousSibling = node;
+	else
+		_lastChild = node;
+
+	child->_parent = child->_previousSibling = child->_nextSibling = nullptr;
+	destroyNode(child);
+}
+
+void ASTNode::removeChild(ASTNode* child)
+{
+	unlink(child);
+	destroyNode(child);
+}
+
 ASTNode* ASTNode::childAt(int index) const
 {
 	for (auto child = _firstChild; child != nullptr; child = child->_nextSibling, --index)
@@ -98,10 +196,46 @@ ASTNode* ASTNode::childAt(int index) const
 	return nullptr;
 }
 
+//! Called for non-terminal nodes.
+template<class Node>
+inline bool acceptNode(Node& node, ASTVisitor& visitor, ASTContext* ctx, IntToType<false>)
+{
+	if (visitor.preVisit(node, ctx))
+	{
+		for (auto child = node.firstChild(); child != nullptr; child = child->nextSibling())
+		{
+			if (!child->accept(visitor, ctx))
+				break;
+		}
+	}
+	return visitor.visit(node, ctx);
+}
+
+//! Called for terminal nodes.
+template<class Node>
+inline bool acceptNode(Node& node, ASTVisitor& visitor, ASTContext* ctx, IntToType<true>)
+{
+	return visitor.visit(node, ctx);
+}
+
 bool ASTNode::accept(ASTVisitor& visitor, ASTContext* ctx)
 {
-	if (_isVisitable && _acceptor.get())
-		return _acceptor->accept(visitor, ctx);
+	if (_isVisitable)
+	{
+		// resolve the concrete class here, so only the visitor methods are virtual
+		switch (_kind)
+		{
+#define CELL_ACCEPT_NODE(node) \
+		case NK_##node: \
+			return acceptNode(static_cast<node&>(*this), visitor, ctx, IntToType<node::isTerminal>());
+
+		CELL_AST_NODES( CELL_ACCEPT_NODE )
+#undef CELL_ACCEPT_NODE
+
+		default:
+			break;
+		}
+	}
 
 	trace("Skipping node: [%p]\n", this);
 	return true;
@@ -9,9 +9,10 @@
 #ifndef __CELL_ast_node_base_H
 #define __CELL_ast_node_base_H
 
-#include "spirit.h" // TreeIterator
+#include "spirit.h" // ParsePosition
 #include "rules.h"
 #include "types.h"
+#include "ast_arena.h"
 #include "boost/noncopyable.hpp"
 
 #include <string>
@@ -23,6 +24,84 @@ namespace chaos { namespace cell {
 class ASTVisitor;
 class ASTNode;
 
+//! All concrete node classes.
+#define CELL_AST_NODES(X) \
+	X( ASTTree ) \
+	X( StartSymbolNode ) \
+	X( TranslationUnitNode ) \
+	X( FunctionDefinitionNode ) \
+	X( FunctionModifierNode ) \
+	X( FunctionDeclaratorNode ) \
+	X( ParameterListNode ) \
+	X( ParameterNode ) \
+	X( IdentifierNode ) \
+	X( SystemIdentifierNode ) \
+	X( IntegerLiteralNode ) \
+	X( RealLiteralNode ) \
+	X( TypeSpecifierNode ) \
+	X( TypeModifierNode ) \
+	X( ArgumentListNode ) \
+	X( PrimaryExpressionNode ) \
+	X( PrimaryExpressionHelperNode ) \
+	X( ParenthesizedExpressionNode ) \
+	X( MemberAccessNode ) \
+	X( InvocationNode ) \
+	X( ElementAccessNode ) \
+	X( ObjectCreationExpressionNode ) \
+	X( PostfixExpressionNode ) \
+	X( UnaryExpressionNode ) \
+	X( MultiplicativeExpressionNode ) \
+	X( AdditiveExpressionNode ) \
+	X( ShiftExpressionNode ) \
+	X( RelationalExpressionNode ) \
+	X( EqualityExpressionNode ) \
+	X( AndExpressionNode ) \
+	X( ExclusiveOrExpressionNode ) \
+	X( InclusiveOrExpressionNode ) \
+	X( ConditionalAndExpressionNode ) \
+	X( ConditionalOrExpressionNode ) \
+	X( ConditionalExpressionNode ) \
+	X( AssignmentNode ) \
+	X( ArrayCreationExpressionNode ) \
+	X( BlockNode ) \
+	X( StatementListNode ) \
+	X( EmptyStatementNode ) \
+	X( VariableDeclarationNode ) \
+	X( VariableDeclaratorListNode ) \
+	X( VariableDeclaratorNode ) \
+	X( ExpressionStatementNode ) \
+	X( IfStatementNode ) \
+	X( ElseStatementNode ) \
+	X( WhileStatementNode ) \
+	X( StatementExpressionListNode ) \
+	X( ArrayDeclaratorNode ) \
+	X( ArraySpecifierNode ) \
+	X( QuitStatementNode ) \
+	X( ReturnStatementNode ) \
+	X( QualifiedIdentifierNode )
+
+#define CELL_FORWARD_DECLARE_NODE(node) class node;
+	CELL_AST_NODES( CELL_FORWARD_DECLARE_NODE )
+#undef CELL_FORWARD_DECLARE_NODE
+
+//! Identifies the concrete class of a node. ASTNode::accept() switches on it
+//! to call the visitor methods for that class.
+enum NodeKind
+{
+	NK_NONE, //! Abstract bases.
+#define CELL_NODE_KIND(node) NK_##node,
+	CELL_AST_NODES( CELL_NODE_KIND )
+#undef CELL_NODE_KIND
+	NODE_KIND_COUNT
+};
+
+//! Maps a node class to its kind.
+template<class Node> struct NodeKindOf;
+
+#define CELL_NODE_KIND_OF(node) template<> struct NodeKindOf<node> { enum { value = NK_##node }; };
+	CELL_AST_NODES( CELL_NODE_KIND_OF )
+#undef CELL_NODE_KIND_OF
+
 //! Transforms an integer constant to a type.
 template<int N> struct IntToType { enum { value = N }; };
 
@@ -49,69 +128,6 @@ inline Context context_cast(ASTContext* ctx)
 	return static_cast<Context>(ctx);
 }
 
-//! Defines an interface for visitable classes.
-class IAcceptor
-{
-public:
-	//! Destroys the acceptor.
-	virtual ~IAcceptor() = 0;
-
-	//! Accepts the specified visitor.
-	//! Returns \a true if the specified visitor was accepted, otherwise \a false.
-	virtual bool accept(ASTVisitor& visitor, ASTContext* ctx) const = 0;
-};
-
-//! \IAcceptor adapter.
-template<class Node, bool IsTerminal>
-class Acceptor : public IAcceptor
-{
-public:
-	typedef Node NodeType;
-	
-	//! Accept tags
-	typedef IntToType<true> AcceptTerminal;
-	typedef IntToType<false> AcceptNonTerminal;
-
-	//! Creates a new acceptor with the specified \a node.
-	Acceptor(Node& node) : _node(node)
-	{}
-
-	//! Destroys this acceptor.
-	virtual ~Acceptor()
-	{}
-
-	//! Reimplemented from IAcceptor::accept().
-	virtual bool accept(ASTVisitor& visitor, ASTContext* ctx) const
-	{
-		return accept(visitor, ctx, IntToType<IsTerminal>());
-	}
-
-private:
-	//! Called for non-terminal nodes.
-	bool accept(ASTVisitor& visitor, ASTContext* ctx, AcceptNonTerminal) const
-	{
-		if (visitor.preVisit(_node, ctx))
-		{
-			for (auto child = _node.firstChild(); child != nullptr; child = child->nextSibling())
-			{
-				if (!child->accept(visitor, ctx))
-					break;
-			}
-		}
-		return visitor.visit(_node, ctx);
-	}
-
-	//! Called for terminal nodes.
-	bool accept(ASTVisitor& visitor, ASTContext* ctx, AcceptTerminal) const
-	{
-		return visitor.visit(_node, ctx);
-	}
-
-private:
-	//! The wrapped node which would accept the visitor.
-	Node& _node;
-};
-
 //! Thrown when trying to read an empty tag.
 class TagError : public std::logic_error
 {
@@ -120,6 +136,16 @@ public:
 	{}
 };
 
+//! What a node is built from: the rule it represents and the matched text.
+//! The text points into the source of the tree, which gives the position of the
+//! node. Filled in from a Spirit parse tree or by the Parser.
+struct NodeSource
+{
+	RuleID      rid;
+	const char* first; //! Null for the nodes which have no position.
+	const char* last;
+};
+
 //! Base class for all AST nodes.
 class ASTNode : boost::noncopyable
 {
@@ -127,14 +153,30 @@ public:
 	//! Constructs an empty node.
 	ASTNode();
 
-	//! Constructs a new node from a Spirit parse iterator.
-	ASTNode(ASTNode* parent, const TreeIterator& it);
+	//! Constructs a new node from the parsed \a source.
+	//! The node must be allocated from the arena of its \a parent.
+	ASTNode(ASTNode* parent, const NodeSource& source);
 
 	//! Class destructor.
 	virtual ~ASTNode() = 0;
 
+	//! Allocates a node in \a arena.
+	static void* operator new(size_t size, ASTArena& arena) { return arena.allocate(size); }
+
+	//! Called if the constructor of a node allocated in \a arena throws. The arena keeps the memory.
+	static void operator delete(void*, ASTArena&) {}
+
+	//! Allocates a node on the heap.
+	static void* operator new(size_t size) { return ::operator new(size); }
+
+	//! Deletes a node allocated on the heap.
+	static void operator delete(void* p) { ::operator delete(p); }
+
+	//! Gets the arena which holds the child nodes. Null if nodes cannot be built under this node.
+	ASTArena* arena() const { return _arena; }
+
 	//! Gets the text data of this node.
-	const std::string& text() const { return _text; }
+	const ASTString& text() const { return _text; }
 
 	//! Gets the index of this node.
 	int index() const { return _index; }
@@ -163,6 +205,13 @@ public:
 	//! Appends the \a node to the list of its children.
 	void addChild(ASTNode* node);
 
+	//! Puts \a node in place of \a child and destroys \a child. \a node is
+	//! unlinked from its parent first, so it may be taken from below \a child.
+	void replaceChild(ASTNode* child, ASTNode* node);
+
+	//! Unlinks \a child and destroys it.
+	void removeChild(ASTNode* child);
+
 	//! Returns the child node at the specified \a index.
 	ASTNode* childAt(int index) const;
 
@@ -172,6 +221,9 @@ public:
 	//! Accepts the specified visitor.
 	bool accept(ASTVisitor& visitor, ASTContext* ctx = 0);
 
+	//! Returns the concrete class of this node.
+	NodeKind kind() const { return static_cast<NodeKind>(_kind); }
+
 	//! Determines if this node accepts visitors.
 	bool isVisitable() const { return _isVisitable; }
 
@@ -204,12 +256,32 @@ public:
 	}
 
 	//! Return the entire whole parse position - filename + line number + column number.
-	const ParsePosition& parsePosition() const { return _pos; }
+	//! Computed from the source of the enclosing ASTTree.
+	ParsePosition parsePosition() const;
 
 protected:
 	//! Destroys the node deleting all its child nodes.
 	void destroy();
 
+	//! Unlinks \a child from the children of this node.
+	void unlink(ASTNode* child);
+
+	//! Destroys \a node, which is not linked to a parent any more.
+	static void destroyNode(ASTNode* node);
+
+	//! Makes this node report the position of \a node.
+	void setPosition(const ASTNode& node) { _where = node._where; }
+
+	//! Moves the positions of this node and its descendants from the source
+	//! text at \a from to the same text at \a to.
+	void moveSource(const char* from, const char* to);
+
+	//! Sets the text data to the matched text of \a source.
+	void setText(const NodeSource& source);
+
+	//! Returns the copy of \a text shared by the whole tree.
+	ASTString intern(const std::string& text);
+
 	//! Base interface for node tags.
 	struct Tag
 	{
@@ -232,13 +304,12 @@ protected:
 	}
 
 protected:
-	typedef std::auto_ptr<IAcceptor> AcceptorPtr;
 	typedef std::auto_ptr<Tag>       TagPtr;
 
-	AcceptorPtr   _acceptor;
+	ASTArena*     _arena;
 	RuleID        _rid;
-	std::string   _text;
-	ParsePosition _pos;
+	ASTString     _text; //! Interned in the arena.
+	const char*   _where; //! Start of the match in the source of the tree.
 	int           _index;
 	int           _childCount;
 	ASTNode*      _parent;
@@ -247,7 +318,9 @@ protected:
 	ASTNode*      _firstChild;
 	ASTNode*      _lastChild;
 	unsigned      _isVisitable : 1;
-	unsigned      _unused      : 31;
+	unsigned      _isArenaOwned : 1; //! Set if the memory belongs to the arena of the parent.
+	unsigned      _kind        : 8;  //! The NodeKind, set by ASTNodeBase.
+	unsigned      _unused      : 22;
 	TagPtr        _tag;
 };
 
@@ -255,30 +328,29 @@ protected:
 template<class T, class Base, bool IsTerminal>
 class ASTNodeBase : public Base
 {
-protected:
-	//! The concrete acceptor type that will be used for this node.
-	typedef Acceptor<T, IsTerminal> AcceptorType;
-
 public:
+	//! Terminal nodes are visited without their children.
+	enum { isTerminal = IsTerminal };
+
 	//! Default constructor.
 	ASTNodeBase()
 	{
-		makeAcceptor();
+		setKind();
 	}
 	
-	//! Constructs a new node from the given spirit node.
-	ASTNodeBase(ASTNode* parent, const TreeIterator& it)
-		: Base(parent, it)
+	//! Constructs a new node from the parsed source.
+	ASTNodeBase(ASTNode* parent, const NodeSource& source)
+		: Base(parent, source)
 	{
-		makeAcceptor();
+		setKind();
 	}
 
 private:
-	//! Initializes the acceptor of the concrete node.
-	void makeAcceptor()
+	//! Records the concrete class for ASTNode::accept().
+	//! Bases run first, so the most derived class wins.
+	void setKind()
 	{
-		T& self = static_cast<T&>(*this);
-		_acceptor.reset(new AcceptorType(self));
+		_kind = NodeKindOf<T>::value;
 	}
 };
 
@@ -294,9 +366,9 @@ public:
 	TerminalNode()
 	{}
 
-	//! Constructs a new node from the given spirit node.
-	TerminalNode(ASTNode* parent, const TreeIterator& it)
-		: ASTNodeBase(parent, it)
+	//! Constructs a new node from the parsed source.
+	TerminalNode(ASTNode* parent, const NodeSource& source)
+		: ASTNodeBase(parent, source)
 	{}
 };
 
@@ -312,9 +384,9 @@ public:
 	NonTerminalNode()
 	{}
 
-	//! Constructs a new node from the given spirit node.
-	NonTerminalNode(ASTNode* parent, const TreeIterator& it)
-		: ASTNodeBase(parent, it)
+	//! Constructs a new node from the parsed source.
+	NonTerminalNode(ASTNode* parent, const NodeSource& source)
+		: ASTNodeBase(parent, source)
 	{}
 };
 
@@ -9,6 +9,7 @@
 #include "ast_nodes.h"
 #include "ast_visitor.h"
 #include "token_parsers.h"
+#include "string_utils.h"
 
 namespace chaos { namespace cell {
 
@@ -17,16 +18,27 @@ using namespace std;
 ////////////////////////////////////////////////////////////////////////////////
 // Node implementation macros
 
+//! Returns the source of a \a rid node built by the compiler, it has no text of its own.
+static NodeSource builtSource(RuleID rid)
+{
+	static const char kNoText[] = "";
+
+	NodeSource source;
+	source.rid = rid;
+	source.first = source.last = kNoText;
+	return source;
+}
+
 #define IMPLEMENT_NODE( node )\
-	node::node(ASTNode* parent, const TreeIterator& it) : MyType(parent, it) {}\
+	node::node(ASTNode* parent, const NodeSource& source) : MyType(parent, source) {}\
 	node::~node() {}
 
 ////////////////////////////////////////////////////////////////////////////////
 
-ExpressionBase::ExpressionBase(ASTNode* parent, const TreeIterator& it)
-	: ASTNode(parent, it)
+ExpressionBase::ExpressionBase(ASTNode* parent, const NodeSource& source)
+	: ASTNode(parent, source)
 {
-	_text.assign(it->value.begin(), it->value.end());
+	setText(source);
 	_operator = cell::getOperator(_text);
 }
 
@@ -37,8 +49,8 @@ ExpressionBase::~ExpressionBase()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-UnaryExpressionBase::UnaryExpressionBase(ASTNode* parent, const TreeIterator& it)
-	: ExpressionBase(parent, it)
+UnaryExpressionBase::UnaryExpressionBase(ASTNode* parent, const NodeSource& source)
+	: ExpressionBase(parent, source)
 {}
 
 UnaryExpressionBase::~UnaryExpressionBase()
@@ -48,8 +60,8 @@ UnaryExpressionBase::~UnaryExpressionBase()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-BinaryExpressionBase::BinaryExpressionBase(ASTNode* parent, const TreeIterator& it)
-	: ExpressionBase(parent, it)
+BinaryExpressionBase::BinaryExpressionBase(ASTNode* parent, const NodeSource& source)
+	: ExpressionBase(parent, source)
 {}
 
 BinaryExpressionBase::~BinaryExpressionBase()
@@ -59,11 +71,14 @@ BinaryExpressionBase::~BinaryExpressionBase()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-IdentifierNode::IdentifierNode(ASTNode* parent, const TreeIterator& it)
-	: MyType(parent, it)
+IdentifierNode::IdentifierNode(ASTNode* parent, const NodeSource& source)
+	: MyType(parent, source)
 {
-	_text.assign(it->value.begin(), it->value.end());
-	getIdentifier(_text, _id);
+	setText(source);
+
+	string id;
+	getIdentifier(_text, id);
+	_id = intern(id);
 }
 
 IdentifierNode::~IdentifierNode()
@@ -73,8 +88,8 @@ IdentifierNode::~IdentifierNode()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-TypeSpecifierNode::TypeSpecifierNode(ASTNode* parent, const TreeIterator& it)
-	: MyType(parent, it)
+TypeSpecifierNode::TypeSpecifierNode(ASTNode* parent, const NodeSource& source)
+	: MyType(parent, source)
 {
 	_type = getTypeSpecifier(_id);
 }
@@ -86,13 +101,22 @@ TypeSpecifierNode::~TypeSpecifierNode()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-RealLiteralNode::RealLiteralNode(ASTNode* parent, const TreeIterator& it)
-	: MyType(parent, it)
+RealLiteralNode::RealLiteralNode(ASTNode* parent, const NodeSource& source)
+	: MyType(parent, source)
 {
 	bool overflow;
 	_value = (float)getRealLiteralValue(_text, overflow);
 }
 
+RealLiteralNode::RealLiteralNode(ASTNode* parent, const ASTNode& expression, float value)
+	: MyType(parent, builtSource(RID_REAL_LITERAL))
+{
+	std::string text;
+	_value = value;
+	_text = intern(formatString(text, "%#.9g", value));
+	setPosition(expression);
+}
+
 RealLiteralNode::~RealLiteralNode()
 {
 	// Do nothing
@@ -100,11 +124,11 @@ RealLiteralNode::~RealLiteralNode()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-IntegerLiteralNode::IntegerLiteralNode(ASTNode* parent, const TreeIterator& it)
-	: MyType(parent, it)
+IntegerLiteralNode::IntegerLiteralNode(ASTNode* parent, const NodeSource& source)
+	: MyType(parent, source)
 	, _radix(10)
 {
-	switch (it->value.id().to_long())
+	switch (source.rid)
 	{
 	case RID_INTEGER_LITERAL_HEX:
 		_radix = 16;
@@ -122,6 +146,16 @@ IntegerLiteralNode::IntegerLiteralNode(ASTNode* parent, const TreeIterator& it)
 	_value = getIntegerLiteralValue(_text, _radix, overflow);
 }
 
+IntegerLiteralNode::IntegerLiteralNode(ASTNode* parent, const ASTNode& expression, int value)
+	: MyType(parent, builtSource(RID_INTEGER_LITERAL_DEC))
+	, _radix(10)
+{
+	std::string text;
+	_value = value;
+	_text = intern(formatString(text, "%d", value));
+	setPosition(expression);
+}
+
 IntegerLiteralNode::~IntegerLiteralNode()
 {
 	// Do nothing
@@ -129,9 +163,97 @@ IntegerLiteralNode::~IntegerLiteralNode()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+FunctionModifierNode::FunctionModifierNode(ASTNode* parent, const NodeSource& source)
+	: MyType(parent, source)
+{
+	setText(source);
+}
+
+FunctionModifierNode::~FunctionModifierNode()
+{
+	// Do nothing
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FunctionDeclaratorNode* FunctionDefinitionNode::declarator() const
+{
+	auto child = firstChild();
+	while (instanceof(child, RID_FUNCTION_MODIFIER))
+		child = child->nextSibling();
+	return static_cast<FunctionDeclaratorNode*>(child);
+}
+
+bool FunctionDefinitionNode::hasModifier(const char* modifier) const
+{
+	for (auto child = firstChild(); instanceof(child, RID_FUNCTION_MODIFIER); child = child->nextSibling())
+	{
+		if (child->text() == modifier)
+			return true;
+	}
+	return false;
+}
+
+void FunctionDefinitionNode::getParameters(std::vector<ParameterNode*>& result) const
+{
+	result.clear();
+
+	auto list = parameters();
+	if (instanceof(list, RID_PARAMETER_LIST))
+	{
+		for (auto parameter = list->firstChild(); parameter != nullptr; parameter = parameter->nextSibling())
+			result.push_back(static_cast<ParameterNode*>(parameter));
+	}
+	else if (list)
+	{
+		result.push_back(static_cast<ParameterNode*>(list));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool BlockNode::endsMain() const
+{
+	if (instanceof(_parent, RID_START_SYMBOL))
+		return true;
+
+	if (!instanceof(_parent, RID_TRANSLATION_UNIT))
+		return false;
+
+	// the blocks of the translation unit make up the main function, function definitions may follow
+	for (auto next = _nextSibling; next != nullptr; next = next->nextSibling())
+	{
+		if (instanceof(next, RID_BLOCK))
+			return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+EmptyStatementNode::EmptyStatementNode(ASTNode* parent, const NodeSource& source)
+	: MyType(parent, source)
+{}
+
+EmptyStatementNode::EmptyStatementNode(ASTNode* parent, const ASTNode& statement)
+	: MyType(parent, builtSource(RID_EMPTY_STATEMENT))
+{
+	setPosition(statement);
+}
+
+EmptyStatementNode::~EmptyStatementNode()
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+
 IMPLEMENT_NODE( SystemIdentifierNode )
 IMPLEMENT_NODE( StartSymbolNode )
 IMPLEMENT_NODE( TranslationUnitNode )
+IMPLEMENT_NODE( FunctionDefinitionNode )
+IMPLEMENT_NODE( FunctionDeclaratorNode )
+IMPLEMENT_NODE( ParameterListNode )
+IMPLEMENT_NODE( ParameterNode )
 IMPLEMENT_NODE( ArgumentListNode )
 IMPLEMENT_NODE( PrimaryExpressionNode )
 IMPLEMENT_NODE( PrimaryExpressionHelperNode )
@@ -157,7 +279,6 @@ IMPLEMENT_NODE( AssignmentNode )
 IMPLEMENT_NODE( ConditionalExpressionNode )
 IMPLEMENT_NODE( BlockNode )
 IMPLEMENT_NODE( StatementListNode )
-IMPLEMENT_NODE( EmptyStatementNode )
 IMPLEMENT_NODE( VariableDeclarationNode )
 IMPLEMENT_NODE( VariableDeclaratorListNode )
 IMPLEMENT_NODE( VariableDeclaratorNode )
@@ -168,6 +289,7 @@ IMPLEMENT_NODE( WhileStatementNode )
 IMPLEMENT_NODE( TypeModifierNode )
 IMPLEMENT_NODE( StatementExpressionListNode )
 IMPLEMENT_NODE( QuitStatementNode )
+IMPLEMENT_NODE( ReturnStatementNode )
 IMPLEMENT_NODE( ArrayDeclaratorNode )
 IMPLEMENT_NODE( ArraySpecifierNode )
 IMPLEMENT_NODE( QualifiedIdentifierNode )
@@ -9,11 +9,13 @@
 #ifndef __CELL_ast_nodes_H
 #define __CELL_ast_nodes_H
 
-#include "spirit.h" // TreeIterator
 #include "rules.h"
 #include "types.h"
+#include "tokens.h"
 #include "ast_node_base.h"
 
+#include <vector>
+
 namespace chaos { namespace cell {
 
 class ASTVisitor;
@@ -25,7 +27,7 @@ class ASTNode;
 #define DECLARE_NODE( node, base, T )\
 	class node : public T<node, base> {\
 	public:\
-		node(ASTNode*, const TreeIterator&);\
+		node(ASTNode*, const NodeSource&);\
 		virtual ~node();\
 	};
 
@@ -51,7 +53,7 @@ class ASTNode;
 class ExpressionBase : public ASTNode
 {
 public:
-	ExpressionBase(ASTNode* parent, const TreeIterator& it);
+	ExpressionBase(ASTNode* parent, const NodeSource& source);
 	virtual ~ExpressionBase() = 0;
 	ExpressionOperator getOperator() const { return _operator; }
 
@@ -63,7 +65,7 @@ protected:
 class UnaryExpressionBase : public ExpressionBase
 {
 public:
-	UnaryExpressionBase(ASTNode* parent, const TreeIterator& it);
+	UnaryExpressionBase(ASTNode* parent, const NodeSource& source);
 	virtual ~UnaryExpressionBase();
 	ASTNode* operand() const { return _firstChild; }
 };
@@ -72,7 +74,7 @@ public:
 class BinaryExpressionBase : public ExpressionBase
 {
 public:
-	BinaryExpressionBase(ASTNode* parent, const TreeIterator& it);
+	BinaryExpressionBase(ASTNode* parent, const NodeSource& source);
 	virtual ~BinaryExpressionBase();
 	ASTNode* leftOperand()  const { return childAt(0); }
 	ASTNode* rightOperand() const { return childAt(1); }
@@ -82,12 +84,12 @@ public:
 class IdentifierNode : public TerminalNode<IdentifierNode>
 {
 public:
-	IdentifierNode(ASTNode* parent, const TreeIterator& it);
+	IdentifierNode(ASTNode* parent, const NodeSource& source);
 	virtual ~IdentifierNode();
-	const std::string& id() const { return _id; }
+	const ASTString& id() const { return _id; }
 
 protected:
-	std::string _id;
+	ASTString _id; //! Interned in the arena.
 };
 
 DECLARE_TERMINAL_EX( SystemIdentifierNode, IdentifierNode )
@@ -97,8 +99,8 @@ template<class T>
 class LiteralBase : public ASTNode
 {
 public:
-	LiteralBase(ASTNode* parent, const TreeIterator& it) : ASTNode(parent, it), _value(T())
-	{ _text.assign(it->value.begin(), it->value.end()); }
+	LiteralBase(ASTNode* parent, const NodeSource& source) : ASTNode(parent, source), _value(T())
+	{ setText(source); }
 
 	const T& value() const { return _value; }
 
@@ -110,7 +112,9 @@ protected:
 class RealLiteralNode : public TerminalNode<RealLiteralNode, LiteralBase<float> >
 {
 public:
-	RealLiteralNode(ASTNode* parent, const TreeIterator& it);
+	RealLiteralNode(ASTNode* parent, const NodeSource& source);
+	//! Constructs the \a value computed for \a expression, at its position.
+	RealLiteralNode(ASTNode* parent, const ASTNode& expression, float value);
 	virtual ~RealLiteralNode();
 };
 
@@ -118,7 +122,9 @@ public:
 class IntegerLiteralNode : public TerminalNode<IntegerLiteralNode, LiteralBase<int> >
 {
 public:
-	IntegerLiteralNode(ASTNode* parent, const TreeIterator& it);
+	IntegerLiteralNode(ASTNode* parent, const NodeSource& source);
+	//! Constructs the \a value computed for \a expression, at its position.
+	IntegerLiteralNode(ASTNode* parent, const ASTNode& expression, int value);
 	virtual ~IntegerLiteralNode();
 	int radix() const { return _radix; }
 
@@ -129,7 +135,7 @@ private:
 class TypeSpecifierNode : public TerminalNode<TypeSpecifierNode, IdentifierNode>
 {
 public:
-	TypeSpecifierNode(ASTNode* parent, const TreeIterator& it);
+	TypeSpecifierNode(ASTNode* parent, const NodeSource& source);
 	virtual ~TypeSpecifierNode();
 	TypeSpecifier type() const { return _type; }
 
@@ -140,6 +146,48 @@ private:
 DECLARE_TERMINAL( TypeModifierNode )
 DECLARE_NONTERMINAL( StartSymbolNode )
 DECLARE_NONTERMINAL( TranslationUnitNode )
+
+//! 'inline' or 'fast', its text is the keyword.
+class FunctionModifierNode : public TerminalNode<FunctionModifierNode>
+{
+public:
+	FunctionModifierNode(ASTNode* parent, const NodeSource& source);
+	virtual ~FunctionModifierNode();
+};
+
+DECLARE_NONTERMINAL_EX( FunctionDeclaratorNode, IdentifierNode )
+DECLARE_NONTERMINAL( ParameterListNode )
+
+//! A parameter of a function. Its type is the type of the parameter.
+class ParameterNode : public NonTerminalNode<ParameterNode, TypeSpecifierNode>
+{
+public:
+	ParameterNode(ASTNode* parent, const NodeSource& source);
+	virtual ~ParameterNode();
+	const ASTString& name() const { return static_cast<IdentifierNode*>(firstChild())->id(); }
+};
+
+//! A function of the script. Its type is the type of the result.
+class FunctionDefinitionNode : public NonTerminalNode<FunctionDefinitionNode, TypeSpecifierNode>
+{
+public:
+	FunctionDefinitionNode(ASTNode* parent, const NodeSource& source);
+	virtual ~FunctionDefinitionNode();
+	bool isInline() const { return hasModifier(INLINE_T); }
+	//! 'fast' lets the real math of the function be reordered and fused, see CodeGenOptions.
+	bool isFast() const { return hasModifier(FAST_T); }
+	//! The modifiers come first.
+	FunctionDeclaratorNode* declarator() const;
+	const ASTString& name() const { return declarator()->id(); }
+	//! A single parameter is not wrapped in a parameter list. Null if there are none.
+	ASTNode* parameters() const { return declarator()->nextSibling() != body() ? declarator()->nextSibling() : nullptr; }
+	ASTNode* body() const { return lastChild(); }
+	//! Collects the parameters in order.
+	void getParameters(std::vector<ParameterNode*>& result) const;
+
+private:
+	bool hasModifier(const char* modifier) const;
+};
 DECLARE_NONTERMINAL( ArgumentListNode )
 DECLARE_NONTERMINAL( PrimaryExpressionNode )
 DECLARE_NONTERMINAL( PrimaryExpressionHelperNode )
@@ -148,7 +196,7 @@ DECLARE_NONTERMINAL( ParenthesizedExpressionNode )
 class MemberAccessNode : public NonTerminalNode<MemberAccessNode>
 {
 public:
-	MemberAccessNode(ASTNode* parent, const TreeIterator& it);
+	MemberAccessNode(ASTNode* parent, const NodeSource& source);
 	virtual ~MemberAccessNode();
 	ASTNode* name() const { return firstChild(); }
 };
@@ -156,7 +204,7 @@ public:
 class InvocationNode : public NonTerminalNode<InvocationNode>
 {
 public:
-	InvocationNode(ASTNode* parent, const TreeIterator& it);
+	InvocationNode(ASTNode* parent, const NodeSource& source);
 	virtual ~InvocationNode();
 	ASTNode* invocationName() const { return childAt(0); }
 	ASTNode* invocationArguments() const { return childAt(1); }
@@ -184,9 +232,25 @@ DECLARE_BINARY_EXPRESSION( AssignmentNode )
 
 DECLARE_NONTERMINAL( ConditionalExpressionNode )
 
-DECLARE_NONTERMINAL( BlockNode )
+class BlockNode : public NonTerminalNode<BlockNode>
+{
+public:
+	BlockNode(ASTNode* parent, const NodeSource& source);
+	virtual ~BlockNode();
+	//! Returns \a true for the last block at the top level, the main function ends with it.
+	bool endsMain() const;
+};
+
 DECLARE_NONTERMINAL( StatementListNode )
-DECLARE_TERMINAL( EmptyStatementNode )
+
+class EmptyStatementNode : public TerminalNode<EmptyStatementNode>
+{
+public:
+	EmptyStatementNode(ASTNode* parent, const NodeSource& source);
+	//! Constructs the statement left in place of the removed \a statement.
+	EmptyStatementNode(ASTNode* parent, const ASTNode& statement);
+	virtual ~EmptyStatementNode();
+};
 
 DECLARE_NONTERMINAL_EX( VariableDeclarationNode, TypeSpecifierNode )
 DECLARE_NONTERMINAL( VariableDeclaratorListNode )
@@ -196,11 +260,18 @@ DECLARE_NONTERMINAL( ExpressionStatementNode )
 class IfStatementNode : public NonTerminalNode<IfStatementNode>
 {
 public:
-	IfStatementNode(ASTNode* parent, const TreeIterator& it);
+	IfStatementNode(ASTNode* parent, const NodeSource& source);
 	~IfStatementNode();
 	virtual ASTNode* condition() const { return childAt(0); }
 	virtual ASTNode* thenBody()  const { return childAt(1); }
 	virtual ASTNode* elseBody()  const { return childAt(2); }
+
+	//! Gets the condition if it is a literal, so one of the bodies never runs.
+	//! ASTOptimizer leaves such a body to the backends, which check it and drop its code.
+	IntegerLiteralNode* literalCondition() const
+	{
+		return condition()->kind() == NK_IntegerLiteralNode ? static_cast<IntegerLiteralNode*>(condition()) : nullptr;
+	}
 };
 
 DECLARE_NONTERMINAL( ElseStatementNode )
@@ -208,14 +279,30 @@ DECLARE_NONTERMINAL( ElseStatementNode )
 class WhileStatementNode : public NonTerminalNode<WhileStatementNode>
 {
 public:
-	WhileStatementNode(ASTNode* parent, const TreeIterator& it);
+	WhileStatementNode(ASTNode* parent, const NodeSource& source);
 	~WhileStatementNode();
 	virtual ASTNode* condition() const { return childAt(0); }
 	virtual ASTNode* body() const { return childAt(1); }
+
+	//! Gets the condition if it is a literal. ASTOptimizer writes 0 for a loop
+	//! which never runs, the backends check its body and drop the code.
+	IntegerLiteralNode* literalCondition() const
+	{
+		return condition()->kind() == NK_IntegerLiteralNode ? static_cast<IntegerLiteralNode*>(condition()) : nullptr;
+	}
 };
 
 DECLARE_NONTERMINAL( StatementExpressionListNode )
 DECLARE_TERMINAL( QuitStatementNode )
+
+class ReturnStatementNode : public NonTerminalNode<ReturnStatementNode>
+{
+public:
+	ReturnStatementNode(ASTNode* parent, const NodeSource& source);
+	~ReturnStatementNode();
+	ASTNode* value() const { return firstChild(); }
+};
+
 DECLARE_NONTERMINAL_EX( QualifiedIdentifierNode, IdentifierNode )
 DECLARE_NONTERMINAL( ArrayDeclaratorNode )
 DECLARE_NONTERMINAL( ArraySpecifierNode )
@@ -0,0 +1,800 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "ast_optimizer.h"
+#include "ast_nodes.h"
+
+#include <cmath> // fmodf()
+#include <cstring> // memcmp()
+#include <vector>
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+#define MC (*contextFrom(ctx))
+
+////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+//! Returns \a true if \a op compares its operands.
+inline bool isComparison(ExpressionOperator op)
+{
+	return op == OP_EQ || op == OP_NOTEQ || op == OP_LT || op == OP_GT || op == OP_LTEQ || op == OP_GTEQ;
+}
+
+//! Returns \a true if \a op is one of '*', '/', '%', '+' and '-'.
+inline bool isArithmetic(ExpressionOperator op)
+{
+	return op == OP_MUL || op == OP_DIV || op == OP_MOD || op == OP_PLUS || op == OP_MINUS;
+}
+
+//! Returns \a true if \a a and \a b have the same bits, so 0.0 and -0.0 differ.
+inline bool sameReal(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+//! Computes 'a op b' like the generated code does. Returns \a false if the
+//! result is left to run time: a division by zero, or a shift by more than 31.
+static bool computeInt(ExpressionOperator op, int a, int b, int& result)
+{
+	// the generated code wraps around on overflow
+	auto ua = static_cast<unsigned>(a);
+	auto ub = static_cast<unsigned>(b);
+
+	switch (op)
+	{
+	case OP_MUL:     result = static_cast<int>(ua * ub); return true;
+	case OP_PLUS:    result = static_cast<int>(ua + ub); return true;
+	case OP_MINUS:   result = static_cast<int>(ua - ub); return true;
+	case OP_BITAND:  result = a & b; return true;
+	case OP_BITOR:   result = a | b; return true;
+	case OP_AND:     result = (a != 0) && (b != 0); return true;
+	case OP_OR:      result = (a != 0) || (b != 0); return true;
+	case OP_EQ:      result = a == b; return true;
+	case OP_NOTEQ:   result = a != b; return true;
+	case OP_LT:      result = a < b; return true;
+	case OP_GT:      result = a > b; return true;
+	case OP_LTEQ:    result = a <= b; return true;
+	case OP_GTEQ:    result = a >= b; return true;
+
+	case OP_DIV:
+	case OP_MOD:
+		// the backends differ on these, and INT_MIN / -1 overflows
+		if (b == 0 || b == -1)
+			return false;
+		result = op == OP_DIV ? a / b : a % b;
+		return true;
+
+	case OP_LSHIFT:
+	case OP_RSHIFT:
+		if (b < 0 || b > 31)
+			return false;
+		result = op == OP_LSHIFT ? static_cast<int>(ua << b) : a >> b;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+//! Computes 'a op b' for the arithmetic operators. Infinities and NaNs are left to run time.
+static bool computeReal(ExpressionOperator op, float a, float b, float& result)
+{
+	switch (op)
+	{
+	case OP_MUL:   result = a * b; break;
+	case OP_DIV:   result = a / b; break;
+	case OP_MOD:   result = fmodf(a, b); break;
+	case OP_PLUS:  result = a + b; break;
+	case OP_MINUS: result = a - b; break;
+	default:
+		return false;
+	}
+
+	return result - result == 0.0f; // false for infinities and NaNs
+}
+
+//! Computes 'a op b' for the comparisons. '!=' is false if either is NaN, like the generated code.
+static int compareReal(ExpressionOperator op, float a, float b)
+{
+	switch (op)
+	{
+	case OP_EQ:    return a == b;
+	case OP_NOTEQ: return a < b || a > b;
+	case OP_LT:    return a < b;
+	case OP_GT:    return a > b;
+	case OP_LTEQ:  return a <= b;
+	case OP_GTEQ:  return a >= b;
+	default:
+		return 0;
+	}
+}
+
+//! Returns the variable \a target stores into, null if it is not a plain name.
+//! Sets \a member to the member or element access which follows the name, if any.
+static QualifiedIdentifierNode* targetVariable(ASTNode& target, ASTNode*& member)
+{
+	auto base = &target;
+	member = nullptr;
+
+	if (ASTNode::instanceof(base, RID_PRIMARY_EXPRESSION))
+	{
+		base = target.firstChild();
+		member = base->nextSibling();
+	}
+
+	return ASTNode::instanceof(base, RID_QUALIFIED_IDENTIFIER) ? static_cast<QualifiedIdentifierNode*>(base) : nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ASTOptimizer
+
+ASTOptimizer::ASTOptimizer()
+	: _indexDepth(0)
+	, _keepTree(false)
+{}
+
+ASTOptimizer::~ASTOptimizer()
+{}
+
+ASTNode* ASTOptimizer::optimizeStatement(ASTNode& node)
+{
+	ContextType newContext;
+	newContext.statement = &node;
+	node.accept(*this, &newContext);
+
+	// the node is replaced only now, its visitor methods are done with it
+	if (newContext.statement == &node)
+		return &node;
+
+	if (!newContext.statement)
+		return removeStatement(node);
+
+	node.parent()->replaceChild(&node, newContext.statement);
+	return newContext.statement;
+}
+
+void ASTOptimizer::optimizeStatements(ASTNode& node)
+{
+	auto child = node.firstChild();
+	while (child)
+	{
+		auto next = child->nextSibling(); // the child may be removed
+		optimizeStatement(*child);
+		child = next;
+	}
+}
+
+ASTNode* ASTOptimizer::removeStatement(ASTNode& node)
+{
+	auto parent = node.parent();
+
+	if (ASTNode::instanceof(parent, RID_STATEMENT_LIST))
+	{
+		parent->removeChild(&node);
+		return nullptr;
+	}
+
+	// the other statements hold exactly one statement
+	auto empty = new (*parent->arena()) EmptyStatementNode(parent, node);
+	parent->replaceChild(&node, empty);
+	return empty;
+}
+
+ConstantValue ASTOptimizer::evalExpression(ASTNode& node)
+{
+	ContextType newContext;
+	node.accept(*this, &newContext);
+	return newContext.value;
+}
+
+ConstantValue ASTOptimizer::foldExpression(ASTNode& node)
+{
+	auto value = evalExpression(node);
+
+	if (_keepTree || !value.known || node.kind() == NK_IntegerLiteralNode || node.kind() == NK_RealLiteralNode)
+		return value;
+
+	auto parent = node.parent();
+	if (value.type == TS_INT)
+		parent->replaceChild(&node, new (*parent->arena()) IntegerLiteralNode(parent, node, value.i));
+	else if (value.type == TS_REAL)
+		parent->replaceChild(&node, new (*parent->arena()) RealLiteralNode(parent, node, value.f));
+
+	return value;
+}
+
+void ASTOptimizer::store(ASTNode& target, const ConstantValue& value)
+{
+	ASTNode* member;
+	auto variable = targetVariable(target, member);
+	if (!variable)
+		return;
+
+	auto it = _locals.find(variable->id());
+	if (it == _locals.end())
+		return;
+
+	ConstantValue& local = it->second;
+
+	if (!member)
+	{
+		// a value of another type is an error the backends report
+		if (value.type == local.type)
+			local = value;
+		else
+			local.known = 0;
+		return;
+	}
+
+	// a store into '.x' or '.y' sets one element of the vec
+	int element = -1;
+	if (!member->nextSibling() && ASTNode::instanceof(member, RID_MEMBER_ACCESS) && ASTNode::instanceof(member->firstChild(), RID_QUALIFIED_IDENTIFIER))
+	{
+		auto& id = static_cast<QualifiedIdentifierNode*>(member->firstChild())->id();
+		if (id == "x")
+			element = 0;
+		else if (id == "y")
+			element = 1;
+	}
+
+	if (local.type == TS_VECTOR && element >= 0)
+	{
+		auto bit = 1u << element;
+		if (value.type == TS_REAL && value.known)
+		{
+			local.v[element] = value.f;
+			local.known |= bit;
+		}
+		else
+		{
+			local.known &= ~bit;
+		}
+	}
+	else
+	{
+		local.known = 0;
+	}
+}
+
+void ASTOptimizer::forgetAssigned(ASTNode& node)
+{
+	if (node.kind() == NK_AssignmentNode)
+	{
+		ASTNode* member;
+		auto variable = targetVariable(*static_cast<AssignmentNode&>(node).leftOperand(), member);
+		if (variable)
+		{
+			auto it = _locals.find(variable->id());
+			if (it != _locals.end())
+				it->second.known = 0;
+		}
+	}
+
+	for (auto child = node.firstChild(); child != nullptr; child = child->nextSibling())
+		forgetAssigned(*child);
+}
+
+void ASTOptimizer::merge(const ConstantMap& other)
+{
+	// a value is known after the branches only if both of them agree on it
+	for (auto it = _locals.begin(); it != _locals.end(); ++it)
+	{
+		ConstantValue& value = it->second;
+		auto match = other.find(it->first);
+
+		if (match == other.end() || match->second.type != value.type)
+		{
+			value.known = 0;
+			continue;
+		}
+
+		const ConstantValue& that = match->second;
+		value.known &= that.known;
+
+		if (value.type == TS_INT && value.i != that.i)
+			value.known = 0;
+		else if (value.type == TS_REAL && !sameReal(value.f, that.f))
+			value.known = 0;
+		else if (value.type == TS_VECTOR)
+		{
+			if (!sameReal(value.v[0], that.v[0]))
+				value.known &= ~1u;
+			if (!sameReal(value.v[1], that.v[1]))
+				value.known &= ~2u;
+		}
+	}
+
+	// the variables declared in one of the branches only
+	for (auto it = other.begin(); it != other.end(); ++it)
+	{
+		if (_locals.find(it->first) == _locals.end())
+		{
+			ConstantValue value;
+			value.type = it->second.type;
+			_locals.insert( make_pair(it->first, value) );
+		}
+	}
+}
+
+// * / % + - == != > >= < <= & ^ | << >> && ||
+bool ASTOptimizer::visitBinaryExpression(BinaryExpressionBase& node, ContextType& ctx)
+{
+	auto left  = foldExpression(*node.leftOperand());
+	auto right = foldExpression(*node.rightOperand());
+	auto op = node.getOperator();
+
+	ctx.value = ConstantValue();
+
+	if (left.type == TS_INT && right.type == TS_INT)
+	{
+		ctx.value.type = TS_INT;
+		if (left.known && right.known && computeInt(op, left.i, right.i, ctx.value.i))
+			ctx.value.known = 1;
+	}
+	else if (left.type == TS_REAL && right.type == TS_REAL)
+	{
+		if (isComparison(op))
+		{
+			ctx.value.type = TS_INT;
+			if (left.known && right.known)
+			{
+				ctx.value.i = compareReal(op, left.f, right.f);
+				ctx.value.known = 1;
+			}
+		}
+		else if (isArithmetic(op))
+		{
+			ctx.value.type = TS_REAL;
+			if (left.known && right.known && computeReal(op, left.f, right.f, ctx.value.f))
+				ctx.value.known = 1;
+		}
+	}
+	else if (left.type == TS_VECTOR && right.type == TS_VECTOR && isComparison(op))
+	{
+		// vectors compare true only if both elements do
+		ctx.value.type = TS_INT;
+		if (left.known == 3 && right.known == 3)
+		{
+			ctx.value.i = compareReal(op, left.v[0], right.v[0]) && compareReal(op, left.v[1], right.v[1]);
+			ctx.value.known = 1;
+		}
+	}
+	else if ((left.type == TS_VECTOR || right.type == TS_VECTOR) && isArithmetic(op) &&
+		(left.type == TS_REAL || right.type == TS_REAL || left.type == right.type))
+	{
+		// a real operand combined with a vec is splatted to both elements
+		ctx.value.type = TS_VECTOR;
+		for (int i = 0; i < 2; ++i)
+		{
+			auto leftKnown  = left.type == TS_REAL ? left.known : left.known >> i & 1;
+			auto rightKnown = right.type == TS_REAL ? right.known : right.known >> i & 1;
+			auto a = left.type == TS_REAL ? left.f : left.v[i];
+			auto b = right.type == TS_REAL ? right.f : right.v[i];
+
+			if (leftKnown && rightKnown && computeReal(op, a, b, ctx.value.v[i]))
+				ctx.value.known |= 1u << i;
+		}
+	}
+	else if (left.type == TS_VECTOR && right.type == TS_VECTOR && op == OP_BITXOR)
+	{
+		ctx.value.type = TS_REAL; // the dot product
+	}
+
+	return false;
+}
+
+// + - ! ~
+bool ASTOptimizer::visitUnaryExpression(UnaryExpressionBase& node, ContextType& ctx)
+{
+	auto value = foldExpression(*node.operand());
+
+	ctx.value = ConstantValue();
+
+	switch (node.getOperator())
+	{
+	case OP_PLUS: // +
+		ctx.value = value;
+		break;
+
+	case OP_MINUS: // -
+		ctx.value = value;
+		ctx.value.i = static_cast<int>(0u - static_cast<unsigned>(value.i));
+		ctx.value.f = -value.f;
+		ctx.value.v[0] = -value.v[0];
+		ctx.value.v[1] = -value.v[1];
+		break;
+
+	case OP_NOT: // !
+		if (value.type == TS_INT)
+		{
+			ctx.value = value;
+			ctx.value.i = value.i == 0;
+		}
+		break;
+
+	case OP_BITNOT: // ~
+		if (value.type == TS_INT)
+		{
+			ctx.value = value;
+			ctx.value.i = ~value.i;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Declarations
+
+bool ASTOptimizer::preVisit(FunctionDefinitionNode& node, ASTContext* ctx)
+{
+	// a function sees its parameters only, they are not known on entry
+	ConstantMap locals;
+	_locals.swap(locals);
+
+	vector<ParameterNode*> parameters;
+	node.getParameters(parameters);
+
+	for (size_t i = 0; i < parameters.size(); ++i)
+	{
+		ConstantValue value;
+		value.type = parameters[i]->type();
+		_locals[parameters[i]->name()] = value;
+	}
+
+	optimizeStatement(*node.body());
+
+	_locals.swap(locals);
+	_functions.insert(node.name());
+
+	return false;
+}
+
+bool ASTOptimizer::preVisit(VariableDeclarationNode& node, ASTContext* ctx)
+{
+	auto declarator = static_cast<VariableDeclaratorNode*>(node.lastChild());
+
+	// globals keep their values between runs and the elements of arrays are
+	// not followed; a local is not known until it is assigned
+	if (ASTNode::instanceof(node.firstChild(), RID_TYPE_MODIFIER) || ASTNode::instanceof(declarator->previousSibling(), RID_ARRAY_SPECIFIER))
+	{
+		_locals.erase(declarator->id());
+	}
+	else
+	{
+		ConstantValue value;
+		value.type = node.type();
+		_locals[declarator->id()] = value;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Literals
+
+bool ASTOptimizer::visit(IntegerLiteralNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue();
+	MC.value.type = TS_INT;
+	MC.value.known = 1;
+	MC.value.i = node.value();
+	return true;
+}
+
+bool ASTOptimizer::visit(RealLiteralNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue();
+	MC.value.type = TS_REAL;
+	MC.value.known = 1;
+	MC.value.f = node.value();
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Identifiers
+
+bool ASTOptimizer::visit(QualifiedIdentifierNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue();
+
+	// a constant index is checked while compiling, a variable one at run time;
+	// the variables of an index stay variables, so the same scripts compile
+	if (_indexDepth == 0)
+	{
+		auto it = _locals.find(node.id());
+		if (it != _locals.end())
+			MC.value = it->second;
+	}
+
+	return true;
+}
+
+bool ASTOptimizer::visit(SystemIdentifierNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue();
+	return true;
+}
+
+bool ASTOptimizer::preVisit(MemberAccessNode& node, ASTContext* ctx)
+{
+	auto object = MC.value;
+	auto member = ASTNode::instanceof(node.name(), RID_QUALIFIED_IDENTIFIER) ? static_cast<QualifiedIdentifierNode*>(node.name()) : nullptr;
+
+	MC.value = ConstantValue();
+
+	if (object.type == TS_VECTOR && member)
+	{
+		auto& id = member->id();
+
+		if (id == "x")
+		{
+			MC.value.type = TS_REAL;
+			MC.value.known = object.known & 1;
+			MC.value.f = object.v[0];
+		}
+		else if (id == "y")
+		{
+			MC.value.type = TS_REAL;
+			MC.value.known = object.known >> 1 & 1;
+			MC.value.f = object.v[1];
+		}
+		else if (id == "length")
+		{
+			MC.value.type = TS_REAL;
+		}
+		else if (id == "normalized")
+		{
+			MC.value.type = TS_VECTOR;
+		}
+	}
+
+	return false;
+}
+
+bool ASTOptimizer::preVisit(ElementAccessNode& node, ASTContext* ctx)
+{
+	++_indexDepth;
+	foldExpression(*node.firstChild());
+	--_indexDepth;
+
+	MC.value = ConstantValue();
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+
+bool ASTOptimizer::preVisit(BlockNode& node, ASTContext* ctx)
+{
+	optimizeStatements(node);
+	return false;
+}
+
+bool ASTOptimizer::preVisit(StatementListNode& node, ASTContext* ctx)
+{
+	optimizeStatements(node);
+	return false;
+}
+
+bool ASTOptimizer::preVisit(ElseStatementNode& node, ASTContext* ctx)
+{
+	optimizeStatements(node);
+	return false;
+}
+
+bool ASTOptimizer::preVisit(ExpressionStatementNode& node, ASTContext* ctx)
+{
+	if (node.firstChild())
+		evalExpression(*node.firstChild());
+	return false;
+}
+
+bool ASTOptimizer::preVisit(IfStatementNode& node, ASTContext* ctx)
+{
+	auto condition = foldExpression(*node.condition());
+	auto thenBody = node.thenBody();
+	auto elseBody = node.elseBody();
+
+	if (condition.type == TS_INT && condition.known)
+	{
+		// the condition is a literal now; the body which never runs is left as
+		// it is, the backends check it so the same scripts compile, and drop it
+		auto taken = condition.i ? thenBody : elseBody;
+		if (taken)
+			optimizeStatement(*taken);
+		return false;
+	}
+
+	ConstantMap before(_locals);
+	optimizeStatement(*thenBody);
+
+	if (elseBody)
+	{
+		ConstantMap afterThen;
+		afterThen.swap(_locals);
+		_locals = before;
+		optimizeStatement(*elseBody);
+		merge(afterThen);
+	}
+	else
+	{
+		merge(before);
+	}
+
+	return false;
+}
+
+bool ASTOptimizer::preVisit(WhileStatementNode& node, ASTContext* ctx)
+{
+	// a loop whose condition fails on entry never runs
+	_keepTree = true;
+	auto entry = evalExpression(*node.condition());
+	_keepTree = false;
+
+	if (entry.type == TS_INT && entry.known && entry.i == 0)
+	{
+		// the backends check the body of a loop with the literal 0 and drop it
+		auto condition = node.condition();
+		node.replaceChild(condition, new (*node.arena()) IntegerLiteralNode(&node, *condition, 0));
+		return false;
+	}
+
+	// the condition and the body see the values of all iterations,
+	// so what the loop assigns is not known in either
+	forgetAssigned(node);
+	foldExpression(*node.condition());
+	optimizeStatement(*node.body());
+	forgetAssigned(node);
+
+	return false;
+}
+
+bool ASTOptimizer::preVisit(ReturnStatementNode& node, ASTContext* ctx)
+{
+	if (node.value())
+		foldExpression(*node.value());
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+
+bool ASTOptimizer::preVisit(MultiplicativeExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(AdditiveExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(RelationalExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(EqualityExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(ShiftExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(AndExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(ExclusiveOrExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(InclusiveOrExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(ConditionalAndExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(ConditionalOrExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(UnaryExpressionNode& node, ASTContext* ctx)
+{
+	return visitUnaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(PostfixExpressionNode& node, ASTContext* ctx)
+{
+	return visitUnaryExpression(node, MC);
+}
+
+bool ASTOptimizer::preVisit(ConditionalExpressionNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue(); // not supported by the backends
+	return false;
+}
+
+bool ASTOptimizer::preVisit(ObjectCreationExpressionNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue(); // not supported by the backends
+	return false;
+}
+
+bool ASTOptimizer::preVisit(ArrayCreationExpressionNode& node, ASTContext* ctx)
+{
+	MC.value = ConstantValue();
+	return false;
+}
+
+bool ASTOptimizer::preVisit(AssignmentNode& node, ASTContext* ctx)
+{
+	// like the generated code, compound assignments store the right operand
+	auto value = foldExpression(*node.rightOperand());
+	evalExpression(*node.leftOperand()); // folds the indices of the target
+	store(*node.leftOperand(), value);
+
+	MC.value = ConstantValue(); // assignments have no value
+	return false;
+}
+
+bool ASTOptimizer::preVisit(InvocationNode& node, ASTContext* ctx)
+{
+	auto& calleeName = static_cast<QualifiedIdentifierNode*>(node.invocationName())->id();
+
+	// a single argument is not wrapped in an argument list
+	vector<ASTNode*> arguments;
+	auto list = node.invocationArguments();
+	if (ASTNode::instanceof(list, RID_ARGUMENT_LIST))
+	{
+		for (auto arg = list->firstChild(); arg != nullptr; arg = arg->nextSibling())
+			arguments.push_back(arg);
+	}
+	else if (list)
+	{
+		arguments.push_back(list);
+	}
+
+	vector<ConstantValue> values;
+	for (size_t i = 0; i < arguments.size(); ++i)
+		values.push_back(foldExpression(*arguments[i]));
+
+	MC.value = ConstantValue();
+
+	// the builtin makeVec() builds a vec of known elements; a function of the script may hide it
+	if (calleeName == "makeVec" && _functions.find(calleeName) == _functions.end() &&
+		values.size() == 2 && values[0].type == TS_REAL && values[1].type == TS_REAL)
+	{
+		MC.value.type = TS_VECTOR;
+		MC.value.known = (values[0].known & 1) | (values[1].known & 1) << 1;
+		MC.value.v[0] = values[0].f;
+		MC.value.v[1] = values[1].f;
+	}
+
+	return false;
+}
+
+}} // chaos::cell
@@ -0,0 +1,128 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_ast_optimizer_H
+#define __CELL_ast_optimizer_H
+
+#include "boost/unordered_map.hpp"
+#include "boost/unordered_set.hpp"
+#include "ast_visitor.h"
+
+namespace chaos { namespace cell {
+
+//! A value known while compiling. The scripts have no vec literals, so a vec
+//! is known element by element, from makeVec() or from stores into '.x' and '.y'.
+struct ConstantValue
+{
+	ConstantValue() : type(TS_NONE), known(0), i(0), f(0.0f)
+	{ v[0] = v[1] = 0.0f; }
+
+	TypeSpecifier type; //! TS_NONE if not even the type is known.
+	unsigned known;     //! Bit 0 is set if the int or the real is known, bits 0 and 1 for the elements of a vec.
+	int i;
+	float f;
+	float v[2];
+};
+
+//! Propagates data during AST traversal.
+struct OptimizerContext : ASTContext
+{
+	OptimizerContext()
+	{ reset(); }
+
+	virtual ~OptimizerContext()
+	{}
+
+	void reset()
+	{
+		value = ConstantValue();
+		statement = nullptr;
+	}
+
+	ConstantValue value; //! The evaluation result.
+	ASTNode* statement;  //! The node which stands for the visited statement, null once it is removed.
+};
+
+//! The known values of the local variables, by name.
+typedef boost::unordered_map<std::string, ConstantValue> ConstantMap;
+
+//! Rewrites the AST of a unit before the code is generated: computes the
+//! expressions of constants, follows the values of the local int, real and
+//! vec variables, and turns the conditions of the 'if' and 'while' bodies which
+//! never run into literals. Both backends generate their code from the result,
+//! they type-check such a body and drop its code.
+//! Expressions which do not type-check are left to the backends to report.
+class ASTOptimizer : public ASTVisitorMix<OptimizerContext>
+{
+public:
+	ASTOptimizer();
+	virtual ~ASTOptimizer();
+
+	virtual bool visit(IntegerLiteralNode& node, ASTContext* ctx);
+	virtual bool visit(RealLiteralNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(FunctionDefinitionNode& node, ASTContext* ctx);
+	virtual bool preVisit(VariableDeclarationNode& node, ASTContext* ctx);
+
+	virtual bool visit(QualifiedIdentifierNode& node, ASTContext* ctx);
+	virtual bool visit(SystemIdentifierNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(MemberAccessNode& node, ASTContext* ctx);
+	virtual bool preVisit(ElementAccessNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(BlockNode& node, ASTContext* ctx);
+	virtual bool preVisit(StatementListNode& node, ASTContext* ctx);
+	virtual bool preVisit(ElseStatementNode& node, ASTContext* ctx);
+	virtual bool preVisit(ExpressionStatementNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(InvocationNode& node, ASTContext* ctx);
+	virtual bool preVisit(ObjectCreationExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ArrayCreationExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ConditionalExpressionNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(IfStatementNode& node, ASTContext* ctx);
+	virtual bool preVisit(WhileStatementNode& node, ASTContext* ctx);
+	virtual bool preVisit(ReturnStatementNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(AssignmentNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(MultiplicativeExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(AdditiveExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(RelationalExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(EqualityExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(AndExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ExclusiveOrExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(InclusiveOrExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ConditionalAndExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ConditionalOrExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ShiftExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(UnaryExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(PostfixExpressionNode& node, ASTContext* ctx);
+
+private:
+	ASTNode* optimizeStatement(ASTNode& node);
+	void optimizeStatements(ASTNode& node);
+	ASTNode* removeStatement(ASTNode& node);
+	ConstantValue evalExpression(ASTNode& node);
+	ConstantValue foldExpression(ASTNode& node);
+	void store(ASTNode& target, const ConstantValue& value);
+	void forgetAssigned(ASTNode& node);
+	void merge(const ConstantMap& other);
+	bool visitBinaryExpression(BinaryExpressionBase& node, ContextType& ctx);
+	bool visitUnaryExpression(UnaryExpressionBase& node, ContextType& ctx);
+
+private:
+	ConstantMap _locals; //! the local variables of the main block or of the function being optimized
+	boost::unordered_set<std::string> _functions; //! the functions defined so far, they hide the builtins
+	int _indexDepth; //! the number of enclosing element indices
+	bool _keepTree; //! set while a value is computed without rewriting the expression
+};
+
+}} // chaos::cell
+
+#endif // __CELL_ast_optimizer_H
@@ -11,55 +11,92 @@
 
 namespace chaos { namespace cell {
 
-ASTNode* createNode(ASTNode* parent, const TreeIterator& it);
+ASTNode* createNode(ASTArena& arena, ASTNode* parent, const NodeSource& source);
 
 void buildTree(ASTNode* parent, const TreeIterator& it)
 {
-	if (auto node = createNode(parent, it))
+	NodeSource source;
+	source.rid = static_cast<RuleID>(it->value.id().to_long());
+	source.first = source.last = nullptr;
+
+	// Spirit leaves the iterators of the nodes without a position unset
+	if (!it->value.begin().get_position().file.empty())
+	{
+		source.first = it->value.begin().base();
+		source.last = it->value.end().base();
+	}
+
+	if (auto node = createNode(*parent->arena(), parent, source))
 	{
 		for (auto child = it->children.begin(), last = it->children.end(); child != last; ++child)
 			buildTree(node, child);
 	}
 }
 
+void buildTree(ASTNode* parent, const Parser& parser, int index)
+{
+	if (auto node = createNode(*parent->arena(), parent, parser.nodeSource(index)))
+	{
+		for (auto child = parser.node(index).firstChild; child >= 0; child = parser.node(child).nextSibling)
+			buildTree(node, parser, child);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 ASTTree::ASTTree()
-{}
+{
+	_arena = &_nodeArena;
+}
 
 ASTTree::~ASTTree()
-{}
-
-void ASTTree::build(const TreeIterator& it, const std::string& filename)
 {
+	// the nodes must go before the arena holding them
 	destroy();
-	_filename = filename;
+}
+
+bool ASTTree::load(const std::string& path)
+{
+	clear();
+	return _source.open(path);
+}
+
+void ASTTree::build(const TreeIterator& it)
+{
+	clear();
 	buildTree(this, it);
 }
 
-void ASTTree::clear()
+void ASTTree::build(const Parser& parser)
 {
-	auto child = _firstChild;
+	clear();
 
-	_firstChild = _lastChild = nullptr;
-	_childCount = 0;
+	if (parser.root() >= 0)
+		buildTree(this, parser, parser.root());
+}
 
-	while (child)
-	{
-		{
-			auto next = child->nextSibling();
-			delete child;
-			child = next;
-		}
-	}
+void ASTTree::detachSource()
+{
+	// the nodes point into the mapping, move them to the copy before it goes
+	std::vector<char> text(_source.begin(), _source.end());
+	if (!text.empty())
+		moveSource(_source.begin(), &text[0]);
+
+	_source.takeText(text);
+}
+
+void ASTTree::clear()
+{
+	destroy();
+	_nodeArena.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Helper macros
 
 #define BEGIN_NODE_MAP() \
-	ASTNode* createNode(ASTNode* parent, const TreeIterator& it) { \
-	RuleID rid = static_cast<RuleID>(it->value.id().to_long()); \
+	ASTNode* createNode(ASTArena& arena, ASTNode* parent, const NodeSource& source) { \
+	RuleID rid = source.rid; \
 	switch (rid) {
 
 #define END_NODE_MAP() default: assert_msg(false, "Unmatched rule: %s (RID: %d)\n", toString(rid), rid); return 0; };}
@@ -68,11 +105,10 @@ void ASTTree::clear()
 #if 0//_DEBUG
 	#define NODE(ruleID, nodeClass) \
 		case ruleID: { \
-		const ParsePosition pos = it->value.begin().get_position(); \
-		trace("Creating node: %s(%d): %s (rid: %d) -> %s\n", pos.file.c_str(), pos.line, toString(rid), rid, STRINGIZE(nodeClass)); \
-		return new nodeClass(parent, it); }
+		trace("Creating node: %s(%d): %s (rid: %d) -> %s\n", source.file->c_str(), source.line, toString(rid), rid, STRINGIZE(nodeClass)); \
+		return new (arena) nodeClass(parent, source); }
 #else
-	#define NODE(ruleId, nodeClass) case ruleId: return new nodeClass(parent, it);
+	#define NODE(ruleId, nodeClass) case ruleId: return new (arena) nodeClass(parent, source);
 #endif
 
 
@@ -92,6 +128,11 @@ BEGIN_NODE_MAP()
 	NODE( RID_START_SYMBOL, StartSymbolNode )
 
 	NODE( RID_TRANSLATION_UNIT, TranslationUnitNode )
+	NODE( RID_FUNCTION_DEFINITION, FunctionDefinitionNode )
+	NODE( RID_FUNCTION_MODIFIER, FunctionModifierNode )
+	NODE( RID_FUNCTION_DECLARATOR, FunctionDeclaratorNode )
+	NODE( RID_PARAMETER_LIST, ParameterListNode )
+	NODE( RID_PARAMETER, ParameterNode )
 
 	NODE( RID_TYPE_SPECIFIER, TypeSpecifierNode )
 	NODE( RID_TYPE_MODIFIER, TypeModifierNode )
@@ -130,6 +171,7 @@ BEGIN_NODE_MAP()
 	NODE( RID_ELSE_STATEMENT, ElseStatementNode )
 	NODE( RID_WHILE_STATEMENT, WhileStatementNode )
 	NODE( RID_QUIT_STATEMENT, QuitStatementNode )
+	NODE( RID_RETURN_STATEMENT, ReturnStatementNode )
 	NODE( RID_STATEMENT_EXPRESSION_LIST, StatementExpressionListNode )
 	NODE( RID_QUALIFIED_IDENTIFIER, QualifiedIdentifierNode )
 
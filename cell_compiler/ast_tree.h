@@ -10,6 +10,10 @@
 #define __CELL_ast_tree_H
 
 #include "ast_nodes.h"
+#include "ast_arena.h"
+#include "cell_parser.h"
+#include "source_file.h"
+#include "spirit.h" // TreeIterator
 
 namespace chaos { namespace cell {
 
@@ -20,12 +24,32 @@ public:
 	ASTTree();
 	virtual ~ASTTree();
 
-	void build(const TreeIterator& it, const std::string& filename = "");
-	const std::string& filename() const { return _filename; }
+	//! Maps the script at \a path as the source of this tree and clears the tree.
+	//! Returns \a false if the script cannot be opened.
+	bool load(const std::string& path);
+
+	//! Gets the source the nodes of this tree point into.
+	const SourceFile& source() const { return _source; }
+
+	//! Builds the tree from a Spirit parse tree of source().
+	void build(const TreeIterator& it);
+
+	//! Builds the tree from the last parse of \a parser, which has parsed source().
+	void build(const Parser& parser);
+
+	//! Copies the source out of the mapped file and releases the file, which
+	//! an editor may then save over. Called once the tree is built.
+	void detachSource();
+
+	const std::string& filename() const { return _source.path(); }
 	void clear();
 
+	//! Returns the arena which owns the nodes and strings of this tree.
+	const ASTArena& nodeArena() const { return _nodeArena; }
+
 private:
-	std::string _filename;
+	SourceFile _source;
+	ASTArena _nodeArena; //! Released as a whole by build() and clear().
 };
 
 }} // chaos::cell
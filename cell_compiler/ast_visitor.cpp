@@ -49,6 +49,11 @@ IMPLEMENT_VISIT( RealLiteralNode )
 IMPLEMENT_VISIT( StartSymbolNode )
 
 IMPLEMENT_VISIT( TranslationUnitNode )
+IMPLEMENT_VISIT( FunctionDefinitionNode )
+IMPLEMENT_VISIT( FunctionModifierNode )
+IMPLEMENT_VISIT( FunctionDeclaratorNode )
+IMPLEMENT_VISIT( ParameterListNode )
+IMPLEMENT_VISIT( ParameterNode )
 
 IMPLEMENT_VISIT( TypeSpecifierNode )
 IMPLEMENT_VISIT( TypeModifierNode )
@@ -92,6 +97,7 @@ IMPLEMENT_VISIT( StatementExpressionListNode )
 IMPLEMENT_VISIT( ArrayDeclaratorNode )
 IMPLEMENT_VISIT( ArraySpecifierNode )
 IMPLEMENT_VISIT( QuitStatementNode )
+IMPLEMENT_VISIT( ReturnStatementNode )
 IMPLEMENT_VISIT( QualifiedIdentifierNode )
 
 }} // chaos::cell
@@ -43,6 +43,11 @@ public:
 
 	CELL_DECLARE_VISIT( StartSymbolNode )
 	CELL_DECLARE_VISIT( TranslationUnitNode )
+	CELL_DECLARE_VISIT( FunctionDefinitionNode )
+	CELL_DECLARE_VISIT( FunctionModifierNode )
+	CELL_DECLARE_VISIT( FunctionDeclaratorNode )
+	CELL_DECLARE_VISIT( ParameterListNode )
+	CELL_DECLARE_VISIT( ParameterNode )
 
 	CELL_DECLARE_VISIT( IdentifierNode )
 	CELL_DECLARE_VISIT( SystemIdentifierNode )
@@ -93,6 +98,7 @@ public:
 	CELL_DECLARE_VISIT( ArrayDeclaratorNode )
 	CELL_DECLARE_VISIT( ArraySpecifierNode )
 	CELL_DECLARE_VISIT( QuitStatementNode )
+	CELL_DECLARE_VISIT( ReturnStatementNode )
 	CELL_DECLARE_VISIT( QualifiedIdentifierNode )
 
 public:
@@ -82,11 +82,225 @@ vec cell_makeVec(float x, float y)
 	return v;
 }
 
-// TODO: Add more functions :)
+////////////////////////////////////////////////////////////////////////////////
+// Arena-wide reductions
+//
+// These builtins take the cell array and the cell count as hidden leading
+// parameters which the compiler passes implicitly, so the script sees e.g.
+// 'nearestCell(point, minRadius, maxRadius)'. The player (cell 0) is never
+// considered. Cells are processed four at a time; the lanes translate to
+// <4 x float> which the JIT lowers to SSE (or AVX when the host supports it).
+
+//! 4-wide vector types used by the reductions.
+typedef float vec4 __attribute__((ext_vector_type(4)));
+typedef int ivec4 __attribute__((ext_vector_type(4)));
+
+//! Native SSE vector type, needed to call the SSE builtins.
+typedef float sse4 __attribute__((vector_size(16)));
+
+//! Number of cells processed per iteration.
+#define LANES 4
+
+//! A large distance, used as a neutral element for the min-reductions.
+#define LARGE_DISTANCE 1e19f
+
+//! Index offsets of the lanes.
+static const ivec4 kLaneOffsets = { 0, 1, 2, 3 };
+
+//! Lane-wise select: picks 'a' where 'mask' is set, otherwise 'b'.
+static vec4 select4(ivec4 mask, vec4 a, vec4 b)
+{
+	return (vec4)((mask & (ivec4)a) | (~mask & (ivec4)b));
+}
+
+//! Lane-wise square root.
+static vec4 sqrt4(vec4 x)
+{
+#ifdef __SSE__
+	return (vec4)__builtin_ia32_sqrtps((sse4)x);
+#else
+	vec4 result = { __builtin_sqrtf(x.x), __builtin_sqrtf(x.y), __builtin_sqrtf(x.z), __builtin_sqrtf(x.w) };
+	return result;
+#endif
+}
+
+//! Sums the lanes of 'v'.
+static float sum4(vec4 v)
+{
+	return (v.x + v.y) + (v.z + v.w);
+}
+
+//! Loads the radii and positions of the four cells starting at 'first'.
+//! Lanes past 'count' repeat the last cell and are cleared in 'active'.
+static void gather4(const Cell* cells, int first, int count, vec4* radius, vec4* x, vec4* y, ivec4* active)
+{
+	int lane;
+	for (lane = 0; lane < LANES; ++lane)
+	{
+		int index = (first + lane < count) ? first + lane : count - 1;
+		(*radius)[lane] = cells[index].radius;
+		(*x)[lane] = cells[index].position.x;
+		(*y)[lane] = cells[index].position.y;
+	}
+	*active = (first + kLaneOffsets) < count;
+}
+
+//! Finds the cell whose surface is closest to 'point' (farthest if 'sign' is
+//! negative) among the cells with radius in [minRadius, maxRadius).
+//! Returns -1 if there is no such cell.
+static int findCell(const Cell* cells, int cellCount, vec point, float minRadius, float maxRadius, float sign)
+{
+	vec4 best = LARGE_DISTANCE;
+	ivec4 bestIndex = -1;
+	int i, lane, result = -1;
+	float resultDistance = LARGE_DISTANCE;
+
+	for (i = 1; i < cellCount; i += LANES)
+	{
+		vec4 radius, x, y;
+		ivec4 active;
+		gather4(cells, i, cellCount, &radius, &x, &y, &active);
+
+		vec4 dx = x - point.x;
+		vec4 dy = y - point.y;
+		vec4 distance = sign * (sqrt4(dx*dx + dy*dy) - radius);
+
+		ivec4 mask = active & (radius >= minRadius) & (radius < maxRadius) & (distance < best);
+		best = select4(mask, distance, best);
+		bestIndex = (mask & (i + kLaneOffsets)) | (~mask & bestIndex);
+	}
+
+	// reduce the lanes; prefer the lower index on ties so the result is deterministic
+	for (lane = 0; lane < LANES; ++lane)
+	{
+		if (bestIndex[lane] < 0)
+			continue;
+		if (best[lane] < resultDistance || (best[lane] == resultDistance && bestIndex[lane] < result))
+		{
+			resultDistance = best[lane];
+			result = bestIndex[lane];
+		}
+	}
+
+	return result;
+}
+
+//! Invoked when the compiler sees 'nearestCell(point, minRadius, maxRadius)'.
+int cell_nearestCell(Cell* cells, int cellCount, vec point, float minRadius, float maxRadius)
+{
+	return findCell(cells, cellCount, point, minRadius, maxRadius, 1.0f);
+}
+
+//! Invoked when the compiler sees 'farthestCell(point, minRadius, maxRadius)'.
+int cell_farthestCell(Cell* cells, int cellCount, vec point, float minRadius, float maxRadius)
+{
+	return findCell(cells, cellCount, point, minRadius, maxRadius, -1.0f);
+}
+
+//! Invoked when the compiler sees 'countCellsWithin(point, distance)'.
+//! Counts the cells whose surface is within 'distance' from 'point'.
+//! A negative 'distance' counts the cells 'point' lies at least -distance
+//! deep inside, a cell smaller than that is never counted.
+int cell_countCellsWithin(Cell* cells, int cellCount, vec point, float distance)
+{
+	ivec4 total = 0;
+	int i;
+
+	for (i = 1; i < cellCount; i += LANES)
+	{
+		vec4 radius, x, y;
+		ivec4 active;
+		gather4(cells, i, cellCount, &radius, &x, &y, &active);
+
+		vec4 dx = x - point.x;
+		vec4 dy = y - point.y;
+		vec4 reach = distance + radius;
+
+		total -= active & (reach >= 0.0f) & (dx*dx + dy*dy <= reach*reach); // a set lane is -1
+	}
+
+	return (total.x + total.y) + (total.z + total.w);
+}
+
+//! Computes the area-weighted centroid of the cells smaller than the player
+//! ('wantPrey' set) or not smaller than the player. Returns the player's
+//! position if there are no such cells.
+static vec centroid(const Cell* cells, int cellCount, int wantPrey)
+{
+	vec4 sumWeight = 0.0f, sumX = 0.0f, sumY = 0.0f;
+	float playerRadius = cells[0].radius;
+	float weight;
+	int i;
+
+	for (i = 1; i < cellCount; i += LANES)
+	{
+		vec4 radius, x, y;
+		ivec4 active;
+		gather4(cells, i, cellCount, &radius, &x, &y, &active);
+
+		ivec4 smaller = radius < playerRadius;
+		ivec4 mask = active & (wantPrey ? smaller : ~smaller);
+		vec4 area = select4(mask, radius * radius, 0.0f); // pi cancels out
+
+		sumWeight += area;
+		sumX += area * x;
+		sumY += area * y;
+	}
+
+	weight = sum4(sumWeight);
+	if (weight <= 0.0f)
+		return cells[0].position;
+
+	return cell_makeVec(sum4(sumX) / weight, sum4(sumY) / weight);
+}
+
+//! Invoked when the compiler sees 'preyCentroid()'.
+vec cell_preyCentroid(Cell* cells, int cellCount)
+{
+	return centroid(cells, cellCount, 1);
+}
+
+//! Invoked when the compiler sees 'threatCentroid()'.
+vec cell_threatCentroid(Cell* cells, int cellCount)
+{
+	return centroid(cells, cellCount, 0);
+}
+
+//! Invoked when the compiler sees 'repulsion(point, minRadius)'.
+//! Sums inverse-square forces pushing 'point' away from every cell with radius
+//! of at least 'minRadius'. Each force is proportional to the cell's area.
+vec cell_repulsion(Cell* cells, int cellCount, vec point, float minRadius)
+{
+	vec4 sumX = 0.0f, sumY = 0.0f;
+	int i;
+
+	for (i = 1; i < cellCount; i += LANES)
+	{
+		vec4 radius, x, y;
+		ivec4 active;
+		gather4(cells, i, cellCount, &radius, &x, &y, &active);
+
+		vec4 dx = point.x - x;
+		vec4 dy = point.y - y;
+		vec4 distanceSquared = dx*dx + dy*dy;
+
+		ivec4 mask = active & (radius >= minRadius) & (distanceSquared > 1e-12f);
+		distanceSquared = select4(mask, distanceSquared, 1.0f);
+
+		// (r^2 / d^2) * (direction / d)
+		vec4 strength = select4(mask, (radius * radius) / (distanceSquared * sqrt4(distanceSquared)), 0.0f);
+		sumX += strength * dx;
+		sumY += strength * dy;
+	}
+
+	return cell_makeVec(sum4(sumX), sum4(sumY));
+}
 
 //! The main template. This function gets cloned each time the compiler is invoked
 //| which then populates its body with generated instructions.
-void cell_main_template(Cell* cells, int cellCount, float arenaRadius, vec* force)
+//! 'globals' points to the script's global variables. The caller keeps the block
+//! between invocations and zeroes it when the script is loaded.
+void cell_main_template(Cell* cells, int cellCount, float arenaRadius, vec* force, char* globals)
 {
 	return;
 }
@@ -0,0 +1,404 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "bytecode.h"
+#include "common.h"
+#include "error.h"
+
+#include <cstring> // memcpy()
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! The opcode descriptions, indexed by opcode.
+static const OpcodeInfo kOpcodes[] =
+{
+#define CELL_OPCODE_INFO(name, a, b, c) { #name, { a, b, c } },
+	CELL_OPCODES( CELL_OPCODE_INFO )
+#undef CELL_OPCODE_INFO
+};
+
+//! The builtin descriptions, indexed by builtin id.
+static const BuiltinInfo kBuiltins[] =
+{
+#define CELL_BUILTIN_INFO(id, name, result, count, p0, p1, p2, readsCells) { BUILTIN_##id, name, result, count, { p0, p1, p2 }, readsCells },
+	CELL_BUILTINS( CELL_BUILTIN_INFO )
+#undef CELL_BUILTIN_INFO
+};
+
+const OpcodeInfo& opcodeInfo(Opcode op)
+{
+	assert_msg(op < OPCODE_COUNT, "Invalid opcode: %d\n", op);
+	return kOpcodes[op];
+}
+
+const BuiltinInfo* findBuiltin(const std::string& name)
+{
+	for (int i = 0; i < BUILTIN_COUNT; ++i)
+	{
+		if (name == kBuiltins[i].name)
+			return &kBuiltins[i];
+	}
+	return nullptr;
+}
+
+void Program::clear()
+{
+	code.clear();
+	constants.clear();
+	constantTypes.clear();
+	arrays.clear();
+	localCount = 0;
+	registerCount = 0;
+}
+
+void dumpProgram(const Program& program, std::ostream& out)
+{
+	out << "registers: " << program.registerCount << " (" << program.constants.size() << " constants)\n";
+
+	for (size_t k = 0; k < program.constants.size(); ++k)
+	{
+		const Register& r = program.constants[k];
+		out << "  r" << program.localCount + k << " = ";
+
+		switch (program.constantTypes[k])
+		{
+		case TS_INT:
+			out << r.i << '\n';
+			break;
+
+		case TS_REAL:
+			out << r.f << "f\n";
+			break;
+
+		default:
+			out << "(" << r.v[0] << "f, " << r.v[1] << "f)\n";
+			break;
+		}
+	}
+
+	for (size_t k = 0; k < program.arrays.size(); ++k)
+		out << "  a" << k << " = r" << program.arrays[k].first << "[" << program.arrays[k].length << "]\n";
+
+	for (size_t pc = 0; pc < program.code.size(); ++pc)
+	{
+		const Instruction& instruction = program.code[pc];
+		const OpcodeInfo& info = opcodeInfo(static_cast<Opcode>(instruction.op));
+		const unsigned short operands[3] = { instruction.a, instruction.b, instruction.c };
+
+		out << "  " << pc << ":\t" << info.name;
+		for (int i = 0; i < 3; ++i)
+		{
+			switch (info.operands[i])
+			{
+			case OK_DEST:
+			case OK_UPDATE:
+			case OK_SOURCE:
+				out << (i ? ", r" : "\tr") << operands[i];
+				break;
+
+			case OK_IMM:
+				out << (i ? ", #" : "\t#") << operands[i];
+				break;
+
+			case OK_TARGET:
+				out << (i ? ", @" : "\t@") << operands[i];
+				break;
+
+			case OK_BUILTIN:
+				out << (i ? ", " : "\t") << kBuiltins[operands[i]].name;
+				break;
+
+			case OK_ARRAY:
+				out << (i ? ", a" : "\ta") << operands[i];
+				break;
+
+			default:
+				break;
+			}
+		}
+		out << '\n';
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Binary format
+//
+// All numbers are little-endian.
+//
+//   header:      "CELB", u16 version, u16 localCount, u16 constantCount, u16 arrayCount, u16 instructionCount
+//   constant:    u8 type, then an int or a real (4 bytes) or a vec (8 bytes)
+//   array:       u16 first register, u16 length
+//   instruction: u8 opcode, then a u16 for each operand which is not OK_NONE
+
+//! Identifies saved programs.
+static const char kBytecodeMagic[4] = { 'C', 'E', 'L', 'B' };
+
+static void writeByte(std::ostream& out, unsigned value)
+{
+	out.put(static_cast<char>(value & 0xFF));
+}
+
+static void writeShort(std::ostream& out, unsigned value)
+{
+	writeByte(out, value);
+	writeByte(out, value >> 8);
+}
+
+static void writeWord(std::ostream& out, unsigned value)
+{
+	writeShort(out, value);
+	writeShort(out, value >> 16);
+}
+
+static void writeFloat(std::ostream& out, float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof(bits));
+	writeWord(out, bits);
+}
+
+static unsigned readByte(std::istream& in)
+{
+	auto c = in.get();
+	if (c == std::istream::traits_type::eof())
+		CellError::raise("unexpected end of bytecode");
+	return static_cast<unsigned>(c) & 0xFF;
+}
+
+static unsigned readShort(std::istream& in)
+{
+	auto low = readByte(in);
+	return low | (readByte(in) << 8);
+}
+
+static unsigned readWord(std::istream& in)
+{
+	auto low = readShort(in);
+	return low | (readShort(in) << 16);
+}
+
+static float readFloat(std::istream& in)
+{
+	auto bits = readWord(in);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void validateProgram(const Program& program)
+{
+	auto localCount = program.localCount;
+	auto registerCount = program.registerCount;
+	auto codeSize = static_cast<int>(program.code.size());
+
+	if (localCount < REG_FIRST_FREE || registerCount > 0xFFFF ||
+		registerCount != localCount + static_cast<int>(program.constants.size()) ||
+		program.constants.size() != program.constantTypes.size())
+		CellError::raise("invalid bytecode: bad register counts");
+
+	for (auto it = program.constantTypes.begin(); it != program.constantTypes.end(); ++it)
+	{
+		if (*it != TS_INT && *it != TS_REAL && *it != TS_VECTOR)
+			CellError::raise("invalid bytecode: bad constant type");
+	}
+
+	// arrays are variables, so they are written like them
+	for (auto it = program.arrays.begin(); it != program.arrays.end(); ++it)
+	{
+		if (it->first < REG_FIRST_FREE || it->length == 0 || it->length > kMaxArrayLength || it->first + it->length > localCount)
+			CellError::raise("invalid bytecode: bad array");
+	}
+
+	// the code must not run past its end
+	if (program.code.empty() || (program.code.back().op != OP_RET && program.code.back().op != OP_JMP))
+		CellError::raise("invalid bytecode: missing return");
+
+	for (int pc = 0; pc < codeSize; ++pc)
+	{
+		const Instruction& instruction = program.code[pc];
+
+		if (instruction.op >= OPCODE_COUNT)
+			CellError::raise("invalid bytecode: bad opcode at %d", pc);
+
+		const OpcodeInfo& info = opcodeInfo(static_cast<Opcode>(instruction.op));
+		const unsigned short operands[3] = { instruction.a, instruction.b, instruction.c };
+
+		for (int i = 0; i < 3; ++i)
+		{
+			bool valid = true;
+
+			switch (info.operands[i])
+			{
+			case OK_NONE:
+				break;
+
+			case OK_DEST:
+			case OK_UPDATE: // constants are never written
+				valid = operands[i] < localCount;
+				break;
+
+			case OK_SOURCE:
+				valid = operands[i] < registerCount;
+				break;
+
+			case OK_IMM: // only vec elements are addressed by immediates
+				valid = operands[i] < 2;
+				break;
+
+			case OK_TARGET:
+				valid = operands[i] < codeSize;
+				break;
+
+			case OK_BUILTIN:
+				valid = operands[i] < BUILTIN_COUNT;
+				break;
+
+			case OK_ARRAY:
+				valid = operands[i] < program.arrays.size();
+				break;
+			}
+
+			if (!valid)
+				CellError::raise("invalid bytecode: bad operand %d of %s at %d", i + 1, info.name, pc);
+		}
+
+		// the arguments occupy consecutive registers
+		if (instruction.op == OP_CALL && instruction.c + kBuiltins[instruction.b].parameterCount > registerCount)
+			CellError::raise("invalid bytecode: bad arguments of %s at %d", info.name, pc);
+	}
+}
+
+void saveProgram(const Program& program, std::ostream& out)
+{
+	validateProgram(program);
+
+	out.write(kBytecodeMagic, sizeof(kBytecodeMagic));
+	writeShort(out, kBytecodeVersion);
+	writeShort(out, program.localCount);
+	writeShort(out, static_cast<unsigned>(program.constants.size()));
+	writeShort(out, static_cast<unsigned>(program.arrays.size()));
+	writeShort(out, static_cast<unsigned>(program.code.size()));
+
+	for (size_t k = 0; k < program.constants.size(); ++k)
+	{
+		const Register& r = program.constants[k];
+		auto type = program.constantTypes[k];
+
+		writeByte(out, type);
+		if (type == TS_INT)
+			writeWord(out, static_cast<unsigned>(r.i));
+		else if (type == TS_REAL)
+			writeFloat(out, r.f);
+		else
+		{
+			writeFloat(out, r.v[0]);
+			writeFloat(out, r.v[1]);
+		}
+	}
+
+	for (auto it = program.arrays.begin(); it != program.arrays.end(); ++it)
+	{
+		writeShort(out, it->first);
+		writeShort(out, it->length);
+	}
+
+	for (auto it = program.code.begin(); it != program.code.end(); ++it)
+	{
+		const OpcodeInfo& info = opcodeInfo(static_cast<Opcode>(it->op));
+		const unsigned short operands[3] = { it->a, it->b, it->c };
+
+		writeByte(out, it->op);
+		for (int i = 0; i < 3; ++i)
+		{
+			if (info.operands[i] != OK_NONE)
+				writeShort(out, operands[i]);
+		}
+	}
+
+	if (!out)
+		CellError::raise("cannot write bytecode");
+}
+
+void loadProgram(Program& program, std::istream& in)
+{
+	Program loaded;
+
+	char magic[sizeof(kBytecodeMagic)];
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, kBytecodeMagic, sizeof(magic)) != 0)
+		CellError::raise("not a bytecode file");
+
+	auto version = readShort(in);
+	if (version != kBytecodeVersion)
+		CellError::raise("unsupported bytecode version %u, expected %u", version, kBytecodeVersion);
+
+	loaded.localCount = readShort(in);
+	auto constantCount = readShort(in);
+	auto arrayCount = readShort(in);
+	auto instructionCount = readShort(in);
+	loaded.registerCount = loaded.localCount + constantCount;
+
+	loaded.constants.reserve(constantCount);
+	loaded.constantTypes.reserve(constantCount);
+	for (unsigned k = 0; k < constantCount; ++k)
+	{
+		Register r;
+		r.v[0] = r.v[1] = 0.0f;
+
+		auto type = static_cast<TypeSpecifier>(readByte(in));
+		if (type == TS_INT)
+			r.i = static_cast<int>(readWord(in));
+		else if (type == TS_REAL)
+			r.f = readFloat(in);
+		else if (type == TS_VECTOR)
+		{
+			r.v[0] = readFloat(in);
+			r.v[1] = readFloat(in);
+		}
+		else
+			CellError::raise("invalid bytecode: bad constant type");
+
+		loaded.constants.push_back(r);
+		loaded.constantTypes.push_back(type);
+	}
+
+	loaded.arrays.reserve(arrayCount);
+	for (unsigned k = 0; k < arrayCount; ++k)
+	{
+		ArrayInfo array;
+		array.first = static_cast<unsigned short>(readShort(in));
+		array.length = static_cast<unsigned short>(readShort(in));
+		loaded.arrays.push_back(array);
+	}
+
+	loaded.code.reserve(instructionCount);
+	for (unsigned pc = 0; pc < instructionCount; ++pc)
+	{
+		Instruction instruction = { static_cast<unsigned short>(readByte(in)), 0, 0, 0 };
+		if (instruction.op >= OPCODE_COUNT)
+			CellError::raise("invalid bytecode: bad opcode at %u", pc);
+
+		const OpcodeInfo& info = opcodeInfo(static_cast<Opcode>(instruction.op));
+		unsigned short* operands[3] = { &instruction.a, &instruction.b, &instruction.c };
+
+		for (int i = 0; i < 3; ++i)
+		{
+			if (info.operands[i] != OK_NONE)
+				*operands[i] = static_cast<unsigned short>(readShort(in));
+		}
+
+		loaded.code.push_back(instruction);
+	}
+
+	// never hand a malformed program to the interpreter
+	validateProgram(loaded);
+	program = loaded;
+}
+
+}} // chaos::cell
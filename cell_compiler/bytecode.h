@@ -0,0 +1,245 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_bytecode_H
+#define __CELL_bytecode_H
+
+#include "types.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace chaos { namespace cell {
+
+//! A register of the virtual machine. Holds an int, a real or a vec.
+union Register
+{
+	int   i;
+	float f;
+	float v[2];
+};
+
+//! Registers with a fixed meaning. They are set by the interpreter on each run.
+enum FixedRegister
+{
+	REG_CELL_COUNT,   //! '#CellCount'
+	REG_ARENA_RADIUS, //! '#ArenaRadius'
+	REG_FORCE,        //! '#Force', written back when the program returns
+	REG_FIRST_FREE
+};
+
+//! Kinds of instruction operands.
+enum OperandKind
+{
+	OK_NONE,    //! Unused.
+	OK_DEST,    //! Register which is overwritten.
+	OK_UPDATE,  //! Register which is partially overwritten.
+	OK_SOURCE,  //! Register which is read.
+	OK_IMM,     //! Immediate value.
+	OK_TARGET,  //! Index of an instruction.
+	OK_BUILTIN, //! Index of a builtin function.
+	OK_ARRAY    //! Index into Program::arrays.
+};
+
+//! The instruction set: name and kinds of the 'a', 'b' and 'c' operands.
+//! The opcodes are typed, the interpreter never checks types at run time.
+#define CELL_OPCODES(X) \
+	X( NOP,      OK_NONE,   OK_NONE,    OK_NONE   ) \
+	X( MOV,      OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( IADD,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( ISUB,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IMUL,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IDIV,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IMOD,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IAND,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IOR,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IXOR,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( ISHL,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( ISHR,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( INEG,     OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( INOT,     OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( LNOT,     OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( LAND,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( LOR,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IEQ,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( INE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( ILT,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( ILE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IGT,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( IGE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FADD,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FSUB,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FMUL,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FDIV,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FMOD,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FNEG,     OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( FEQ,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FNE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FLT,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FLE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FGT,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( FGE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VADD,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VSUB,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VMUL,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VDIV,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VMOD,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VNEG,     OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( VEQ,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VNE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VLT,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VLE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VGT,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VGE,      OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( SPLAT,    OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( VDOT,     OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VLEN,     OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( VNORM,    OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( VGET,     OK_DEST,   OK_SOURCE,  OK_IMM    ) \
+	X( VGETR,    OK_DEST,   OK_SOURCE,  OK_SOURCE ) \
+	X( VSET,     OK_UPDATE, OK_SOURCE,  OK_IMM    ) \
+	X( AGET,     OK_DEST,   OK_ARRAY,   OK_SOURCE ) \
+	X( ASET,     OK_ARRAY,  OK_SOURCE,  OK_SOURCE ) \
+	X( RADIUS,   OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( POSITION, OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( VELOCITY, OK_DEST,   OK_SOURCE,  OK_NONE   ) \
+	X( CALL,     OK_DEST,   OK_BUILTIN, OK_SOURCE ) \
+	X( JMP,      OK_NONE,   OK_TARGET,  OK_NONE   ) \
+	X( JZ,       OK_SOURCE, OK_TARGET,  OK_NONE   ) \
+	X( JNZ,      OK_SOURCE, OK_TARGET,  OK_NONE   ) \
+	X( RET,      OK_NONE,   OK_NONE,    OK_NONE   )
+
+//! Operation codes.
+enum Opcode
+{
+#define CELL_OPCODE_ENUM(name, a, b, c) OP_##name,
+	CELL_OPCODES( CELL_OPCODE_ENUM )
+#undef CELL_OPCODE_ENUM
+	OPCODE_COUNT
+};
+
+//! Describes an opcode.
+struct OpcodeInfo
+{
+	const char* name;
+	OperandKind operands[3];
+};
+
+//! Returns the description of \a op.
+const OpcodeInfo& opcodeInfo(Opcode op);
+
+//! A single instruction. 'a' is usually the destination register.
+//! CALL passes its arguments in consecutive registers starting at 'c'.
+//! AGET reads the element 'c' of the array 'b' into 'a'; ASET stores 'c' into
+//! the element 'b' of the array 'a'. An index out of range ends the run like RET.
+//! Elements at constant indices are accessed as plain registers instead.
+struct Instruction
+{
+	unsigned short op;
+	unsigned short a;
+	unsigned short b;
+	unsigned short c;
+};
+
+//! The builtin functions: enumerator, script name, result type, parameter count
+//! and types, and whether the function reads the cells. Their definitions in
+//! base.c are prefixed with 'cell_'; the ones that read the cells receive the
+//! cell array and the cell count as hidden leading parameters.
+#define CELL_BUILTINS(X) \
+	X( SQRT,               "sqrt",             TS_REAL,   1, TS_REAL,   TS_NONE,   TS_NONE, false ) \
+	X( LENGTH,             "length",           TS_REAL,   1, TS_VECTOR, TS_NONE,   TS_NONE, false ) \
+	X( NORMALIZE,          "normalize",        TS_VECTOR, 1, TS_VECTOR, TS_NONE,   TS_NONE, false ) \
+	X( DOT,                "dot",              TS_REAL,   2, TS_VECTOR, TS_VECTOR, TS_NONE, false ) \
+	X( MAKE_VEC,           "makeVec",          TS_VECTOR, 2, TS_REAL,   TS_REAL,   TS_NONE, false ) \
+	X( NEAREST_CELL,       "nearestCell",      TS_INT,    3, TS_VECTOR, TS_REAL,   TS_REAL, true  ) \
+	X( FARTHEST_CELL,      "farthestCell",     TS_INT,    3, TS_VECTOR, TS_REAL,   TS_REAL, true  ) \
+	X( COUNT_CELLS_WITHIN, "countCellsWithin", TS_INT,    2, TS_VECTOR, TS_REAL,   TS_NONE, true  ) \
+	X( PREY_CENTROID,      "preyCentroid",     TS_VECTOR, 0, TS_NONE,   TS_NONE,   TS_NONE, true  ) \
+	X( THREAT_CENTROID,    "threatCentroid",   TS_VECTOR, 0, TS_NONE,   TS_NONE,   TS_NONE, true  ) \
+	X( REPULSION,          "repulsion",        TS_VECTOR, 2, TS_VECTOR, TS_REAL,   TS_NONE, true  )
+
+//! Builtin function identifiers.
+enum BuiltinID
+{
+#define CELL_BUILTIN_ENUM(id, name, result, count, p0, p1, p2, readsCells) BUILTIN_##id,
+	CELL_BUILTINS( CELL_BUILTIN_ENUM )
+#undef CELL_BUILTIN_ENUM
+	BUILTIN_COUNT
+};
+
+//! Describes a builtin function.
+struct BuiltinInfo
+{
+	BuiltinID id;
+	const char* name;
+	TypeSpecifier result;
+	int parameterCount;
+	TypeSpecifier parameters[3];
+	bool readsCells;
+};
+
+//! Returns the builtin called \a name or \a nullptr if there is no such builtin.
+const BuiltinInfo* findBuiltin(const std::string& name);
+
+//! An array variable: consecutive registers starting at \a first.
+struct ArrayInfo
+{
+	unsigned short first;
+	unsigned short length;
+};
+
+//! A compiled script.
+//! The registers [0, localCount) hold the fixed registers, the variables and
+//! the temporaries; the registers [localCount, registerCount) hold the constants.
+struct Program
+{
+	Program() : localCount(0), registerCount(0)
+	{}
+
+	//! Empties the program.
+	void clear();
+
+	//! Returns \a true if there is nothing to run.
+	bool empty() const { return code.empty(); }
+
+	std::vector<Instruction> code;    //! The instructions; the last one is always RET.
+	std::vector<Register> constants;  //! Initial values of the constant registers.
+	std::vector<TypeSpecifier> constantTypes; //! Types of the constants, parallel to \a constants.
+	std::vector<ArrayInfo> arrays;    //! The arrays indexed at run time.
+	int localCount;                   //! Number of non-constant registers.
+	int registerCount;                //! Total number of registers.
+};
+
+//! Prints a human-readable listing of \a program.
+void dumpProgram(const Program& program, std::ostream& out);
+
+//! Version of the binary format written by saveProgram().
+//! Bump it whenever the instruction set or the layout changes.
+const unsigned short kBytecodeVersion = 2;
+
+//! The extension of files holding a saved program.
+const char* const kBytecodeExtension = ".cellbc";
+
+//! Checks that \a program cannot make the interpreter access memory outside
+//! its registers or code. Raises CellError otherwise. Cell indices are only
+//! known at run time, the interpreter checks them against the cell count.
+void validateProgram(const Program& program);
+
+//! Writes \a program to \a out in the compact binary format. \a out must be
+//! opened in binary mode.
+void saveProgram(const Program& program, std::ostream& out);
+
+//! Reads a program written by saveProgram() replacing \a program.
+//! Raises CellError on malformed input or a different version.
+void loadProgram(Program& program, std::istream& in);
+
+}} // chaos::cell
+
+#endif // __CELL_bytecode_H
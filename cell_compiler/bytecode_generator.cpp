@@ -0,0 +1,1257 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "bytecode_generator.h"
+#include "error.h"
+
+#include <algorithm> // max()
+#include <cstring> // memcmp()
+#include <vector>
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! Casts the generic ASTContext to the specific ContextType.
+#define MC (*contextFrom(ctx))
+
+//! Marks operands referring to the constant pool until finish() relocates them.
+const unsigned short kConstantFlag = 0x8000;
+
+//! Instruction indices and registers are 16-bit.
+const int kMaxInstructions = 0xFFFF;
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Makes an int register value.
+inline Register makeIntRegister(int value)
+{
+	Register r;
+	r.v[0] = r.v[1] = 0.0f;
+	r.i = value;
+	return r;
+}
+
+//! Makes a real register value.
+inline Register makeRealRegister(float value)
+{
+	Register r;
+	r.v[0] = r.v[1] = 0.0f;
+	r.f = value;
+	return r;
+}
+
+//! Makes a vec register value.
+inline Register makeVectorRegister(float x, float y)
+{
+	Register r;
+	r.v[0] = x;
+	r.v[1] = y;
+	return r;
+}
+
+//! Selects the int, real or vec flavour of an operation.
+inline Opcode selectOpcode(TypeSpecifier type, Opcode intOp, Opcode realOp, Opcode vectorOp)
+{
+	switch (type)
+	{
+	case TS_INT:
+		return intOp;
+
+	case TS_REAL:
+		return realOp;
+
+	default:
+		return vectorOp;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BytecodeGenerator
+
+BytecodeGenerator::BytecodeGenerator(Program& program)
+	: _program(program)
+	, _firstTemporary(REG_FIRST_FREE)
+	, _nextTemporary(REG_FIRST_FREE)
+	, _registerCount(REG_FIRST_FREE)
+	, _inlineFrame(nullptr)
+	, _lastTarget(-1)
+{
+	_program.clear();
+}
+
+BytecodeGenerator::~BytecodeGenerator()
+{}
+
+void BytecodeGenerator::finish()
+{
+	// every path must end in RET; jumps may target the end of the code
+	if (_program.code.empty() || _program.code.back().op != OP_RET)
+		emit(OP_RET);
+
+	// place the constants after the other registers
+	_program.localCount = _registerCount;
+	_program.registerCount = _registerCount + static_cast<int>(_program.constants.size());
+
+	if (_program.registerCount > 0xFFFF)
+		CellError::raise("script too large: too many registers");
+
+	for (auto it = _program.code.begin(); it != _program.code.end(); ++it)
+	{
+		const OpcodeInfo& info = opcodeInfo(static_cast<Opcode>(it->op));
+		unsigned short* operands[3] = { &it->a, &it->b, &it->c };
+
+		for (int i = 0; i < 3; ++i)
+		{
+			if (info.operands[i] == OK_SOURCE && (*operands[i] & kConstantFlag))
+				*operands[i] = static_cast<unsigned short>(_registerCount + (*operands[i] & ~kConstantFlag));
+		}
+	}
+}
+
+int BytecodeGenerator::emit(Opcode op, unsigned short a, unsigned short b, unsigned short c)
+{
+	if (here() >= kMaxInstructions)
+		CellError::raise("script too large: too many instructions");
+
+	Instruction instruction = { static_cast<unsigned short>(op), a, b, c };
+	_program.code.push_back(instruction);
+	return here() - 1;
+}
+
+void BytecodeGenerator::patchTarget(int instruction, int target)
+{
+	_program.code[instruction].b = static_cast<unsigned short>(target);
+
+	if (target == here())
+		_lastTarget = target;
+}
+
+void BytecodeGenerator::moveInto(unsigned short reg, const BytecodeValue& value)
+{
+	if (value.reg == reg)
+		return;
+
+	// retarget the instruction which has just computed the value instead of copying it,
+	// unless a jump lands after it: the returns of an expanded function all write the result
+	if (isTemporary(value.reg) && !_program.code.empty() && _lastTarget != here())
+	{
+		Instruction& last = _program.code.back();
+		if (last.a == value.reg && opcodeInfo(static_cast<Opcode>(last.op)).operands[0] == OK_DEST)
+		{
+			last.a = reg;
+			return;
+		}
+	}
+
+	emit(OP_MOV, reg, value.reg);
+}
+
+unsigned short BytecodeGenerator::resultRegister(const BytecodeValue& operand)
+{
+	// reuse the operand's register if it is the last temporary
+	if (isTemporary(operand.reg) && operand.reg + 1 == _nextTemporary)
+		return operand.reg;
+
+	return allocateTemporary();
+}
+
+unsigned short BytecodeGenerator::allocateTemporary()
+{
+	if (_nextTemporary + 1 >= kConstantFlag)
+		CellError::raise("script too large: too many registers");
+
+	_registerCount = max(_registerCount, static_cast<unsigned short>(_nextTemporary + 1));
+	return _nextTemporary++;
+}
+
+bool BytecodeGenerator::isTemporary(unsigned short reg) const
+{
+	return reg >= _firstTemporary && reg < kConstantFlag;
+}
+
+BytecodeValue BytecodeGenerator::makeConstant(TypeSpecifier type, const Register& value)
+{
+	auto& constants = _program.constants;
+	auto& constantTypes = _program.constantTypes;
+
+	size_t index = 0;
+	for (; index < constants.size(); ++index)
+	{
+		if (memcmp(&constants[index], &value, sizeof(Register)) == 0) // -0.0 and NaN patterns are kept apart
+			break;
+	}
+
+	if (index == constants.size())
+	{
+		if (index + 1 >= kConstantFlag)
+			CellError::raise("script too large: too many constants");
+		constants.push_back(value);
+		constantTypes.push_back(type);
+	}
+	else if (type == TS_VECTOR)
+	{
+		constantTypes[index] = TS_VECTOR; // a shared constant keeps both elements when saved
+	}
+
+	BytecodeValue result;
+	result.type = type;
+	result.reg = static_cast<unsigned short>(kConstantFlag | index);
+	return result;
+}
+
+bool BytecodeGenerator::constantValue(const BytecodeValue& value, Register& result) const
+{
+	if (value.type == TS_NONE || value.reader != OP_NOP || !(value.reg & kConstantFlag))
+		return false;
+
+	result = _program.constants[value.reg & ~kConstantFlag];
+	return true;
+}
+
+BytecodeValue BytecodeGenerator::evalExpression(ASTNode& node)
+{
+	ContextType newContext;
+	node.accept(*this, &newContext);
+	if (newContext.value.array >= 0)
+		CellError::raise(node.parsePosition(), "array element expected");
+	if (newContext.value.type == TS_VOID)
+		CellError::raise(node.parsePosition(), "function has no result");
+	return newContext.value;
+}
+
+BytecodeValue BytecodeGenerator::evalAddress(ASTNode& node, int* writeIndex)
+{
+	ContextType newContext;
+	newContext.wantsAddress = 1;
+	node.accept(*this, &newContext);
+	if (newContext.value.array >= 0 && !newContext.value.isElement)
+		CellError::raise(node.parsePosition(), "cannot assign arrays");
+	if (writeIndex)
+		*writeIndex = newContext.writeIndex;
+	return newContext.value;
+}
+
+bool BytecodeGenerator::visitIdentifier(IdentifierNode& node, ContextType& ctx)
+{
+	if (ASTNode::instanceof( node.parent(), RID_MEMBER_ACCESS ))
+	{ // accessing a member
+	}
+	else // referencing a normal variable
+	{
+		auto it = _symbols.find(node.id());
+
+		if (it == _symbols.end())
+			CellError::raise(node.parsePosition(), "identifier not found: %s", node.id().c_str());
+
+		// variables live in registers, so there is nothing to load
+		ctx.value = it->second;
+		ctx.value.isAddress = ctx.wantsAddress;
+	}
+	return true;
+}
+
+// && ||
+bool BytecodeGenerator::visitLogicalExpression(BinaryExpressionBase& node, ContextType& ctx)
+{
+	auto mark = _nextTemporary;
+	auto left  = evalExpression(*node.leftOperand());
+	auto right = evalExpression(*node.rightOperand());
+
+	if (left.type == TS_NONE || right.type == TS_NONE)
+		CellError::raise(node.parsePosition(), "null operand");
+
+	if (left.type != TS_INT || right.type != TS_INT)
+		CellError::raise(node.parsePosition(), "int expected");
+
+	// like the JIT-compiled code, both operands are always evaluated
+	releaseTemporaries(mark);
+	ctx.value.type = TS_INT;
+	ctx.value.reg = allocateTemporary();
+	emit(node.getOperator() == OP_AND ? OP_LAND : OP_LOR, ctx.value.reg, left.reg, right.reg);
+
+	return false;
+}
+
+// & ^ | << >>
+bool BytecodeGenerator::visitBitwiseExpression(BinaryExpressionBase& node, ContextType& ctx)
+{
+	auto mark = _nextTemporary;
+	auto left  = evalExpression(*node.leftOperand());
+	auto right = evalExpression(*node.rightOperand());
+
+	if (left.type == TS_NONE || right.type == TS_NONE)
+		CellError::raise(node.parsePosition(), "null operand");
+
+	auto op = node.getOperator();
+	auto makeDot = false;
+
+	if (op == OP_BITXOR)
+	{
+		if (left.type != TS_VECTOR || right.type != TS_VECTOR)
+			CellError::raise(node.parsePosition(), "vec expected");
+		makeDot = true;
+	}
+	else if (left.type != TS_INT || right.type != TS_INT)
+		CellError::raise(node.parsePosition(), "int expected");
+
+	Opcode opcode = OP_NOP;
+
+	switch (op)
+	{
+	case OP_BITAND: // &
+		opcode = OP_IAND;
+		break;
+
+	case OP_BITOR: // |
+		opcode = OP_IOR;
+		break;
+
+	case OP_BITXOR: // ^
+		opcode = makeDot ? OP_VDOT : OP_IXOR;
+		break;
+
+	case OP_LSHIFT: // <<
+		opcode = OP_ISHL;
+		break;
+
+	case OP_RSHIFT: // >>
+		opcode = OP_ISHR;
+		break;
+
+	default:
+		CellError::raise(node.parsePosition(), "operation not supported");
+	}
+
+	releaseTemporaries(mark);
+	ctx.value.type = makeDot ? TS_REAL : TS_INT;
+	ctx.value.reg = allocateTemporary();
+	emit(opcode, ctx.value.reg, left.reg, right.reg);
+
+	return false;
+}
+
+// == != > >= < <=
+bool BytecodeGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextType& ctx)
+{
+	auto mark = _nextTemporary;
+	auto left  = evalExpression(*node.leftOperand());
+	auto right = evalExpression(*node.rightOperand());
+
+	if (left.type == TS_NONE || right.type == TS_NONE)
+		CellError::raise(node.parsePosition(), "null operand");
+
+	if (left.type != right.type)
+		CellError::raise(node.parsePosition(), "cannot compare operands of different types");
+
+	// vectors compare true only if both elements do
+	Opcode opcode = OP_NOP;
+
+	switch (node.getOperator())
+	{
+	case OP_EQ: // ==
+		opcode = selectOpcode(left.type, OP_IEQ, OP_FEQ, OP_VEQ);
+		break;
+
+	case OP_NOTEQ: // !=
+		opcode = selectOpcode(left.type, OP_INE, OP_FNE, OP_VNE);
+		break;
+
+	case OP_GT: // >
+		opcode = selectOpcode(left.type, OP_IGT, OP_FGT, OP_VGT);
+		break;
+
+	case OP_GTEQ: // >=
+		opcode = selectOpcode(left.type, OP_IGE, OP_FGE, OP_VGE);
+		break;
+
+	case OP_LT: // <
+		opcode = selectOpcode(left.type, OP_ILT, OP_FLT, OP_VLT);
+		break;
+
+	case OP_LTEQ: // <=
+		opcode = selectOpcode(left.type, OP_ILE, OP_FLE, OP_VLE);
+		break;
+
+	default:
+		CellError::raise(node.parsePosition(), "operation not supported");
+	}
+
+	releaseTemporaries(mark);
+	ctx.value.type = TS_INT;
+	ctx.value.reg = allocateTemporary();
+	emit(opcode, ctx.value.reg, left.reg, right.reg);
+
+	return false;
+}
+
+// * / % + -
+bool BytecodeGenerator::visitBinaryExpression(BinaryExpressionBase& node, ContextType& ctx)
+{
+	auto mark = _nextTemporary;
+	auto left  = evalExpression(*node.leftOperand());
+	auto right = evalExpression(*node.rightOperand());
+
+	if (left.type == TS_NONE || right.type == TS_NONE)
+		CellError::raise(node.parsePosition(), "null operand");
+
+	// a real operand combined with a vec is splatted to both elements
+	BytecodeValue* scalar = nullptr;
+
+	if (left.type == TS_VECTOR && right.type == TS_REAL)
+		scalar = &right;
+	else if (left.type == TS_REAL && right.type == TS_VECTOR)
+		scalar = &left;
+	else if (left.type != right.type)
+		CellError::raise(node.parsePosition(), "operation not permitted");
+
+	if (scalar)
+	{
+		Register constant;
+		if (constantValue(*scalar, constant))
+		{
+			*scalar = makeConstant(TS_VECTOR, makeVectorRegister(constant.f, constant.f));
+		}
+		else
+		{
+			auto splat = allocateTemporary();
+			emit(OP_SPLAT, splat, scalar->reg);
+			scalar->reg = splat;
+			scalar->type = TS_VECTOR;
+		}
+	}
+
+	Opcode opcode = OP_NOP;
+
+	switch (node.getOperator())
+	{
+	case OP_MUL: // *
+		opcode = selectOpcode(left.type, OP_IMUL, OP_FMUL, OP_VMUL);
+		break;
+
+	case OP_DIV: // /
+		opcode = selectOpcode(left.type, OP_IDIV, OP_FDIV, OP_VDIV);
+		break;
+
+	case OP_MOD: // %
+		opcode = selectOpcode(left.type, OP_IMOD, OP_FMOD, OP_VMOD);
+		break;
+
+	case OP_PLUS: // +
+		opcode = selectOpcode(left.type, OP_IADD, OP_FADD, OP_VADD);
+		break;
+
+	case OP_MINUS: // -
+		opcode = selectOpcode(left.type, OP_ISUB, OP_FSUB, OP_VSUB);
+		break;
+
+	default:
+		CellError::raise(node.parsePosition(), "operation not supported");
+	}
+
+	releaseTemporaries(mark);
+	ctx.value.type = left.type;
+	ctx.value.reg = allocateTemporary();
+	emit(opcode, ctx.value.reg, left.reg, right.reg);
+
+	return false;
+}
+
+bool BytecodeGenerator::visitUnaryExpression(UnaryExpressionBase& node, ContextType& ctx)
+{
+	auto mark = _nextTemporary;
+	auto value = evalExpression(*node.operand());
+
+	if (value.type == TS_NONE)
+		CellError::raise(node.operand()->parsePosition(), "null operand");
+
+	Register constant;
+	Opcode opcode = OP_NOP;
+
+	switch (node.getOperator())
+	{
+	case OP_PLUS: // +
+		// do nothing, use the same value
+		ctx.value = value;
+		ctx.value.isAddress = 0;
+		return false;
+
+	case OP_MINUS: // -
+		if (constantValue(value, constant)) // fold negative literals
+		{
+			if (value.type == TS_INT)
+				ctx.value = makeConstant(TS_INT, makeIntRegister(static_cast<int>(0u - static_cast<unsigned>(constant.i))));
+			else if (value.type == TS_REAL)
+				ctx.value = makeConstant(TS_REAL, makeRealRegister(-constant.f));
+			else
+				ctx.value = makeConstant(TS_VECTOR, makeVectorRegister(-constant.v[0], -constant.v[1]));
+			return false;
+		}
+		opcode = selectOpcode(value.type, OP_INEG, OP_FNEG, OP_VNEG);
+		break;
+
+	case OP_NOT: // !
+		if (value.type != TS_INT)
+			CellError::raise(node.parsePosition(), "int or vec expected");
+		opcode = OP_LNOT;
+		break;
+
+	case OP_BITNOT:
+		if (value.type != TS_INT)
+			CellError::raise(node.parsePosition(), "int expected");
+		opcode = OP_INOT;
+		break;
+
+	default:
+		CellError::raise(node.parsePosition(), "operation not supported");
+	};
+
+	releaseTemporaries(mark);
+	ctx.value.type = value.type;
+	ctx.value.reg = allocateTemporary();
+	emit(opcode, ctx.value.reg, value.reg);
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Declarations
+
+bool BytecodeGenerator::visit(TypeModifierNode& node, ASTContext* ctx)
+{
+	MC.isGlobal = 1; // the only possible modifier is 'global'
+	return true;
+}
+
+bool BytecodeGenerator::preVisit(FunctionDefinitionNode& node, ASTContext* ctx)
+{
+	auto& name = node.name();
+	if (_functions.find(name) != _functions.end())
+		CellError::raise(node.declarator()->parsePosition(), "function redefinition: %s", name.c_str());
+
+	// the body is checked once here, so a function which is never called is
+	// rejected like IRGenerator does; the code is dropped, each call expands it again
+	auto codeSize = _program.code.size();
+	auto arrayCount = _program.arrays.size();
+
+	auto registerCount = _registerCount;
+
+	vector<ParameterNode*> parameters;
+	node.getParameters(parameters);
+
+	auto mark = _nextTemporary;
+	auto result = allocateTemporary();
+	auto firstRegister = _nextTemporary;
+	for (size_t i = 0; i < parameters.size(); ++i)
+		allocateTemporary();
+
+	inlineFunction(node, result, firstRegister);
+	releaseTemporaries(mark);
+
+	_program.code.resize(codeSize);
+	_program.arrays.resize(arrayCount);
+	_registerCount = registerCount;
+	_lastTarget = -1;
+
+	// only now the function can be called, so there is no recursion
+	_functions.insert( make_pair(name, &node) );
+
+	return false;
+}
+
+bool BytecodeGenerator::preVisit(VariableDeclarationNode& node, ASTContext* ctx)
+{
+	MC.reset();
+	return true;
+}
+
+bool BytecodeGenerator::visit(VariableDeclarationNode& node, ASTContext* ctx)
+{
+	// declarations are statements, so no temporaries are live here
+	assert_msg(_nextTemporary == _firstTemporary, "Live temporaries at a declaration\n");
+
+	if (MC.isGlobal && _inlineFrame)
+		CellError::raise(node.parsePosition(), "global variables belong to the main block");
+
+	// the elements of an array take consecutive registers
+	auto reg = allocateTemporary();
+	for (int i = 1; i < MC.nElements; ++i)
+		allocateTemporary();
+	_firstTemporary = _nextTemporary;
+
+	auto it = _symbols.find(MC.name);
+	if (it != _symbols.end())
+	{
+		it->second.type = node.type(); // attach the register to the symbol
+		it->second.reg = reg;
+
+		if (MC.nElements > 0)
+		{
+			ArrayInfo array = { reg, static_cast<unsigned short>(MC.nElements) };
+			it->second.array = static_cast<int>(_program.arrays.size());
+			_program.arrays.push_back(array);
+		}
+	}
+
+	// a global needs nothing more: every variable has a register of its own and
+	// the Interpreter keeps the registers between runs, zeroed when it loads the program
+
+	return true;
+}
+
+bool BytecodeGenerator::preVisit(VariableDeclaratorNode& node, ASTContext* ctx)
+{
+	if (_symbols.find(node.id()) != _symbols.end())
+		CellError::raise(node.parsePosition(), "variable redefenition", node.id());
+
+	_symbols.insert( make_pair(node.id(), BytecodeValue()) );
+	MC.name = node.id();
+
+	return true;
+}
+
+bool BytecodeGenerator::preVisit(ArraySpecifierNode& node, ASTContext* ctx)
+{
+	auto size = static_cast<IntegerLiteralNode*>(node.firstChild())->value();
+	if (size <= 0 || size > kMaxArrayLength)
+		CellError::raise(node.parsePosition(), "invalid array size");
+
+	MC.nElements = size;
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Literals
+
+bool BytecodeGenerator::visit(IntegerLiteralNode& node, ASTContext* ctx)
+{
+	MC.value = makeConstant(TS_INT, makeIntRegister(node.value()));
+	return true;
+}
+
+bool BytecodeGenerator::visit(RealLiteralNode& node, ASTContext* ctx)
+{
+	MC.value = makeConstant(TS_REAL, makeRealRegister(node.value()));
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Identifiers
+
+bool BytecodeGenerator::visit(IdentifierNode& node, ASTContext* ctx)
+{
+	return visitIdentifier(node, MC);
+}
+
+bool BytecodeGenerator::visit(QualifiedIdentifierNode& node, ASTContext* ctx)
+{
+	return visitIdentifier(node, MC);
+}
+
+bool BytecodeGenerator::visit(SystemIdentifierNode& node, ASTContext* ctx)
+{
+	auto& id = node.id();
+
+	MC.value = BytecodeValue();
+
+	if (id == "CellCount")
+	{
+		MC.value.type = TS_INT;
+		MC.value.reg = REG_CELL_COUNT;
+	}
+	else if (id == "ArenaRadius")
+	{
+		MC.value.type = TS_REAL;
+		MC.value.reg = REG_ARENA_RADIUS;
+	}
+	else if (id == "Radius")
+	{
+		MC.value.type = TS_REAL;
+		MC.value.reader = OP_RADIUS;
+	}
+	else if (id == "Position")
+	{
+		MC.value.type = TS_VECTOR;
+		MC.value.reader = OP_POSITION;
+	}
+	else if (id == "Velocity")
+	{
+		MC.value.type = TS_VECTOR;
+		MC.value.reader = OP_VELOCITY;
+	}
+	else if (id == "Force")
+	{
+		if (!MC.wantsAddress)
+			CellError::raise("write-only variable");
+		MC.value.type = TS_VECTOR;
+		MC.value.reg = REG_FORCE;
+		MC.value.isAddress = 1;
+	}
+	else
+	{
+		CellError::raise("unknown system variable");
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+
+void BytecodeGenerator::traverseStatement(ASTNode& node)
+{
+	ContextType newContext;
+	node.accept(*this, &newContext);
+}
+
+void BytecodeGenerator::checkStatement(ASTNode& node)
+{
+	// a statement which never runs is rejected like the others, but its code
+	// is dropped; the variables it declares keep their registers for the code after it
+	auto codeSize = _program.code.size();
+	auto exitCount = _inlineFrame ? _inlineFrame->exits.size() : 0;
+	auto lastTarget = _lastTarget;
+
+	traverseStatement(node);
+
+	_program.code.resize(codeSize);
+	if (_inlineFrame)
+		_inlineFrame->exits.resize(exitCount);
+	_lastTarget = lastTarget;
+}
+
+bool BytecodeGenerator::visit(BlockNode& node, ASTContext* ctx)
+{
+	if (node.endsMain())
+	{ // we are exiting form the 'main' block
+		emit(OP_RET);
+	}
+
+	return true;
+}
+
+bool BytecodeGenerator::visit(ExpressionStatementNode& node, ASTContext* ctx)
+{
+	// the temporaries of a statement die with it
+	releaseTemporaries(_firstTemporary);
+	return true;
+}
+
+bool BytecodeGenerator::preVisit(IfStatementNode& node, ASTContext* ctx)
+{
+	auto condition = evalExpression(*node.condition());
+
+	if (condition.type != TS_INT)
+		CellError::raise(node.parsePosition(), "invalid 'if' condition type");
+
+	releaseTemporaries(_firstTemporary);
+
+	bool hasElse = (node.elseBody() != nullptr);
+
+	// with a literal condition one body never runs, the other needs no jumps
+	if (auto literal = node.literalCondition())
+	{
+		if (literal->value())
+			traverseStatement( *node.thenBody() );
+		else
+			checkStatement( *node.thenBody() );
+
+		if (hasElse && literal->value())
+			checkStatement( *node.elseBody() );
+		else if (hasElse)
+			traverseStatement( *node.elseBody() );
+
+		return false;
+	}
+
+	auto jumpToElse = emit(OP_JZ, condition.reg);
+
+	// the then block
+	traverseStatement( *node.thenBody() );
+
+	// the else block
+	if (hasElse)
+	{
+		auto jumpToMerge = emit(OP_JMP);
+		patchTarget(jumpToElse, here());
+		traverseStatement( *node.elseBody() );
+		patchTarget(jumpToMerge, here());
+	}
+	else
+	{
+		patchTarget(jumpToElse, here());
+	}
+
+	return false;
+}
+
+bool BytecodeGenerator::preVisit(WhileStatementNode& node, ASTContext* ctx)
+{
+	// a loop whose condition is the literal 0 never runs
+	auto literal = node.literalCondition();
+	if (literal && literal->value() == 0)
+	{
+		checkStatement( *node.body() );
+		return false;
+	}
+
+	// the condition is placed after the body so each iteration takes a single jump
+	auto jumpToCondition = emit(OP_JMP);
+
+	// the loop body
+	auto body = here();
+	traverseStatement( *node.body() );
+
+	// the condition
+	patchTarget(jumpToCondition, here());
+	auto condition = evalExpression(*node.condition());
+
+	if (condition.type != TS_INT)
+		CellError::raise(node.parsePosition(), "invalid 'while' condition type");
+
+	releaseTemporaries(_firstTemporary);
+
+	// jump back to the body
+	auto jumpToBody = emit(OP_JNZ, condition.reg);
+	patchTarget(jumpToBody, body);
+
+	return false;
+}
+
+bool BytecodeGenerator::visit(QuitStatementNode& node, ASTContext* ctx)
+{
+	if (_inlineFrame)
+		CellError::raise(node.parsePosition(), "quit inside a function");
+
+	emit(OP_RET); // return from the main function
+	return true;
+}
+
+bool BytecodeGenerator::preVisit(ReturnStatementNode& node, ASTContext* ctx)
+{
+	if (!_inlineFrame)
+		CellError::raise(node.parsePosition(), "return outside a function");
+
+	if (node.value())
+	{
+		auto value = evalExpression(*node.value());
+		if (value.type != _inlineFrame->type)
+			CellError::raise(node.parsePosition(), "invalid return type");
+		moveInto(_inlineFrame->result, value);
+		releaseTemporaries(_firstTemporary);
+	}
+	else if (_inlineFrame->type != TS_VOID)
+	{
+		CellError::raise(node.parsePosition(), "return value expected");
+	}
+
+	// jump to the end of the expanded function
+	_inlineFrame->exits.push_back(emit(OP_JMP));
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+
+bool BytecodeGenerator::preVisit(MultiplicativeExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(AdditiveExpressionNode& node, ASTContext* ctx)
+{
+	return visitBinaryExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(RelationalExpressionNode& node, ASTContext* ctx)
+{
+	return visitRelationalExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(EqualityExpressionNode& node, ASTContext* ctx)
+{
+	return visitRelationalExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(ShiftExpressionNode& node, ASTContext* ctx)
+{
+	return visitBitwiseExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(AndExpressionNode& node, ASTContext* ctx)
+{
+	return visitBitwiseExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(ExclusiveOrExpressionNode& node, ASTContext* ctx)
+{
+	return visitBitwiseExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(InclusiveOrExpressionNode& node, ASTContext* ctx)
+{
+	return visitBitwiseExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(ConditionalAndExpressionNode& node, ASTContext* ctx)
+{
+	return visitLogicalExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(ConditionalOrExpressionNode& node, ASTContext* ctx)
+{
+	return visitLogicalExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(UnaryExpressionNode& node, ASTContext* ctx)
+{
+	return visitUnaryExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(PostfixExpressionNode& node, ASTContext* ctx)
+{
+	return visitUnaryExpression(node, MC);
+}
+
+bool BytecodeGenerator::preVisit(ConditionalExpressionNode& node, ASTContext* ctx)
+{
+	CellError::raise(node.parsePosition(), "operation not supported");
+	return false;
+}
+
+bool BytecodeGenerator::preVisit(ObjectCreationExpressionNode& node, ASTContext* ctx)
+{
+	CellError::raise(node.parsePosition(), "operation not supported");
+	return false;
+}
+
+bool BytecodeGenerator::preVisit(AssignmentNode& node, ASTContext* ctx)
+{
+	int writeIndex = -1;
+	auto right = evalExpression(*node.rightOperand());
+	auto left = evalAddress(*node.leftOperand(), &writeIndex);
+
+	if (!left.isAddress)
+		CellError::raise(node.parsePosition(), "cannot store in r-value");
+
+	if (right.type == TS_NONE)
+		CellError::raise(node.parsePosition(), "null operand");
+
+	// like the JIT-compiled code, compound assignments store the right operand
+	if (left.isElement) // an array element at a computed index
+	{
+		if (writeIndex >= 0)
+		{
+			if (right.type != TS_REAL)
+				CellError::raise(node.parsePosition(), "real expected");
+
+			auto element = allocateTemporary();
+			emit(OP_AGET, element, static_cast<unsigned short>(left.array), left.reg);
+			emit(OP_VSET, element, right.reg, static_cast<unsigned short>(writeIndex));
+			emit(OP_ASET, static_cast<unsigned short>(left.array), left.reg, element);
+		}
+		else
+		{
+			if (left.type != right.type)
+				CellError::raise(node.parsePosition(), "cannot assign operands of different types");
+			emit(OP_ASET, static_cast<unsigned short>(left.array), left.reg, right.reg);
+		}
+	}
+	else if (writeIndex >= 0) // we have insert element
+	{
+		if (right.type != TS_REAL)
+			CellError::raise(node.parsePosition(), "real expected");
+		emit(OP_VSET, left.reg, right.reg, static_cast<unsigned short>(writeIndex));
+	}
+	else
+	{
+		if (left.type != right.type)
+			CellError::raise(node.parsePosition(), "cannot assign operands of different types");
+		moveInto(left.reg, right);
+	}
+
+	MC.value = BytecodeValue(); // assignments have no value
+	return false;
+}
+
+bool BytecodeGenerator::preVisit(MemberAccessNode& node, ASTContext* ctx)
+{
+	if (MC.value.type != TS_VECTOR || MC.value.reader != OP_NOP || (MC.value.array >= 0 && !MC.value.isElement))
+		CellError::raise(node.parsePosition(), "only vectors have members");
+
+	auto first = node.firstChild();
+	auto member = ASTNode::instanceof(first, RID_QUALIFIED_IDENTIFIER) ? static_cast<QualifiedIdentifierNode*>(first) : nullptr;
+	auto& id = member->id();
+
+	if (MC.wantsAddress)
+	{
+		if (id == "x")
+			MC.writeIndex = 0;
+		else if (id == "y")
+			MC.writeIndex = 1;
+		else
+			CellError::raise(node.parsePosition(), "unknown member");
+	}
+	else
+	{
+		auto object = MC.value;
+		auto reg = resultRegister(object);
+
+		if (id == "x")
+		{
+			emit(OP_VGET, reg, object.reg, 0);
+			MC.value.type = TS_REAL;
+		}
+		else if (id == "y")
+		{
+			emit(OP_VGET, reg, object.reg, 1);
+			MC.value.type = TS_REAL;
+		}
+		else if (id == "length")
+		{
+			emit(OP_VLEN, reg, object.reg);
+			MC.value.type = TS_REAL;
+		}
+		else if (id == "normalized")
+		{
+			emit(OP_VNORM, reg, object.reg);
+			MC.value.type = TS_VECTOR;
+		}
+		else
+		{
+			CellError::raise(node.parsePosition(), "unknown member");
+		}
+
+		MC.value.reg = reg;
+		MC.value.isAddress = 0;
+	}
+
+	return false;
+}
+
+bool BytecodeGenerator::preVisit(ElementAccessNode& node, ASTContext* ctx)
+{
+	auto object = MC.value;
+	auto mark = _nextTemporary;
+	auto index = evalExpression(*node.firstChild());
+
+	if (index.type != TS_INT)
+		CellError::raise(node.parsePosition(), "int index expected");
+
+	Register constant;
+	if (object.array >= 0 && !object.isElement) // array access
+	{
+		const ArrayInfo& array = _program.arrays[object.array];
+
+		if (constantValue(index, constant))
+		{
+			// a constant index is checked here, the element is then a plain variable
+			if (constant.i < 0 || constant.i >= array.length)
+				CellError::raise(node.parsePosition(), "index out of range");
+			MC.value.reg = static_cast<unsigned short>(array.first + constant.i);
+			MC.value.array = -1;
+			MC.value.isAddress = MC.wantsAddress;
+			return false;
+		}
+
+		if (MC.wantsAddress)
+		{
+			// the assignment emits the store, the index stays in its register until then
+			MC.value.reg = index.reg;
+			MC.value.isElement = 1;
+			MC.value.isAddress = 1;
+			return false;
+		}
+
+		releaseTemporaries(mark);
+		MC.value.reg = allocateTemporary();
+		emit(OP_AGET, MC.value.reg, static_cast<unsigned short>(object.array), index.reg);
+		MC.value.array = -1;
+		MC.value.reader = OP_NOP;
+		MC.value.isAddress = 0;
+		return false;
+	}
+
+	releaseTemporaries(mark);
+
+	if (object.reader != OP_NOP) // one of '#Radius', '#Position' or '#Velocity'
+	{
+		MC.value.reg = allocateTemporary();
+		emit(object.reader, MC.value.reg, index.reg);
+	}
+	else if (object.type == TS_VECTOR) // vector access
+	{
+		MC.value.reg = resultRegister(object);
+
+		if (constantValue(index, constant))
+		{
+			if (constant.i != 0 && constant.i != 1)
+				CellError::raise(node.parsePosition(), "index out of range");
+			emit(OP_VGET, MC.value.reg, object.reg, static_cast<unsigned short>(constant.i));
+		}
+		else
+		{
+			emit(OP_VGETR, MC.value.reg, object.reg, index.reg);
+		}
+		MC.value.type = TS_REAL;
+	}
+	else
+	{
+		CellError::raise(node.parsePosition(), "array expected");
+	}
+
+	MC.value.reader = OP_NOP;
+	MC.value.isAddress = 0;
+
+	return false;
+}
+
+void BytecodeGenerator::inlineFunction(FunctionDefinitionNode& function, unsigned short result, unsigned short arguments)
+{
+	vector<ParameterNode*> parameters;
+	function.getParameters(parameters);
+
+	// the body sees only the parameters, which live in the argument registers
+	BytecodeSymbolMap symbols;
+	for (size_t i = 0; i < parameters.size(); ++i)
+	{
+		if (symbols.find(parameters[i]->name()) != symbols.end())
+			CellError::raise(parameters[i]->parsePosition(), "variable redefenition", parameters[i]->name());
+
+		BytecodeValue parameter;
+		parameter.type = parameters[i]->type();
+		parameter.reg = static_cast<unsigned short>(arguments + i);
+		symbols.insert( make_pair(parameters[i]->name(), parameter) );
+	}
+
+	symbols.swap(_symbols);
+
+	// the variables and temporaries of the body go above the live temporaries of the caller
+	auto firstTemporary = _firstTemporary;
+	_firstTemporary = _nextTemporary;
+
+	InlineFrame frame;
+	frame.type = function.type();
+	frame.result = result;
+
+	auto outerFrame = _inlineFrame;
+	_inlineFrame = &frame;
+
+	traverseStatement( *function.body() );
+
+	// a body ending in 'return' needs neither its jump nor the zero result
+	auto statements = function.body()->firstChild();
+	auto last = ASTNode::instanceof(statements, RID_STATEMENT_LIST) ? statements->lastChild() : statements;
+	if (ASTNode::instanceof(last, RID_RETURN_STATEMENT) && !frame.exits.empty() && frame.exits.back() == here() - 1)
+	{
+		_program.code.pop_back();
+		frame.exits.pop_back();
+	}
+	else if (frame.type != TS_VOID)
+	{
+		// falling off the end returns zero, like the JIT-compiled function
+		moveInto(result, makeConstant(frame.type, makeVectorRegister(0.0f, 0.0f)));
+	}
+
+	for (auto exit : frame.exits)
+		patchTarget(exit, here());
+
+	_inlineFrame = outerFrame;
+	_firstTemporary = firstTemporary;
+	symbols.swap(_symbols);
+}
+
+bool BytecodeGenerator::preVisit(InvocationNode& node, ASTContext* ctx)
+{
+	auto calleeName = static_cast<QualifiedIdentifierNode*>(node.invocationName())->id();
+
+	// a single argument is not wrapped in an argument list
+	vector<ASTNode*> arguments;
+	auto list = node.invocationArguments();
+	if (ASTNode::instanceof(list, RID_ARGUMENT_LIST))
+	{
+		for (auto arg = list->firstChild(); arg != nullptr; arg = arg->nextSibling())
+			arguments.push_back(arg);
+	}
+	else if (list)
+	{
+		arguments.push_back(list);
+	}
+
+	auto argumentCount = static_cast<int>(arguments.size());
+
+	// the functions of the script hide the builtins
+	auto function = _functions.find(calleeName);
+	if (function != _functions.end())
+	{
+		vector<ParameterNode*> parameters;
+		function->second->getParameters(parameters);
+
+		if (argumentCount != static_cast<int>(parameters.size()))
+			CellError::raise(node.parsePosition(), "%s expects %d arguments", calleeName.c_str(), static_cast<int>(parameters.size()));
+
+		// the result comes first, so it stays when the arguments are released
+		auto mark = _nextTemporary;
+		auto result = allocateTemporary();
+		auto firstRegister = _nextTemporary;
+		for (int i = 0; i < argumentCount; ++i)
+			allocateTemporary();
+
+		for (int i = 0; i < argumentCount; ++i)
+		{
+			auto value = evalExpression(*arguments[i]);
+			if (value.type != parameters[i]->type())
+				CellError::raise(arguments[i]->parsePosition(), "invalid type of argument %d of %s", i + 1, calleeName.c_str());
+
+			moveInto(static_cast<unsigned short>(firstRegister + i), value);
+			releaseTemporaries(static_cast<unsigned short>(firstRegister + argumentCount));
+		}
+
+		inlineFunction(*function->second, result, firstRegister);
+
+		releaseTemporaries(mark);
+		MC.value = BytecodeValue();
+		MC.value.type = function->second->type();
+		MC.value.reg = allocateTemporary();
+		return false;
+	}
+
+	auto callee = findBuiltin(calleeName);
+
+	if (!callee)
+		CellError::raise(node.parsePosition(), "function not found %s", calleeName.c_str());
+
+	if (argumentCount != callee->parameterCount)
+		CellError::raise(node.parsePosition(), "%s expects %d arguments", calleeName.c_str(), callee->parameterCount);
+
+	// the arguments are passed in consecutive registers
+	auto mark = _nextTemporary;
+	auto firstRegister = _nextTemporary;
+	for (int i = 0; i < argumentCount; ++i)
+		allocateTemporary();
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		auto value = evalExpression(*arguments[i]);
+		if (value.type != callee->parameters[i])
+			CellError::raise(arguments[i]->parsePosition(), "invalid type of argument %d of %s", i + 1, calleeName.c_str());
+
+		moveInto(static_cast<unsigned short>(firstRegister + i), value);
+		releaseTemporaries(static_cast<unsigned short>(firstRegister + argumentCount));
+	}
+
+	releaseTemporaries(mark);
+	MC.value = BytecodeValue();
+	MC.value.type = callee->result;
+	MC.value.reg = allocateTemporary();
+	emit(OP_CALL, MC.value.reg, static_cast<unsigned short>(callee->id), argumentCount ? firstRegister : MC.value.reg);
+
+	return false;
+}
+
+}} // chaos::cell
@@ -0,0 +1,177 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_bytecode_generator_H
+#define __CELL_bytecode_generator_H
+
+#include "boost/unordered_map.hpp"
+#include "ast_visitor.h"
+#include "bytecode.h"
+
+#include <vector>
+
+namespace chaos { namespace cell {
+
+//! A value computed by the generated code.
+struct BytecodeValue
+{
+	BytecodeValue() : type(TS_NONE), reg(0), reader(OP_NOP), array(-1), isAddress(0), isElement(0)
+	{}
+
+	TypeSpecifier type; //! TS_NONE if the expression has no value. The element type of arrays.
+	unsigned short reg; //! The register holding the value. The first element of arrays, the index of elements.
+	Opcode reader;      //! Set for '#Radius', '#Position' and '#Velocity' which must be indexed.
+	int array;          //! Index into Program::arrays for arrays and their elements, -1 otherwise.
+	unsigned isAddress : 1; //! Set if the register may be stored into.
+	unsigned isElement : 1; //! Set for an array element at a computed index, stored with ASET.
+};
+
+//! Propagates data during AST traversal.
+struct BytecodeContext : ASTContext
+{
+	BytecodeContext()
+	{ reset(); }
+
+	virtual ~BytecodeContext()
+	{}
+
+	void reset()
+	{
+		value = BytecodeValue();
+		wantsAddress = 0;
+		isGlobal = 0;
+		nElements = 0;
+		writeIndex = -1;
+		name.clear();
+	}
+
+	BytecodeValue value; //! The evaluation result.
+	unsigned wantsAddress : 1; //! Return the register of the evaluated expression for storing.
+	unsigned isGlobal : 1; //! Set if marked with 'global'
+	unsigned unused : 30; // ! Reserved bits.
+	int nElements; //! Number of array elements.
+	int writeIndex; //! Index of the vector element to store into, -1 for the whole value.
+	std::string name; //! Name of the declared variable.
+};
+
+//! The symbol table maps variables to their registers.
+typedef boost::unordered_map<std::string, BytecodeValue> BytecodeSymbolMap;
+
+//! The functions defined by the script, by name.
+typedef boost::unordered_map<std::string, FunctionDefinitionNode*> BytecodeFunctionMap;
+
+//! Generates register-based bytecode for the Interpreter from the AST.
+//! Follows the same rules as IRGenerator, so both backends accept the same
+//! scripts and compute the same results. The functions of the script are
+//! expanded at each call, the Interpreter has no calls of its own.
+class BytecodeGenerator : public ASTVisitorMix<BytecodeContext>
+{
+public:
+	BytecodeGenerator(Program& program);
+	virtual ~BytecodeGenerator();
+
+	//! Terminates the code and places the constants after the other registers.
+	//! Call once after the traversal.
+	void finish();
+
+	virtual bool visit(IntegerLiteralNode& node, ASTContext* ctx);
+	virtual bool visit(RealLiteralNode& node, ASTContext* ctx);
+
+	virtual bool visit(TypeModifierNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(FunctionDefinitionNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(VariableDeclarationNode& node, ASTContext* ctx);
+	virtual bool visit(VariableDeclarationNode& node, ASTContext* ctx);
+	virtual bool preVisit(VariableDeclaratorNode& node, ASTContext* ctx);
+	virtual bool preVisit(ArraySpecifierNode& node, ASTContext* ctx);
+
+	virtual bool visit(IdentifierNode& node, ASTContext* ctx);
+	virtual bool visit(QualifiedIdentifierNode& node, ASTContext* ctx);
+	virtual bool visit(SystemIdentifierNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(MemberAccessNode& node, ASTContext* ctx);
+	virtual bool preVisit(ElementAccessNode& node, ASTContext* ctx);
+
+	virtual bool visit(BlockNode& node, ASTContext* ctx);
+	virtual bool visit(ExpressionStatementNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(InvocationNode& node, ASTContext* ctx);
+	virtual bool preVisit(ObjectCreationExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ConditionalExpressionNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(IfStatementNode& node, ASTContext* ctx);
+	virtual bool preVisit(WhileStatementNode& node, ASTContext* ctx);
+	virtual bool visit(QuitStatementNode& node, ASTContext* ctx);
+	virtual bool preVisit(ReturnStatementNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(AssignmentNode& node, ASTContext* ctx);
+
+	virtual bool preVisit(MultiplicativeExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(AdditiveExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(RelationalExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(EqualityExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(AndExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ExclusiveOrExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(InclusiveOrExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ConditionalAndExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ConditionalOrExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(ShiftExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(UnaryExpressionNode& node, ASTContext* ctx);
+	virtual bool preVisit(PostfixExpressionNode& node, ASTContext* ctx);
+
+private:
+	//! A function being expanded.
+	struct InlineFrame
+	{
+		TypeSpecifier type;       //! The type of the result.
+		unsigned short result;    //! The register receiving the result.
+		std::vector<int> exits;   //! The jumps of the 'return' statements, patched to the end of the function.
+	};
+
+	//! Expands the body of \a function. Its arguments are in the live temporaries from \a arguments on.
+	void inlineFunction(FunctionDefinitionNode& function, unsigned short result, unsigned short arguments);
+	void traverseStatement(ASTNode& node);
+	void checkStatement(ASTNode& node);
+	BytecodeValue evalExpression(ASTNode& node);
+	BytecodeValue evalAddress(ASTNode& node, int* writeIndex = nullptr);
+	bool visitIdentifier(IdentifierNode& node, ContextType& ctx);
+	bool visitLogicalExpression(BinaryExpressionBase& node, ContextType& ctx);
+	bool visitBitwiseExpression(BinaryExpressionBase& node, ContextType& ctx);
+	bool visitRelationalExpression(BinaryExpressionBase& node, ContextType& ctx);
+	bool visitBinaryExpression(BinaryExpressionBase& node, ContextType& ctx);
+	bool visitUnaryExpression(UnaryExpressionBase& node, ContextType& ctx);
+
+	// Code emission
+	int emit(Opcode op, unsigned short a = 0, unsigned short b = 0, unsigned short c = 0);
+	void patchTarget(int instruction, int target);
+	int here() const { return static_cast<int>(_program.code.size()); }
+	unsigned short resultRegister(const BytecodeValue& operand);
+	void moveInto(unsigned short reg, const BytecodeValue& value);
+
+	// Registers
+	unsigned short allocateTemporary();
+	void releaseTemporaries(unsigned short mark) { _nextTemporary = mark; }
+	bool isTemporary(unsigned short reg) const;
+	BytecodeValue makeConstant(TypeSpecifier type, const Register& value);
+	bool constantValue(const BytecodeValue& value, Register& result) const;
+
+private:
+	BytecodeSymbolMap _symbols; //! the symbol table of the main block or of the function being expanded
+	BytecodeFunctionMap _functions; //! the functions defined so far
+	Program& _program; //! the program to be populated
+	unsigned short _firstTemporary; //! registers below hold the fixed registers and the variables
+	unsigned short _nextTemporary; //! the first unused temporary register
+	unsigned short _registerCount; //! number of non-constant registers used so far
+	InlineFrame* _inlineFrame; //! the innermost function being expanded, null in the main block
+	int _lastTarget; //! the last jump target at the end of the code, -1 if none
+};
+
+}} // chaos::cell
+
+#endif // __CELL_bytecode_generator_H
@@ -8,10 +8,12 @@
 
 #include "cell_compiler.h"
 #include "ast_dumper.h"
+#include "ast_optimizer.h"
 #include "string_utils.h"
 #include "ir_generator.h"
+#include "bytecode_generator.h"
 
-#include <fstream>
+#include <iostream>
 
 namespace chaos { namespace cell {
 
@@ -31,6 +33,8 @@ void dumpAST(const TreeParseResult& parseResult)
 // CellCompiler implementation
 
 CellCompiler::CellCompiler()
+	: _globalsSize(0)
+	, _parsed(false)
 {}
 
 CellCompiler::~CellCompiler()
@@ -41,20 +45,51 @@ void CellCompiler::run(llvm::Module* module, const std::string& filePath, const
 	if (!module)
 		CellError::raise("null module");
 
+	_globalsSize = 0;
+
+	if (!parse(filePath))
+		CellError::raise("cannot parse %s", filePath.c_str());
+
+	_globalsSize = generate(module, functionName);
+}
+
+bool CellCompiler::parse(const std::string& filePath)
+{
 	_ast.clear();
-	
-	processUnit(filePath);
+	SyntaxErrorHandler::nErrors = 0; // errors from a previous script must not block this one
+
+	_parsed = processUnit(filePath);
+	return _parsed;
+}
+
+size_t CellCompiler::generate(llvm::Module* module, const std::string& functionName)
+{
+	if (!module)
+		CellError::raise("null module");
+
+	if (!_parsed)
+		return 0;
+
+	IRGenerator irGenerator(*module, functionName, _options);
+	irGenerator.traverse(_ast);
+#ifdef _DEBUG
+	module->dump();
+#endif
+	return irGenerator.globalsSize();
+}
+
+void CellCompiler::generateBytecode(Program& program)
+{
+	program.clear();
 
-	if (!SyntaxErrorHandler::hasErrors())
+	if (_parsed)
 	{
-		if (module)
-		{
-			IRGenerator irGenerator(*module, functionName);
-			irGenerator.traverse(_ast);
+		BytecodeGenerator bytecodeGenerator(program);
+		bytecodeGenerator.traverse(_ast);
+		bytecodeGenerator.finish();
 #ifdef _DEBUG
-			module->dump();
+		dumpProgram(program, cout);
 #endif
-		}
 	}
 }
 
@@ -64,20 +99,18 @@ bool CellCompiler::processUnit(const std::string& unitPath)
 
 	cout << "Processing: " << path << endl;
 
-	ifstream in(path.c_str());
-	if (!in)
-        return false;
+	// the tree maps the source while it is parsed, its nodes point into it
+	auto unitAST = new ASTTree;
+	if (!unitAST->load(path))
+	{
+		delete unitAST;
+		return false;
+	}
 
-	in.unsetf(ios::skipws); // turn off white space skipping on the stream
-	
-	typedef istream_iterator<string::value_type> InputIterator;
-	
-	InputIterator first(in);
-	InputIterator last;
-	string        source;
-	
-	copy(first, last, back_inserter(source));
+	const SourceFile& source = unitAST->source();
 
+#ifdef CELL_SPIRIT_PARSER
+	// the original front end, kept to check the Parser against
 	ParseIterator begin(source.begin(), source.end(), path);
 	ParseIterator end;
 
@@ -90,6 +123,7 @@ bool CellCompiler::processUnit(const std::string& unitPath)
 	{
 		auto it = result.stop;
 		string text(result.stop, safe_advance(it, end, 50));
+		delete unitAST;
 		return false;
 	}
 
@@ -97,11 +131,29 @@ bool CellCompiler::processUnit(const std::string& unitPath)
 		dumpAST(result);
 #endif
 
-	auto unitAST = new ASTTree;
-	unitAST->build(result.trees.begin(), path);
+	unitAST->build(result.trees.begin());
+#else
+	Parser parser;
+	if (!parser.parse(source.begin(), source.end(), path))
+	{
+		delete unitAST;
+		return false;
+	}
+
+	unitAST->build(parser);
+#endif
 
 	if (SyntaxErrorHandler::hasErrors())
+	{
+		delete unitAST;
 		return false;
+	}
+
+	// both backends generate their code from the optimized tree
+	ASTOptimizer().traverse(*unitAST);
+
+	// errors found while generating code still need the text for their positions
+	unitAST->detachSource();
 
 	_ast.addChild(unitAST);
 	return true;
@@ -10,16 +10,21 @@
 #define __CELL_compiler_H
 
 #include "cell_grammar.h"
+#include "bytecode.h"
 
 namespace llvm {
 	class Module;
+	class LLVMContext;
 }
 
 namespace chaos { namespace cell {
 
-//! Loads a module from a .bc file.
+//! Loads a module from a .bc file into the global LLVM context.
 llvm::Module* loadModule(const char* modulePath);
 
+//! Loads a module from a .bc file into the given LLVM context.
+llvm::Module* loadModule(const char* modulePath, llvm::LLVMContext& context);
+
 //! 
 class CellCompiler
 {
@@ -27,13 +32,43 @@ public:
 	CellCompiler();
 	~CellCompiler();
 
+	//! Parses the script and generates its function into \a module.
+	//! See globalsSize() for the block the function takes as its last argument.
 	void run(llvm::Module* module, const std::string& filePath, const std::string& functionName);
 
+	//! Parses the script, replacing the previously parsed one.
+	//! Returns \a false on syntax errors.
+	bool parse(const std::string& filePath);
+
+	//! Generates the function for the last parsed script into \a module.
+	//! Does nothing if the last parse() failed.
+	//! The module may belong to any LLVM context, so several modules can be
+	//! generated from the same parse, one at a time.
+	//! Returns the size in bytes of the block holding the script's global variables.
+	size_t generate(llvm::Module* module, const std::string& functionName);
+
+	//! Sets how generate() compiles the real math of the script.
+	void setOptions(const CodeGenOptions& options) { _options = options; }
+
+	//! Gets the options the native code is generated with.
+	const CodeGenOptions& options() const { return _options; }
+
+	//! Gets the size of the globals block of the function generated by the last run().
+	//! The caller allocates the block zeroed, 8-byte aligned, and keeps it between calls.
+	size_t globalsSize() const { return _globalsSize; }
+
+	//! Generates bytecode for the Interpreter from the last parsed script.
+	//! \a program is left empty on syntax errors.
+	void generateBytecode(Program& program);
+
 private:
 	void doRun();
 	bool processUnit(const std::string& unitPath);
 
 	ASTTree _ast; //! The root node.
+	CodeGenOptions _options; //! Used by generate().
+	size_t _globalsSize; //! Set by run(). generate() leaves it alone, it may be called from other threads.
+	bool _parsed; //! Set by parse(). The error count of SyntaxErrorHandler is shared, generate() must not read it.
 };
 
 }} //chaos::cell
@@ -87,6 +87,12 @@ struct CellGrammar : public grammar<CellGrammar>
 	// Basic concepts											    
 		rule<ScannerT, parser_tag<RID_START_SYMBOL> >               start_symbol;
 		rule<ScannerT, parser_tag<RID_TRANSLATION_UNIT> >           translation_unit;
+		rule<ScannerT, parser_tag<RID_FUNCTION_DEFINITION> >        function_definition;
+		rule<ScannerT, parser_tag<RID_FUNCTION_MODIFIER> >          function_modifier;
+		rule<ScannerT, parser_tag<RID_FUNCTION_MODIFIER> >          fast_modifier;
+		rule<ScannerT, parser_tag<RID_FUNCTION_DECLARATOR> >        function_declarator;
+		rule<ScannerT, parser_tag<RID_PARAMETER_LIST> >             parameter_list;
+		rule<ScannerT, parser_tag<RID_PARAMETER> >                  parameter;
 																    
 	// Types													    
 		rule<ScannerT, parser_tag<RID_TYPE_SPECIFIER> >             type_specifier;
@@ -136,6 +142,7 @@ struct CellGrammar : public grammar<CellGrammar>
 		rule<ScannerT, parser_tag<RID_WHILE_STATEMENT> >            while_statement;
 		rule<ScannerT, parser_tag<RID_STATEMENT_EXPRESSION_LIST> >  statement_expression_list;
 		rule<ScannerT, parser_tag<RID_QUIT_STATEMENT> >             quit_statement;
+		rule<ScannerT, parser_tag<RID_RETURN_STATEMENT> >           return_statement;
 		rule<ScannerT, parser_tag<RID_QUALIFIED_IDENTIFIER> >       qualified_identifier;
 		rule<ScannerT, parser_tag<RID_ARRAY_SPECIFIER> >            array_specifier;
 	};
@@ -172,7 +179,7 @@ CellGrammar::definition<ScannerT>::definition(const CellGrammar& self)
 		FALSE_T,
 		IF_T, INT_T,
 		QUIT_T,
-		REAL_T,
+		REAL_T, RETURN_T,
 		TRUE_T,
 		WHILE_T
 		;
@@ -241,7 +248,10 @@ CellGrammar::definition<ScannerT>::definition(const CellGrammar& self)
 		QUIT_SY              = QUIT_T,
 		ELSE_SY              = ELSE_T,
 		FALSE_SY             = FALSE_T,
+		FAST_SY              = FAST_T,
 		IF_SY                = IF_T,
+		INLINE_SY            = INLINE_T,
+		RETURN_SY            = RETURN_T,
 		TRUE_SY              = TRUE_T,
 		WHILE_SY             = WHILE_T
 		;
@@ -252,6 +262,7 @@ CellGrammar::definition<ScannerT>::definition(const CellGrammar& self)
 		REAL_SY              = REAL_T,
 		INT_SY               = INT_T,
 		VECTOR_SY            = VECTOR_T,
+		VOID_SY              = VOID_T,
 		GLOBAL_SY            = GLOBAL_T
 		;
 	
@@ -382,11 +393,48 @@ CellGrammar::definition<ScannerT>::definition(const CellGrammar& self)
 	translation_unit
 		=
 		(	
-			+block
+			+( function_definition | block )
 		)
 		| epsilon_p
 		;
 
+	function_definition
+		=
+		guard
+		(
+				!function_modifier
+			>>	!fast_modifier
+			>>	root_node_d[ token_node_d[ type_specifier | VOID_SY ] ]
+			>>	function_declarator
+			>>	skip_node_d[ LPAREN_SY ]
+			>>	!parameter_list
+			>>	skip_node_d[ expectRParen( RPAREN_SY ) ]
+			>>	expectLBrace( block )
+		)
+		[ eh ]
+		;
+
+	function_modifier
+		= INLINE_SY
+		;
+
+	fast_modifier
+		= FAST_SY
+		;
+
+	function_declarator
+		= root_node_d[ IDENTIFIER ]
+		;
+
+	parameter_list
+		= parameter % skip_node_d[ COMMA_SY ]
+		;
+
+	parameter
+		=	root_node_d[ token_node_d[ type_specifier ] ]
+		>>	variable_declarator
+		;
+
 // Types
 
 	type_specifier
@@ -593,6 +641,7 @@ CellGrammar::definition<ScannerT>::definition(const CellGrammar& self)
 		| if_statement
 		| while_statement
 		| quit_statement
+		| return_statement
 		;
 
 	block
@@ -708,6 +757,17 @@ CellGrammar::definition<ScannerT>::definition(const CellGrammar& self)
 		[ eh ]
 		;
 
+	return_statement
+		=
+		guard
+		(
+				root_node_d[ RETURN_SY ]
+			>>	!expression
+			>>	skip_node_d[ expectSemicolon( SEMICOLON_SY ) ]
+		)
+		[ eh ]
+		;
+
 	qualified_identifier
 		= root_node_d[ IDENTIFIER ]
 		;
@@ -0,0 +1,320 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "cell_lexer.h"
+#include "common.h"
+#include "tokens.h"
+
+#include <cctype>
+#include <cstring> // strlen()
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! The words which are not identifiers. Same as CellGrammar::keywords.
+static const char* const kKeywords[] =
+{
+	ELSE_T, FALSE_T, IF_T, INT_T, QUIT_T, REAL_T, RETURN_T, TRUE_T, WHILE_T
+};
+
+// The character classes of Spirit, which are those of the "C" locale
+
+inline bool isSpace(char c)  { return isspace(static_cast<unsigned char>(c)) != 0; }
+inline bool isDigit(char c)  { return isdigit(static_cast<unsigned char>(c)) != 0; }
+inline bool isXDigit(char c) { return isxdigit(static_cast<unsigned char>(c)) != 0; }
+inline bool isIdentifierStart(char c) { return isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+inline bool isIdentifierChar(char c)  { return isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Lexer
+
+Lexer::Lexer()
+	: _first(nullptr)
+	, _size(0)
+	, _cursor(0)
+	, _skipFrom(-1)
+	, _skipTo(-1)
+{}
+
+void Lexer::reset(const char* first, const char* last)
+{
+	_first = first;
+	_size = static_cast<int>(last - first);
+	_cursor = 0;
+	_skipFrom = _skipTo = -1;
+	_lines.reset(first, last);
+}
+
+bool Lexer::atEnd()
+{
+	return skip(_cursor) == _size;
+}
+
+bool Lexer::matchChar(char c, Token& token)
+{
+	auto first = skip(_cursor);
+	if (first == _size || _first[first] != c)
+		return false;
+
+	token.first = first;
+	token.last = _cursor = first + 1;
+	return true;
+}
+
+bool Lexer::matchString(const char* text, Token& token)
+{
+	auto first = skip(_cursor);
+	auto length = static_cast<int>(strlen(text));
+	if (length > _size - first || memcmp(_first + first, text, length) != 0)
+		return false;
+
+	token.first = first;
+	token.last = _cursor = first + length;
+	return true;
+}
+
+bool Lexer::matchIdentifier(Token& token)
+{
+	auto first = skip(_cursor);
+	auto last = scanIdentifier(first);
+	if (last < 0)
+		return false;
+
+	token.first = first;
+	token.last = _cursor = last;
+	return true;
+}
+
+bool Lexer::matchSystemIdentifier(Token& token)
+{
+	auto first = skip(_cursor);
+	if (at(first) != SYSTEM_PREFIX_T)
+		return false;
+
+	// the nested lexeme_d of IDENTIFIER skips whitespace after the prefix
+	auto last = scanIdentifier(skip(first + 1));
+	if (last < 0)
+		return false;
+
+	token.first = first;
+	token.last = _cursor = last;
+	return true;
+}
+
+bool Lexer::matchTypeSpecifier(Token& token)
+{
+	return matchString(INT_T, token)
+		|| matchString(REAL_T, token)
+		|| matchString(VECTOR_T, token);
+}
+
+RuleID Lexer::matchIntegerLiteral(Token& token)
+{
+	auto first = skip(_cursor);
+	auto rid = RID_UNKNOWN;
+	auto last = scanInteger(first, rid);
+	if (last < 0)
+		return RID_UNKNOWN;
+
+	token.first = first;
+	token.last = _cursor = last;
+	return rid;
+}
+
+RuleID Lexer::matchLiteral(Token& token)
+{
+	auto first = skip(_cursor);
+
+	auto rid = RID_UNKNOWN;
+	auto last = scanInteger(first, rid);
+
+	// longest_d: a real literal wins if it is longer
+	auto realLast = scanReal(first);
+	if (realLast > last)
+	{
+		rid = RID_REAL_LITERAL;
+		last = realLast;
+	}
+
+	// booleans never start like numbers
+	if (last < 0)
+	{
+		const char* const booleans[] = { FALSE_T, TRUE_T };
+		for (int i = 0; i < 2 && last < 0; ++i)
+		{
+			auto length = static_cast<int>(strlen(booleans[i]));
+			if (length <= _size - first && memcmp(_first + first, booleans[i], length) == 0)
+			{
+				rid = RID_BOOLEAN_LITERAL;
+				last = first + length;
+			}
+		}
+	}
+
+	if (last < 0)
+		return RID_UNKNOWN;
+
+	token.first = first;
+	token.last = _cursor = last;
+	return rid;
+}
+
+int Lexer::skip(int offset)
+{
+	if (offset == _skipFrom)
+		return _skipTo;
+
+	_skipFrom = offset;
+
+	while (offset < _size)
+	{
+		auto c = _first[offset];
+
+		if (isSpace(c))
+			++offset;
+		else if (c == '/' && at(offset + 1) == '/')
+		{
+			// a line comment takes its end of line
+			offset += 2;
+			while (offset < _size && _first[offset] != '\n' && _first[offset] != '\r')
+				++offset;
+			if (offset < _size && _first[offset] == '\r')
+				++offset;
+			if (offset < _size && _first[offset] == '\n')
+				++offset;
+		}
+		else if (c == '/' && at(offset + 1) == '*')
+		{
+			// an unterminated comment is not skipped
+			auto end = offset + 2;
+			while (end + 1 < _size && !(_first[end] == '*' && _first[end + 1] == '/'))
+				++end;
+			if (end + 1 >= _size)
+				break;
+			offset = end + 2;
+		}
+		else
+			break;
+	}
+
+	_skipTo = offset;
+	return offset;
+}
+
+int Lexer::scanIdentifier(int offset) const
+{
+	if (offset >= _size || !isIdentifierStart(_first[offset]))
+		return -1;
+
+	auto last = offset + 1;
+	while (last < _size && isIdentifierChar(_first[last]))
+		++last;
+
+	// a keyword is an identifier only at the very end of the source
+	if (last < _size)
+	{
+		auto length = static_cast<size_t>(last - offset);
+		for (size_t i = 0; i < _countof(kKeywords); ++i)
+		{
+			if (strlen(kKeywords[i]) == length && memcmp(_first + offset, kKeywords[i], length) == 0)
+				return -1;
+		}
+	}
+
+	return last;
+}
+
+int Lexer::scanInteger(int offset, RuleID& rid) const
+{
+	if (offset >= _size || !isDigit(_first[offset]))
+		return -1;
+
+	// the alternatives are tried in order, the first match wins
+	if (_first[offset] == '0' && tolower(at(offset + 1)) == 'x' && offset + 2 < _size && isXDigit(_first[offset + 2]))
+	{
+		auto last = offset + 3;
+		while (last < _size && isXDigit(_first[last]))
+			++last;
+		rid = RID_INTEGER_LITERAL_HEX;
+		return last;
+	}
+
+	if (_first[offset] == '0' && at(offset + 1) >= '0' && at(offset + 1) <= '7')
+	{
+		auto last = offset + 2;
+		while (last < _size && _first[last] >= '0' && _first[last] <= '7')
+			++last;
+		rid = RID_INTEGER_LITERAL_OCT;
+		return last;
+	}
+
+	rid = RID_INTEGER_LITERAL_DEC;
+	return scanDigits(offset);
+}
+
+int Lexer::scanReal(int offset) const
+{
+	auto digits = scanDigits(offset);
+
+	// 12345[eE][+-]123[fF]?
+	if (digits > offset)
+	{
+		auto last = scanRealSuffix(digits, true);
+		if (last > digits)
+			return last;
+	}
+
+	// .123([[eE][+-]123)?[fF]?
+	if (at(digits) == '.')
+	{
+		auto fraction = scanDigits(digits + 1);
+		if (fraction > digits + 1)
+			return scanRealSuffix(fraction, false);
+
+		// 12345.([[eE][+-]123)?[fF]?
+		if (digits > offset)
+			return scanRealSuffix(digits + 1, false);
+	}
+
+	return -1;
+}
+
+int Lexer::scanRealSuffix(int offset, bool hasExponent) const
+{
+	auto last = offset;
+
+	if (at(last) == 'e' || at(last) == 'E')
+	{
+		auto exponent = last + 1;
+		if (at(exponent) == '+' || at(exponent) == '-')
+			++exponent;
+
+		auto digits = scanDigits(exponent);
+		if (digits > exponent)
+			last = digits;
+	}
+
+	// the first form needs the exponent
+	if (hasExponent && last == offset)
+		return offset;
+
+	if (at(last) == 'f' || at(last) == 'F')
+		++last;
+
+	return last;
+}
+
+int Lexer::scanDigits(int offset) const
+{
+	while (offset < _size && isDigit(_first[offset]))
+		++offset;
+	return offset;
+}
+
+}} // chaos::cell
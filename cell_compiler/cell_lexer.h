@@ -0,0 +1,110 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_lexer_H
+#define __CELL_lexer_H
+
+#include "rules.h"
+#include "line_map.h"
+
+namespace chaos { namespace cell {
+
+//! A piece of source text matched by the Lexer. Offsets into the source.
+struct Token
+{
+	int first;
+	int last;
+};
+
+//! Recognizes the tokens of the CeLL language for the Parser.
+//! CellGrammar matches keywords and type names as plain prefixes (the 'vec' of
+//! 'vector' is a type specifier) and picks literals by the longest match, so the
+//! source cannot be split into tokens up front. Instead the Parser asks for the
+//! token it expects at the cursor and the Lexer answers exactly like the Spirit
+//! primitives would. Whitespace and comments are skipped before each token.
+class Lexer
+{
+public:
+	Lexer();
+
+	//! Starts over on the source [first, last). The source must outlive the lexer.
+	void reset(const char* first, const char* last);
+
+	//! Gets the current offset. It is never moved past whitespace by a failed match.
+	int cursor() const { return _cursor; }
+
+	//! Moves the cursor back to an offset returned by cursor().
+	void setCursor(int offset) { _cursor = offset; }
+
+	//! Moves the cursor past the whitespace and comments.
+	void skipSpace() { _cursor = skip(_cursor); }
+
+	//! Returns \a true if only whitespace and comments follow the cursor.
+	bool atEnd();
+
+	//! Matches the character \a c.
+	bool matchChar(char c, Token& token);
+
+	//! Matches \a text. Keywords are matched the same way, they may be followed by letters.
+	bool matchString(const char* text, Token& token);
+
+	//! Matches an identifier which is not a keyword.
+	bool matchIdentifier(Token& token);
+
+	//! Matches '#' followed by an identifier. Whitespace may come in between.
+	bool matchSystemIdentifier(Token& token);
+
+	//! Matches 'int', 'real' or 'vec'.
+	bool matchTypeSpecifier(Token& token);
+
+	//! Matches a hexadecimal, octal or decimal integer. Returns RID_UNKNOWN if none.
+	RuleID matchIntegerLiteral(Token& token);
+
+	//! Matches the longest of an integer, real or boolean literal. Returns RID_UNKNOWN if none.
+	RuleID matchLiteral(Token& token);
+
+	//! Returns the source text at \a offset.
+	const char* text(int offset) const { return _first + offset; }
+
+	//! Computes the line and column of \a offset the way Spirit's position_iterator does.
+	void position(int offset, int& line, int& column) const { _lines.position(_first + offset, line, column); }
+
+private:
+	//! Returns the offset of the first character after the whitespace and comments at \a offset.
+	int skip(int offset);
+
+	//! Returns the end of the identifier at \a offset or -1.
+	int scanIdentifier(int offset) const;
+
+	//! Returns the end of the integer literal at \a offset or -1.
+	int scanInteger(int offset, RuleID& rid) const;
+
+	//! Returns the end of the real literal at \a offset or -1.
+	int scanReal(int offset) const;
+
+	//! Returns the end of the optional exponent and suffix of a real literal at \a offset.
+	int scanRealSuffix(int offset, bool hasExponent) const;
+
+	//! Returns the end of the digits at \a offset, \a offset if there are none.
+	int scanDigits(int offset) const;
+
+	//! Returns the character at \a offset or 0 past the end.
+	char at(int offset) const { return offset < _size ? _first[offset] : 0; }
+
+private:
+	const char* _first;
+	int         _size;
+	int         _cursor;
+	int         _skipFrom; //! The last skip() is remembered, backtracking asks for it again
+	int         _skipTo;
+	LineMap     _lines;
+};
+
+}} // chaos::cell
+
+#endif // __CELL_lexer_H
@@ -0,0 +1,939 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "cell_parser.h"
+#include "cell_grammar.h" // SyntaxErrorHandler
+#include "tokens.h"
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! A binary expression rule and its operators, in the order of the grammar.
+struct BinaryRule
+{
+	RuleID      rid;
+	const char* operators[5];
+};
+
+//! The binary expression rules from the loosest to the tightest binding.
+static const BinaryRule kBinaryRules[] =
+{
+	{ RID_CONDITIONAL_OR_EXPRESSION,  { OROR_T, nullptr } },
+	{ RID_CONDITIONAL_AND_EXPRESSION, { ANDAND_T, nullptr } },
+	{ RID_INCLUSIVE_OR_EXPRESSION,    { "|", nullptr } },
+	{ RID_EXCLUSIVE_OR_EXPRESSION,    { "^", nullptr } },
+	{ RID_AND_EXPRESSION,             { "&", nullptr } },
+	{ RID_EQUALITY_EXPRESSION,        { EQEQ_T, NOTEQ_T, nullptr } },
+	{ RID_RELATIONAL_EXPRESSION,      { LTEQ_T, GTEQ_T, "<", ">", nullptr } },
+	{ RID_SHIFT_EXPRESSION,           { LTLT_T, GTGT_T, nullptr } },
+	{ RID_ADDITIVE_EXPRESSION,        { "+", "-", nullptr } },
+	{ RID_MULTIPLICATIVE_EXPRESSION,  { "*", "/", "%", nullptr } },
+};
+
+static const char* const kUnaryOperators[] =
+{
+	"!", "~", PLUSPLUS_T, MINUSMINUS_T, "+", "-", nullptr
+};
+
+static const char* const kPostfixOperators[] =
+{
+	PLUSPLUS_T, MINUSMINUS_T, nullptr
+};
+
+//! '=' comes first, so '==' is never taken for an assignment.
+static const char* const kAssignmentOperators[] =
+{
+	"=", PLUSEQ_T, MINUSEQ_T, STAREQ_T, SLASHEQ_T, MODEQ_T,
+	XOREQ_T, ANDEQ_T, OREQ_T, GTGTEQ_T, LTLTEQ_T, nullptr
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Parser
+
+Parser::Parser()
+	: _root(-1)
+{}
+
+bool Parser::parse(const char* first, const char* last, const std::string& filename)
+{
+	_lexer.reset(first, last);
+	_nodes.clear();
+	_filename = filename;
+
+	// the scanner skips the leading whitespace before the first rule starts
+	_lexer.skipSpace();
+
+	// start_symbol = translation_unit >> !end_p
+	_root = parseTranslationUnit();
+	if (!_lexer.atEnd())
+	{
+		_root = -1;
+		return false;
+	}
+
+	return true;
+}
+
+NodeSource Parser::nodeSource(int index) const
+{
+	const ParseNode& node = _nodes[index];
+
+	NodeSource source;
+	source.rid = node.rid;
+	source.first = node.first < 0 ? nullptr : _lexer.text(node.first);
+	source.last = node.first < 0 ? nullptr : _lexer.text(node.last);
+	return source;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+
+int Parser::parseTranslationUnit()
+{
+	auto first = _lexer.cursor();
+
+	TreeList trees;
+	for (;;)
+	{
+		auto tree = parseFunctionDefinition();
+		if (tree == kNoMatch)
+			tree = parseBlock();
+		if (tree == kNoMatch)
+			break;
+
+		addTree(trees, tree);
+	}
+
+	// epsilon_p still leaves an empty node for the start symbol
+	if (trees.count == 0)
+		return addNode(RID_START_SYMBOL, -1, -1);
+
+	return addGroup(RID_TRANSLATION_UNIT, first, trees);
+}
+
+int Parser::parseFunctionDefinition()
+{
+	auto start = mark();
+	Token token;
+
+	auto modifier = kNoTree;
+	if (_lexer.matchString(INLINE_T, token))
+		modifier = addNode(RID_FUNCTION_MODIFIER, token);
+
+	auto fastModifier = kNoTree;
+	if (_lexer.matchString(FAST_T, token))
+		fastModifier = addNode(RID_FUNCTION_MODIFIER, token);
+
+	auto first = _lexer.cursor();
+	Token type;
+	if (!_lexer.matchTypeSpecifier(type) && !_lexer.matchString(VOID_T, type))
+		return fail(start);
+
+	auto declarator = parseFunctionDeclarator();
+	if (declarator == kNoMatch)
+		return fail(start);
+
+	if (!_lexer.matchChar(LPAREN_T, token))
+		return fail(start);
+
+	auto parameters = parseParameterList();
+	if (parameters == kNoMatch)
+		parameters = kNoTree;
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return error(start, ") expected");
+
+	auto body = parseBlock();
+	if (body == kNoMatch)
+		return error(start, "{ expected");
+
+	auto node = addNode(RID_FUNCTION_DEFINITION, first, type.last, modifier, fastModifier, declarator);
+	addChild(node, parameters);
+	addChild(node, body);
+	return node;
+}
+
+int Parser::parseFunctionDeclarator()
+{
+	auto first = _lexer.cursor();
+	Token token;
+
+	if (!_lexer.matchIdentifier(token))
+		return kNoMatch;
+
+	return addNode(RID_FUNCTION_DECLARATOR, first, token.last);
+}
+
+int Parser::parseParameterList()
+{
+	auto first = _lexer.cursor();
+
+	auto parameter = parseParameter();
+	if (parameter == kNoMatch)
+		return kNoMatch;
+
+	TreeList parameters;
+	addTree(parameters, parameter);
+
+	for (;;)
+	{
+		auto next = mark();
+		Token token;
+
+		if (!_lexer.matchChar(COMMA_T, token))
+			break;
+
+		parameter = parseParameter();
+		if (parameter == kNoMatch)
+		{
+			rewind(next);
+			break;
+		}
+
+		addTree(parameters, parameter);
+	}
+
+	return addGroup(RID_PARAMETER_LIST, first, parameters);
+}
+
+int Parser::parseParameter()
+{
+	auto start = mark();
+	Token type;
+
+	auto first = _lexer.cursor();
+	if (!_lexer.matchTypeSpecifier(type))
+		return kNoMatch;
+
+	auto declarator = parseVariableDeclarator();
+	if (declarator == kNoMatch)
+		return fail(start);
+
+	return addNode(RID_PARAMETER, first, type.last, declarator);
+}
+
+int Parser::parseBlock()
+{
+	auto start = mark();
+	Token brace, token;
+
+	if (!_lexer.matchChar(LBRACE_T, brace))
+		return kNoMatch;
+
+	auto statements = parseStatementList();
+
+	if (!_lexer.matchChar(RBRACE_T, token))
+		return error(start, "} expected");
+
+	return addNode(RID_BLOCK, brace, statements);
+}
+
+int Parser::parseStatementList()
+{
+	auto first = _lexer.cursor();
+
+	TreeList statements;
+	for (int statement; (statement = parseStatement()) != kNoMatch; )
+		addTree(statements, statement);
+
+	return addGroup(RID_STATEMENT_LIST, first, statements);
+}
+
+int Parser::parseStatement()
+{
+	auto statement = parseDeclarationStatement();
+	if (statement == kNoMatch)
+		statement = parseEmbeddedStatement();
+	return statement;
+}
+
+int Parser::parseEmbeddedStatement()
+{
+	auto statement = parseBlock();
+	if (statement == kNoMatch)
+		statement = parseEmptyStatement();
+	if (statement == kNoMatch)
+		statement = parseExpressionStatement();
+	if (statement == kNoMatch)
+		statement = parseIfStatement();
+	if (statement == kNoMatch)
+		statement = parseWhileStatement();
+	if (statement == kNoMatch)
+		statement = parseQuitStatement();
+	if (statement == kNoMatch)
+		statement = parseReturnStatement();
+	return statement;
+}
+
+int Parser::parseEmptyStatement()
+{
+	Token token;
+	if (!_lexer.matchChar(SEMICOLON_T, token))
+		return kNoMatch;
+
+	// the skipped ';' leaves an empty node as well
+	return addNode(RID_EMPTY_STATEMENT, -1, -1);
+}
+
+int Parser::parseDeclarationStatement()
+{
+	auto start = mark();
+	Token token;
+
+	auto declaration = parseVariableDeclaration();
+	if (declaration == kNoMatch)
+		return kNoMatch;
+
+	if (!_lexer.matchChar(SEMICOLON_T, token))
+		return error(start, "; expected");
+
+	return declaration;
+}
+
+int Parser::parseVariableDeclaration()
+{
+	auto start = mark();
+	Token token;
+
+	auto modifier = kNoTree;
+	if (_lexer.matchString(GLOBAL_T, token))
+		modifier = addNode(RID_TYPE_MODIFIER, token);
+
+	auto first = _lexer.cursor();
+	if (!_lexer.matchTypeSpecifier(token))
+		return fail(start);
+
+	auto array = parseArraySpecifier();
+	if (array == kNoMatch)
+		array = kNoTree;
+
+	auto declarator = parseVariableDeclarator();
+	if (declarator == kNoMatch)
+		return fail(start);
+
+	return addNode(RID_VARIABLE_DECLARATION, first, token.last, modifier, array, declarator);
+}
+
+int Parser::parseVariableDeclarator()
+{
+	auto first = _lexer.cursor();
+	Token token;
+
+	if (!_lexer.matchIdentifier(token))
+		return kNoMatch;
+
+	return addNode(RID_VARIABLE_DECLARATOR, first, token.last);
+}
+
+int Parser::parseArraySpecifier()
+{
+	auto start = mark();
+	Token bracket, token;
+
+	if (!_lexer.matchChar(LBRACKET_T, bracket))
+		return kNoMatch;
+
+	auto first = _lexer.cursor();
+	auto rid = _lexer.matchIntegerLiteral(token);
+	if (rid == RID_UNKNOWN)
+		return error(start, "constant expected");
+
+	auto size = addNode(rid, first, token.last);
+
+	if (!_lexer.matchChar(RBRACKET_T, token))
+		return error(start, "] expected");
+
+	return addNode(RID_ARRAY_SPECIFIER, bracket, size);
+}
+
+int Parser::parseExpressionStatement()
+{
+	auto start = mark();
+	Token semicolon;
+
+	auto expression = parseStatementExpression();
+	if (expression == kNoMatch)
+		return kNoMatch;
+
+	if (!_lexer.matchChar(SEMICOLON_T, semicolon))
+		return error(start, "; expected");
+
+	return addNode(RID_EXPRESSION_STATEMENT, semicolon, expression);
+}
+
+int Parser::parseStatementExpression()
+{
+	auto expression = parseAssignment();
+	if (expression == kNoMatch)
+		expression = parseConditionalExpression();
+	if (expression == kNoMatch)
+		expression = parseUnaryExpression();
+	return expression;
+}
+
+int Parser::parseIfStatement()
+{
+	auto start = mark();
+	Token keyword, token;
+
+	if (!_lexer.matchString(IF_T, keyword))
+		return kNoMatch;
+
+	if (!_lexer.matchChar(LPAREN_T, token))
+		return error(start, "( expected");
+
+	auto condition = parseExpression();
+	if (condition == kNoMatch)
+		return error(start, "expression expected");
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return error(start, ") expected");
+
+	auto thenBody = parseEmbeddedStatement();
+	if (thenBody == kNoMatch)
+		return fail(start);
+
+	auto elseBody = parseElseStatement();
+
+	return addNode(RID_IF_STATEMENT, keyword, condition, thenBody, elseBody);
+}
+
+int Parser::parseElseStatement()
+{
+	auto start = mark();
+	Token keyword;
+
+	if (_lexer.matchString(ELSE_T, keyword))
+	{
+		auto body = parseEmbeddedStatement();
+		if (body != kNoMatch)
+			return addNode(RID_ELSE_STATEMENT, keyword, body);
+
+		rewind(start);
+	}
+
+	return kNoTree;
+}
+
+int Parser::parseWhileStatement()
+{
+	auto start = mark();
+	Token keyword, token;
+
+	if (!_lexer.matchString(WHILE_T, keyword))
+		return kNoMatch;
+
+	if (!_lexer.matchChar(LPAREN_T, token))
+		return error(start, "( expected");
+
+	auto condition = parseExpression();
+	if (condition == kNoMatch)
+		return error(start, "expression expected");
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return error(start, ") expected");
+
+	auto body = parseEmbeddedStatement();
+	if (body == kNoMatch)
+		return fail(start);
+
+	return addNode(RID_WHILE_STATEMENT, keyword, condition, body);
+}
+
+int Parser::parseQuitStatement()
+{
+	auto start = mark();
+	Token keyword, token;
+
+	if (!_lexer.matchString(QUIT_T, keyword))
+		return kNoMatch;
+
+	if (!_lexer.matchChar(SEMICOLON_T, token))
+		return error(start, "; expected");
+
+	return addNode(RID_QUIT_STATEMENT, keyword);
+}
+
+int Parser::parseReturnStatement()
+{
+	auto start = mark();
+	Token keyword, token;
+
+	if (!_lexer.matchString(RETURN_T, keyword))
+		return kNoMatch;
+
+	auto value = parseExpression();
+	if (value == kNoMatch)
+		value = kNoTree;
+
+	if (!_lexer.matchChar(SEMICOLON_T, token))
+		return error(start, "; expected");
+
+	return addNode(RID_RETURN_STATEMENT, keyword, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+
+int Parser::parseExpression()
+{
+	auto expression = parseConditionalExpression();
+	if (expression == kNoMatch)
+		expression = parseAssignment();
+	return expression;
+}
+
+int Parser::parseAssignment()
+{
+	auto start = mark();
+	Token token;
+
+	auto target = parseUnaryExpression();
+	if (target == kNoMatch)
+		return kNoMatch;
+
+	auto first = _lexer.cursor();
+	if (!matchOperator(kAssignmentOperators, token))
+		return fail(start);
+
+	auto value = parseExpression();
+	if (value == kNoMatch)
+		return fail(start);
+
+	return addNode(RID_ASSIGNMENT, first, token.last, target, value);
+}
+
+int Parser::parseConditionalExpression()
+{
+	auto start = mark();
+	Token question, token;
+
+	auto condition = parseBinaryExpression(0);
+	if (condition == kNoMatch)
+		return kNoMatch;
+
+	auto optional = mark();
+	if (_lexer.matchChar(QUESTION_T, question))
+	{
+		auto left = parseExpression();
+		if (left != kNoMatch)
+		{
+			if (!_lexer.matchChar(COLON_T, token))
+				return error(start, ": expected");
+
+			auto right = parseExpression();
+			if (right != kNoMatch)
+				return addNode(RID_CONDITIONAL_EXPRESSION, question, condition, left, right);
+		}
+
+		rewind(optional);
+	}
+
+	return condition;
+}
+
+int Parser::parseBinaryExpression(int level)
+{
+	const BinaryRule& rule = kBinaryRules[level];
+	auto isLast = level + 1 == _countof(kBinaryRules);
+
+	auto left = isLast ? parseUnaryExpression() : parseBinaryExpression(level + 1);
+	if (left == kNoMatch)
+		return kNoMatch;
+
+	for (;;)
+	{
+		auto iteration = mark();
+		Token token;
+
+		if (!matchOperator(rule.operators, token))
+			break;
+
+		auto right = isLast ? parseUnaryExpression() : parseBinaryExpression(level + 1);
+		if (right == kNoMatch)
+		{
+			rewind(iteration);
+			break;
+		}
+
+		// the operator becomes the root of the operands parsed so far
+		left = addNode(rule.rid, token, left, right);
+	}
+
+	return left;
+}
+
+int Parser::parseUnaryExpression()
+{
+	auto expression = parsePostfixExpression();
+	if (expression != kNoMatch)
+		return expression;
+
+	// each operator is an alternative of its own
+	for (auto op = kUnaryOperators; *op; ++op)
+	{
+		auto start = mark();
+		Token token;
+
+		if (_lexer.matchString(*op, token))
+		{
+			auto operand = parseUnaryExpression();
+			if (operand != kNoMatch)
+				return addNode(RID_UNARY_EXPRESSION, token, operand);
+
+			rewind(start);
+		}
+	}
+
+	return kNoMatch;
+}
+
+int Parser::parsePostfixExpression()
+{
+	// the grammar also lists qualified_identifier and SYSTEM_IDENTIFIER,
+	// which match only where primary_expression does
+	auto expression = parsePrimaryExpression();
+	if (expression == kNoMatch)
+		return kNoMatch;
+
+	Token token;
+	while (matchOperator(kPostfixOperators, token))
+		expression = addNode(RID_POSTFIX_EXPRESSION, token, expression);
+
+	return expression;
+}
+
+int Parser::parsePrimaryExpression()
+{
+	auto first = _lexer.cursor();
+
+	auto literal = parseLiteral();
+	if (literal != kNoMatch)
+		return literal;
+
+	auto expression = parseParenthesizedExpression();
+	if (expression == kNoMatch)
+		expression = parseArrayCreationExpression();
+	if (expression == kNoMatch)
+		expression = parseObjectCreationExpression();
+	if (expression == kNoMatch)
+		expression = parseInvocation();
+	if (expression == kNoMatch)
+		expression = parseQualifiedIdentifier();
+	if (expression == kNoMatch)
+		expression = parseSystemIdentifier();
+	if (expression == kNoMatch)
+		return kNoMatch;
+
+	auto helper = parsePrimaryExpressionHelper();
+	if (helper == kNoTree)
+		return expression;
+
+	return addNode(RID_PRIMARY_EXPRESSION, first, _lexer.cursor(), expression, helper);
+}
+
+int Parser::parsePrimaryExpressionHelper()
+{
+	auto first = _lexer.cursor();
+
+	auto access = parseMemberAccess();
+	if (access == kNoMatch)
+		access = parseElementAccess();
+	if (access == kNoMatch)
+		return kNoTree;
+
+	auto rest = parsePrimaryExpressionHelper();
+	if (rest == kNoTree)
+		return access;
+
+	return addNode(RID_PRIMARY_EXPRESSION_HELPER, first, _lexer.cursor(), access, rest);
+}
+
+int Parser::parseParenthesizedExpression()
+{
+	auto start = mark();
+	Token paren, token;
+
+	if (!_lexer.matchChar(LPAREN_T, paren))
+		return kNoMatch;
+
+	auto expression = parseExpression();
+	if (expression == kNoMatch)
+		return error(start, "expression expected");
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return error(start, ") expected");
+
+	return addNode(RID_PARENTHESIZED_EXPRESSION, paren, expression);
+}
+
+int Parser::parseArrayCreationExpression()
+{
+	auto start = mark();
+	Token type, token;
+
+	if (!_lexer.matchTypeSpecifier(type))
+		return kNoMatch;
+
+	auto array = parseArraySpecifier();
+	if (array == kNoMatch)
+		return fail(start);
+
+	if (!_lexer.matchChar(LPAREN_T, token))
+		return error(start, "( expected");
+
+	auto arguments = parseArgumentList();
+	if (arguments == kNoMatch)
+		arguments = kNoTree;
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return error(start, ") expected");
+
+	return addNode(RID_ARRAY_CREATION_EXPRESSION, start.cursor, type.last, array, arguments);
+}
+
+int Parser::parseObjectCreationExpression()
+{
+	auto start = mark();
+	Token type, token;
+
+	if (!_lexer.matchTypeSpecifier(type))
+		return kNoMatch;
+
+	if (!_lexer.matchChar(LPAREN_T, token))
+		return error(start, "( expected");
+
+	auto arguments = parseArgumentList();
+	if (arguments == kNoMatch)
+		arguments = kNoTree;
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return error(start, ") expected");
+
+	return addNode(RID_OBJECT_CREATION_EXPRESSION, start.cursor, type.last, arguments);
+}
+
+int Parser::parseInvocation()
+{
+	auto start = mark();
+	Token paren, token;
+
+	auto name = parseQualifiedIdentifier();
+	if (name == kNoMatch)
+		return kNoMatch;
+
+	if (!_lexer.matchChar(LPAREN_T, paren))
+		return fail(start);
+
+	auto arguments = parseArgumentList();
+	if (arguments == kNoMatch)
+		arguments = kNoTree;
+
+	if (!_lexer.matchChar(RPAREN_T, token))
+		return fail(start);
+
+	return addNode(RID_INVOCATION, paren, name, arguments);
+}
+
+int Parser::parseArgumentList()
+{
+	auto first = _lexer.cursor();
+
+	auto argument = parseExpression();
+	if (argument == kNoMatch)
+		return kNoMatch;
+
+	TreeList arguments;
+	addTree(arguments, argument);
+
+	for (;;)
+	{
+		auto next = mark();
+		Token token;
+
+		if (!_lexer.matchChar(COMMA_T, token))
+			break;
+
+		argument = parseExpression();
+		if (argument == kNoMatch)
+		{
+			rewind(next);
+			break;
+		}
+
+		addTree(arguments, argument);
+	}
+
+	return addGroup(RID_ARGUMENT_LIST, first, arguments);
+}
+
+int Parser::parseMemberAccess()
+{
+	auto start = mark();
+	Token dot;
+
+	if (!_lexer.matchChar(DOT_T, dot))
+		return kNoMatch;
+
+	auto name = parseQualifiedIdentifier();
+	if (name == kNoMatch)
+		return fail(start);
+
+	return addNode(RID_MEMBER_ACCESS, dot, name);
+}
+
+int Parser::parseElementAccess()
+{
+	auto start = mark();
+	Token bracket, token;
+
+	if (!_lexer.matchChar(LBRACKET_T, bracket))
+		return kNoMatch;
+
+	auto index = parseExpression();
+	if (index == kNoMatch)
+		return fail(start);
+
+	if (!_lexer.matchChar(RBRACKET_T, token))
+		return error(start, "] expected");
+
+	return addNode(RID_ELEMENT_ACCESS, bracket, index);
+}
+
+// The tokens below are wrapped in token_node_d, their text starts before the whitespace.
+
+int Parser::parseQualifiedIdentifier()
+{
+	auto first = _lexer.cursor();
+	Token token;
+
+	if (!_lexer.matchIdentifier(token))
+		return kNoMatch;
+
+	return addNode(RID_QUALIFIED_IDENTIFIER, first, token.last);
+}
+
+int Parser::parseSystemIdentifier()
+{
+	auto first = _lexer.cursor();
+	Token token;
+
+	if (!_lexer.matchSystemIdentifier(token))
+		return kNoMatch;
+
+	return addNode(RID_SYSTEM_IDENTIFIER, first, token.last);
+}
+
+int Parser::parseLiteral()
+{
+	auto first = _lexer.cursor();
+	Token token;
+
+	auto rid = _lexer.matchLiteral(token);
+	if (rid == RID_UNKNOWN)
+		return kNoMatch;
+
+	return addNode(rid, first, token.last);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tree building
+
+int Parser::addNode(RuleID rid, int first, int last, int child0, int child1, int child2)
+{
+	ParseNode node = { rid, first, last, kNoTree, kNoTree, kNoTree };
+	_nodes.push_back(node);
+
+	auto index = static_cast<int>(_nodes.size()) - 1;
+	addChild(index, child0);
+	addChild(index, child1);
+	addChild(index, child2);
+	return index;
+}
+
+void Parser::addChild(int parent, int child)
+{
+	if (child < 0)
+		return;
+
+	ParseNode& node = _nodes[parent];
+	if (node.lastChild < 0)
+		node.firstChild = child;
+	else
+		_nodes[node.lastChild].nextSibling = child;
+
+	node.lastChild = child;
+	_nodes[child].nextSibling = kNoTree;
+}
+
+void Parser::addTree(TreeList& list, int tree)
+{
+	if (list.count++ == 0)
+		list.first = tree;
+	else
+		_nodes[list.last].nextSibling = tree;
+
+	list.last = tree;
+}
+
+int Parser::addGroup(RuleID rid, int first, const TreeList& list)
+{
+	// a rule with a single tree passes it on
+	if (list.count < 2)
+		return list.first;
+
+	auto group = addNode(rid, first, _lexer.cursor());
+	_nodes[group].firstChild = list.first;
+	_nodes[group].lastChild = list.last;
+	return group;
+}
+
+bool Parser::matchOperator(const char* const* operators, Token& token)
+{
+	for (; *operators; ++operators)
+	{
+		if (_lexer.matchString(*operators, token))
+			return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Backtracking and errors
+
+Parser::Mark Parser::mark() const
+{
+	Mark mark = { _lexer.cursor(), static_cast<int>(_nodes.size()) };
+	return mark;
+}
+
+void Parser::rewind(const Mark& mark)
+{
+	_lexer.setCursor(mark.cursor);
+	_nodes.resize(mark.nodeCount);
+}
+
+int Parser::fail(const Mark& mark)
+{
+	rewind(mark);
+	return kNoMatch;
+}
+
+int Parser::error(const Mark& mark, const char* message)
+{
+	rewind(mark);
+
+	int line, column;
+	_lexer.position(mark.cursor, line, column);
+	SyntaxErrorHandler::error(CellError(message), _filename, line);
+
+	return kNoMatch;
+}
+
+}} // chaos::cell
@@ -0,0 +1,173 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_parser_H
+#define __CELL_parser_H
+
+#include "cell_lexer.h"
+#include "ast_node_base.h" // NodeSource
+#include "boost/noncopyable.hpp"
+
+#include <string>
+#include <vector>
+
+namespace chaos { namespace cell {
+
+//! A node of the tree built by the Parser.
+//! Links are indices into the nodes of the parser, -1 if there is none.
+struct ParseNode
+{
+	RuleID rid;
+	int    first;       //! The matched text, -1 for the empty nodes Spirit makes for ';' and empty sources.
+	int    last;
+	int    firstChild;
+	int    lastChild;
+	int    nextSibling;
+};
+
+//! Hand-written recursive-descent parser for the CeLL language.
+//! Accepts exactly the language of CellGrammar and builds the same tree that
+//! ast_parse() does with it: the same rules, node texts and positions, and the
+//! same syntax errors reported through SyntaxErrorHandler. Backtracking follows
+//! the ordered alternatives of the grammar, a failed alternative just drops the
+//! nodes it added to the end of the node list.
+class Parser : boost::noncopyable
+{
+public:
+	Parser();
+
+	//! Parses the source [first, last) read from \a filename.
+	//! Returns \a true if the whole source is a translation unit.
+	//! The nodes built from the parse point into the source.
+	bool parse(const char* first, const char* last, const std::string& filename);
+
+	//! Gets the root of the tree, -1 if the last parse failed.
+	int root() const { return _root; }
+
+	//! Gets the node at \a index.
+	const ParseNode& node(int index) const { return _nodes[index]; }
+
+	//! Describes the node at \a index for the node constructors.
+	NodeSource nodeSource(int index) const;
+
+	//! Gets the name of the parsed file.
+	const std::string& filename() const { return _filename; }
+
+private:
+	//! A point to backtrack to.
+	struct Mark
+	{
+		int cursor;
+		int nodeCount;
+	};
+
+	//! Results of the rules besides the index of the built tree.
+	enum
+	{
+		kNoTree  = -1, //! Matched without building a tree.
+		kNoMatch = -2
+	};
+
+	//! Trees collected by a repeated rule.
+	struct TreeList
+	{
+		TreeList() : first(kNoTree), last(kNoTree), count(0)
+		{}
+
+		int first;
+		int last;
+		int count;
+	};
+
+	// The grammar rules. Each returns the index of its tree, kNoTree or kNoMatch.
+
+	int parseTranslationUnit();
+	int parseFunctionDefinition();
+	int parseFunctionDeclarator();
+	int parseParameterList();
+	int parseParameter();
+	int parseBlock();
+	int parseStatementList();
+	int parseStatement();
+	int parseEmbeddedStatement();
+	int parseEmptyStatement();
+	int parseDeclarationStatement();
+	int parseVariableDeclaration();
+	int parseVariableDeclarator();
+	int parseArraySpecifier();
+	int parseExpressionStatement();
+	int parseStatementExpression();
+	int parseIfStatement();
+	int parseElseStatement();
+	int parseWhileStatement();
+	int parseQuitStatement();
+	int parseReturnStatement();
+
+	int parseExpression();
+	int parseAssignment();
+	int parseConditionalExpression();
+	int parseBinaryExpression(int level);
+	int parseUnaryExpression();
+	int parsePostfixExpression();
+	int parsePrimaryExpression();
+	int parsePrimaryExpressionHelper();
+	int parseParenthesizedExpression();
+	int parseArrayCreationExpression();
+	int parseObjectCreationExpression();
+	int parseInvocation();
+	int parseArgumentList();
+	int parseMemberAccess();
+	int parseElementAccess();
+	int parseQualifiedIdentifier();
+	int parseSystemIdentifier();
+	int parseLiteral();
+
+	// Tree building
+
+	//! Adds a node with up to three children. Children which are kNoTree are skipped.
+	int addNode(RuleID rid, int first, int last, int child0 = kNoTree, int child1 = kNoTree, int child2 = kNoTree);
+
+	//! Adds a node for the text of \a token.
+	int addNode(RuleID rid, const Token& token, int child0 = kNoTree, int child1 = kNoTree, int child2 = kNoTree)
+	{ return addNode(rid, token.first, token.last, child0, child1, child2); }
+
+	//! Appends \a child to the children of \a parent.
+	void addChild(int parent, int child);
+
+	//! Appends \a tree to \a list.
+	void addTree(TreeList& list, int tree);
+
+	//! Returns the only tree of \a list or groups the trees under a new node
+	//! spanning from \a first to the cursor.
+	int addGroup(RuleID rid, int first, const TreeList& list);
+
+	//! Matches the first of \a operators, a null-terminated array.
+	bool matchOperator(const char* const* operators, Token& token);
+
+	// Backtracking and errors
+
+	Mark mark() const;
+	void rewind(const Mark& mark);
+
+	//! Rewinds and returns kNoMatch.
+	int fail(const Mark& mark);
+
+	//! Reports a failed assertion like the guards of CellGrammar do: at the
+	//! start of the guarded rule, which then fails. Returns kNoMatch.
+	int error(const Mark& mark, const char* message);
+
+private:
+	Lexer _lexer;
+	std::vector<ParseNode> _nodes;
+	std::string _filename;
+	int _root;
+};
+
+}} // chaos::cell
+
+#endif // __CELL_parser_H
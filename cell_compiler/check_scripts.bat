@@ -0,0 +1,5 @@
+@echo off
+rem check_scripts <cell_compiler executable>
+rem Fails if the optimized code of a script in cell_game\scripts still loads or stores a vec local.
+rem settings.txt holds the settings of the game, it is not a script.
+for %%s in ("%~dp0..\cell_game\scripts\*.txt") do if /i not "%%~ns"=="settings" "%~1" --check-vec-locals "%~dp0base.bc" "%%~s" || exit /b 1
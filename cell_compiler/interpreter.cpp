@@ -0,0 +1,444 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "interpreter.h"
+#include "common.h"
+
+#include <climits> // INT_MIN
+#include <cmath>
+
+//! GCC and Clang support 'goto *label', which gives each instruction its own
+//! indirect jump. Other compilers fall back to a switch.
+#if defined(__GNUC__)
+	#define CELL_COMPUTED_GOTO 1
+#endif
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! Make sure CellData has the layout of 'Cell_t'.
+typedef char CellDataSizeCheck[(sizeof(CellData) == 32) ? 1 : -1];
+
+////////////////////////////////////////////////////////////////////////////////
+// Builtins
+//
+// These are the C++ versions of the builtins in base.c. The arena-wide ones
+// accumulate into four lanes exactly like their SIMD counterparts, so both
+// backends round the same way.
+
+//! Number of lanes used by the arena-wide builtins in base.c.
+const int kLanes = 4;
+
+//! Neutral element for the min-reductions; same as LARGE_DISTANCE in base.c.
+const float kLargeDistance = 1e19f;
+
+//! Signature of the builtin implementations.
+typedef Register (*BuiltinFunction)(const CellData* cells, int cellCount, const Register* args);
+
+inline Register makeReal(float f)
+{
+	Register r;
+	r.f = f;
+	return r;
+}
+
+inline Register makeInt(int i)
+{
+	Register r;
+	r.i = i;
+	return r;
+}
+
+inline Register makeVec(float x, float y)
+{
+	Register r;
+	r.v[0] = x;
+	r.v[1] = y;
+	return r;
+}
+
+inline float length(const float* v)
+{
+	return sqrtf(v[0]*v[0] + v[1]*v[1]);
+}
+
+inline Register normalize(const float* v)
+{
+	float l = length(v);
+
+	if (l < 1e-6f)
+		return makeVec(v[0], v[1]);
+
+	return makeVec(v[0] / l, v[1] / l);
+}
+
+//! See findCell() in base.c.
+static int findCell(const CellData* cells, int cellCount, const float* point, float minRadius, float maxRadius, float sign)
+{
+	float best = kLargeDistance;
+	int result = -1;
+
+	// cells are visited in index order, so keeping the first of equal distances matches the lane reduction
+	for (int i = 1; i < cellCount; ++i)
+	{
+		float radius = cells[i].radius;
+		float dx = cells[i].position[0] - point[0];
+		float dy = cells[i].position[1] - point[1];
+		float distance = sign * (sqrtf(dx*dx + dy*dy) - radius);
+
+		if (radius >= minRadius && radius < maxRadius && distance < best)
+		{
+			best = distance;
+			result = i;
+		}
+	}
+
+	return result;
+}
+
+//! See centroid() in base.c.
+static Register centroid(const CellData* cells, int cellCount, bool wantPrey)
+{
+	float sumWeight[kLanes] = { 0.0f }, sumX[kLanes] = { 0.0f }, sumY[kLanes] = { 0.0f };
+	float playerRadius = cells[0].radius;
+
+	for (int i = 1; i < cellCount; ++i)
+	{
+		float radius = cells[i].radius;
+		if ((radius < playerRadius) != wantPrey)
+			continue;
+
+		int lane = (i - 1) % kLanes;
+		float area = radius * radius;
+		sumWeight[lane] += area;
+		sumX[lane] += area * cells[i].position[0];
+		sumY[lane] += area * cells[i].position[1];
+	}
+
+	float weight = (sumWeight[0] + sumWeight[1]) + (sumWeight[2] + sumWeight[3]);
+	if (weight <= 0.0f)
+		return makeVec(cells[0].position[0], cells[0].position[1]);
+
+	return makeVec(((sumX[0] + sumX[1]) + (sumX[2] + sumX[3])) / weight, ((sumY[0] + sumY[1]) + (sumY[2] + sumY[3])) / weight);
+}
+
+static Register builtinSqrt(const CellData*, int, const Register* args)
+{
+	return makeReal(sqrtf(args[0].f));
+}
+
+static Register builtinLength(const CellData*, int, const Register* args)
+{
+	return makeReal(length(args[0].v));
+}
+
+static Register builtinNormalize(const CellData*, int, const Register* args)
+{
+	return normalize(args[0].v);
+}
+
+static Register builtinDot(const CellData*, int, const Register* args)
+{
+	return makeReal(args[0].v[0]*args[1].v[0] + args[0].v[1]*args[1].v[1]);
+}
+
+static Register builtinMakeVec(const CellData*, int, const Register* args)
+{
+	return makeVec(args[0].f, args[1].f);
+}
+
+static Register builtinNearestCell(const CellData* cells, int cellCount, const Register* args)
+{
+	return makeInt(findCell(cells, cellCount, args[0].v, args[1].f, args[2].f, 1.0f));
+}
+
+static Register builtinFarthestCell(const CellData* cells, int cellCount, const Register* args)
+{
+	return makeInt(findCell(cells, cellCount, args[0].v, args[1].f, args[2].f, -1.0f));
+}
+
+static Register builtinCountCellsWithin(const CellData* cells, int cellCount, const Register* args)
+{
+	const float* point = args[0].v;
+	float distance = args[1].f;
+	int total = 0;
+
+	for (int i = 1; i < cellCount; ++i)
+	{
+		float dx = cells[i].position[0] - point[0];
+		float dy = cells[i].position[1] - point[1];
+		float reach = distance + cells[i].radius;
+
+		if (reach >= 0.0f && dx*dx + dy*dy <= reach*reach)
+			++total;
+	}
+
+	return makeInt(total);
+}
+
+static Register builtinPreyCentroid(const CellData* cells, int cellCount, const Register*)
+{
+	return centroid(cells, cellCount, true);
+}
+
+static Register builtinThreatCentroid(const CellData* cells, int cellCount, const Register*)
+{
+	return centroid(cells, cellCount, false);
+}
+
+static Register builtinRepulsion(const CellData* cells, int cellCount, const Register* args)
+{
+	const float* point = args[0].v;
+	float minRadius = args[1].f;
+	float sumX[kLanes] = { 0.0f }, sumY[kLanes] = { 0.0f };
+
+	for (int i = 1; i < cellCount; ++i)
+	{
+		float radius = cells[i].radius;
+		float dx = point[0] - cells[i].position[0];
+		float dy = point[1] - cells[i].position[1];
+		float distanceSquared = dx*dx + dy*dy;
+
+		if (radius >= minRadius && distanceSquared > 1e-12f)
+		{
+			// (r^2 / d^2) * (direction / d)
+			int lane = (i - 1) % kLanes;
+			float strength = (radius * radius) / (distanceSquared * sqrtf(distanceSquared));
+			sumX[lane] += strength * dx;
+			sumY[lane] += strength * dy;
+		}
+	}
+
+	return makeVec((sumX[0] + sumX[1]) + (sumX[2] + sumX[3]), (sumY[0] + sumY[1]) + (sumY[2] + sumY[3]));
+}
+
+//! The builtin implementations, indexed by BuiltinID.
+static const BuiltinFunction kBuiltinFunctions[BUILTIN_COUNT] =
+{
+	builtinSqrt,
+	builtinLength,
+	builtinNormalize,
+	builtinDot,
+	builtinMakeVec,
+	builtinNearestCell,
+	builtinFarthestCell,
+	builtinCountCellsWithin,
+	builtinPreyCentroid,
+	builtinThreatCentroid,
+	builtinRepulsion
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Interpreter
+
+Interpreter::Interpreter()
+{}
+
+Interpreter::~Interpreter()
+{}
+
+void Interpreter::load(const Program& program)
+{
+	_code = program.code;
+	_arrays = program.arrays;
+
+	Register zero;
+	zero.v[0] = zero.v[1] = 0.0f;
+	_registers.assign(program.registerCount, zero);
+
+	if (!program.constants.empty())
+		copy(program.constants.begin(), program.constants.end(), _registers.begin() + program.localCount);
+}
+
+//! Integer division by zero traps in the JIT-compiled code; the interpreter yields zero instead.
+inline int divideInt(int a, int b)
+{
+	return (b == 0 || (b == -1 && a == INT_MIN)) ? 0 : a / b;
+}
+
+//! See divideInt().
+inline int remainderInt(int a, int b)
+{
+	return (b == 0 || b == -1) ? 0 : a % b;
+}
+
+//! 'a != b' for reals, false if either is NaN like LLVM's 'fcmp one'.
+inline bool orderedNotEqual(float a, float b)
+{
+	return a < b || a > b;
+}
+
+void Interpreter::run(const CellData* cells, int cellCount, float arenaRadius, float* force)
+{
+	if (_code.empty())
+		return;
+
+	const Instruction* const code = &_code[0];
+	const Instruction* pc = code;
+	Register* const r = &_registers[0];
+	const ArrayInfo* const arrays = _arrays.empty() ? nullptr : &_arrays[0];
+
+	r[REG_CELL_COUNT].i = cellCount;
+	r[REG_ARENA_RADIUS].f = arenaRadius;
+	r[REG_FORCE].v[0] = force[0];
+	r[REG_FORCE].v[1] = force[1];
+
+// Operand access
+#define RA (r[pc->a])
+#define RB (r[pc->b])
+#define RC (r[pc->c])
+
+// Dispatch
+#ifdef CELL_COMPUTED_GOTO
+	static const void* const kLabels[] =
+	{
+	#define CELL_OPCODE_LABEL(name, a, b, c) &&L_##name,
+		CELL_OPCODES( CELL_OPCODE_LABEL )
+	#undef CELL_OPCODE_LABEL
+	};
+
+	#define VM_BEGIN() goto *kLabels[pc->op];
+	#define VM_END()
+	#define VM_CASE(name) L_##name:
+	#define VM_NEXT() { ++pc; goto *kLabels[pc->op]; }
+	#define VM_JUMP(target) { pc = code + (target); goto *kLabels[pc->op]; }
+#else
+	#define VM_BEGIN() for (;;) { switch (pc->op) {
+	#define VM_END() default: assert_msg(false, "Invalid opcode: %d\n", pc->op); return; } }
+	#define VM_CASE(name) case OP_##name:
+	#define VM_NEXT() { ++pc; continue; }
+	#define VM_JUMP(target) { pc = code + (target); continue; }
+#endif
+
+// Ends the run, also used when an array index is out of range
+#define VM_RETURN() { force[0] = r[REG_FORCE].v[0]; force[1] = r[REG_FORCE].v[1]; return; }
+
+// Instruction templates
+#define VM_BINARY(name, field, expr) VM_CASE(name) { RA.field = (expr); VM_NEXT(); }
+#define VM_VECTOR(name, op) VM_CASE(name) { float x = RB.v[0] op RC.v[0], y = RB.v[1] op RC.v[1]; RA.v[0] = x; RA.v[1] = y; VM_NEXT(); }
+#define VM_VECTOR_COMPARE(name, op) VM_CASE(name) { RA.i = (RB.v[0] op RC.v[0]) && (RB.v[1] op RC.v[1]); VM_NEXT(); }
+#define VM_CHECK_CELL(index) if (static_cast<unsigned>(index) >= static_cast<unsigned>(cellCount)) VM_RETURN()
+#define VM_READ_VECTOR(name, member) VM_CASE(name) { VM_CHECK_CELL(RB.i); const float* v = cells[RB.i].member; RA.v[0] = v[0]; RA.v[1] = v[1]; VM_NEXT(); }
+
+	VM_BEGIN()
+
+	VM_CASE(NOP) VM_NEXT();
+	VM_CASE(MOV) { RA = RB; VM_NEXT(); }
+
+	// int, wrapping like LLVM's 'add', 'sub' and 'mul'
+	VM_BINARY(IADD, i, static_cast<int>(static_cast<unsigned>(RB.i) + static_cast<unsigned>(RC.i)))
+	VM_BINARY(ISUB, i, static_cast<int>(static_cast<unsigned>(RB.i) - static_cast<unsigned>(RC.i)))
+	VM_BINARY(IMUL, i, static_cast<int>(static_cast<unsigned>(RB.i) * static_cast<unsigned>(RC.i)))
+	VM_BINARY(IDIV, i, divideInt(RB.i, RC.i))
+	VM_BINARY(IMOD, i, remainderInt(RB.i, RC.i))
+	VM_BINARY(IAND, i, RB.i & RC.i)
+	VM_BINARY(IOR,  i, RB.i | RC.i)
+	VM_BINARY(IXOR, i, RB.i ^ RC.i)
+	VM_BINARY(ISHL, i, static_cast<int>(static_cast<unsigned>(RB.i) << (RC.i & 31)))
+	VM_BINARY(ISHR, i, RB.i >> (RC.i & 31))
+	VM_BINARY(INEG, i, static_cast<int>(0u - static_cast<unsigned>(RB.i)))
+	VM_BINARY(INOT, i, ~RB.i)
+	VM_BINARY(LNOT, i, RB.i == 0)
+	VM_BINARY(LAND, i, (RB.i != 0) & (RC.i != 0))
+	VM_BINARY(LOR,  i, (RB.i != 0) | (RC.i != 0))
+	VM_BINARY(IEQ,  i, RB.i == RC.i)
+	VM_BINARY(INE,  i, RB.i != RC.i)
+	VM_BINARY(ILT,  i, RB.i <  RC.i)
+	VM_BINARY(ILE,  i, RB.i <= RC.i)
+	VM_BINARY(IGT,  i, RB.i >  RC.i)
+	VM_BINARY(IGE,  i, RB.i >= RC.i)
+
+	// real
+	VM_BINARY(FADD, f, RB.f + RC.f)
+	VM_BINARY(FSUB, f, RB.f - RC.f)
+	VM_BINARY(FMUL, f, RB.f * RC.f)
+	VM_BINARY(FDIV, f, RB.f / RC.f)
+	VM_BINARY(FMOD, f, fmodf(RB.f, RC.f))
+	VM_BINARY(FNEG, f, -RB.f)
+	VM_BINARY(FEQ,  i, RB.f == RC.f)
+	VM_BINARY(FNE,  i, orderedNotEqual(RB.f, RC.f))
+	VM_BINARY(FLT,  i, RB.f <  RC.f)
+	VM_BINARY(FLE,  i, RB.f <= RC.f)
+	VM_BINARY(FGT,  i, RB.f >  RC.f)
+	VM_BINARY(FGE,  i, RB.f >= RC.f)
+
+	// vec
+	VM_VECTOR(VADD, +)
+	VM_VECTOR(VSUB, -)
+	VM_VECTOR(VMUL, *)
+	VM_VECTOR(VDIV, /)
+	VM_CASE(VMOD) { float x = fmodf(RB.v[0], RC.v[0]), y = fmodf(RB.v[1], RC.v[1]); RA.v[0] = x; RA.v[1] = y; VM_NEXT(); }
+	VM_CASE(VNEG) { RA.v[0] = -RB.v[0]; RA.v[1] = -RB.v[1]; VM_NEXT(); }
+	VM_VECTOR_COMPARE(VEQ, ==)
+	VM_CASE(VNE) { RA.i = orderedNotEqual(RB.v[0], RC.v[0]) && orderedNotEqual(RB.v[1], RC.v[1]); VM_NEXT(); }
+	VM_VECTOR_COMPARE(VLT, <)
+	VM_VECTOR_COMPARE(VLE, <=)
+	VM_VECTOR_COMPARE(VGT, >)
+	VM_VECTOR_COMPARE(VGE, >=)
+	VM_CASE(SPLAT) { float f = RB.f; RA.v[0] = f; RA.v[1] = f; VM_NEXT(); }
+	VM_BINARY(VDOT, f, RB.v[0]*RC.v[0] + RB.v[1]*RC.v[1])
+	VM_BINARY(VLEN, f, length(RB.v))
+	VM_CASE(VNORM) { RA = normalize(RB.v); VM_NEXT(); }
+	VM_BINARY(VGET, f, RB.v[pc->c])
+	VM_BINARY(VGETR, f, RB.v[RC.i & 1])
+	VM_CASE(VSET) { RA.v[pc->c] = RB.f; VM_NEXT(); }
+
+	// arrays; the unsigned comparison rejects negative indices too
+	VM_CASE(AGET)
+	{
+		const ArrayInfo& array = arrays[pc->b];
+		auto index = static_cast<unsigned>(RC.i);
+		if (index >= array.length)
+			VM_RETURN()
+		RA = r[array.first + index];
+		VM_NEXT();
+	}
+	VM_CASE(ASET)
+	{
+		const ArrayInfo& array = arrays[pc->a];
+		auto index = static_cast<unsigned>(RB.i);
+		if (index >= array.length)
+			VM_RETURN()
+		r[array.first + index] = RC;
+		VM_NEXT();
+	}
+
+	// system variables; a loaded program may hold any index, so it ends the run like an array index
+	VM_CASE(RADIUS) { VM_CHECK_CELL(RB.i); RA.f = cells[RB.i].radius; VM_NEXT(); }
+	VM_READ_VECTOR(POSITION, position)
+	VM_READ_VECTOR(VELOCITY, velocity)
+
+	VM_CASE(CALL) { RA = kBuiltinFunctions[pc->b](cells, cellCount, &RC); VM_NEXT(); }
+
+	// control flow
+	VM_CASE(JMP) VM_JUMP(pc->b)
+	VM_CASE(JZ) { if (RA.i == 0) VM_JUMP(pc->b) VM_NEXT(); }
+	VM_CASE(JNZ) { if (RA.i != 0) VM_JUMP(pc->b) VM_NEXT(); }
+
+	VM_CASE(RET) VM_RETURN()
+
+	VM_END()
+
+#undef VM_READ_VECTOR
+#undef VM_CHECK_CELL
+#undef VM_VECTOR_COMPARE
+#undef VM_VECTOR
+#undef VM_BINARY
+#undef VM_RETURN
+#undef VM_JUMP
+#undef VM_NEXT
+#undef VM_CASE
+#undef VM_END
+#undef VM_BEGIN
+#undef RC
+#undef RB
+#undef RA
+}
+
+}} // chaos::cell
@@ -0,0 +1,59 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_interpreter_H
+#define __CELL_interpreter_H
+
+#include "bytecode.h"
+
+namespace chaos { namespace cell {
+
+//! Mirrors 'Cell_t' from base.c. The vectors are 8-byte aligned there.
+struct CellData
+{
+	float radius;
+	float unused;
+	float position[2];
+	float velocity[2];
+	union
+	{
+		void*  padding;
+		double alignment;
+	};
+};
+
+//! Executes programs generated by BytecodeGenerator without LLVM.
+//! The register file is allocated once per loaded program and reused by every run.
+//! It is the state block of the script: the registers of 'global' variables keep
+//! their values from one run to the next.
+class Interpreter
+{
+public:
+	Interpreter();
+	~Interpreter();
+
+	//! Copies \a program and prepares its registers. An empty program unloads the interpreter.
+	void load(const Program& program);
+
+	//! Returns \a true if there is a program to run.
+	bool loaded() const { return !_code.empty(); }
+
+	//! Runs the loaded program. Has the same contract as the JIT-compiled
+	//! 'cell_main_template(cells, cellCount, arenaRadius, force, globals)' with
+	//! the globals kept by the interpreter.
+	void run(const CellData* cells, int cellCount, float arenaRadius, float* force);
+
+private:
+	std::vector<Instruction> _code;
+	std::vector<Register> _registers;
+	std::vector<ArrayInfo> _arrays;
+};
+
+}} // chaos::cell
+
+#endif // __CELL_interpreter_H
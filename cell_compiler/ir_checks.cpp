@@ -0,0 +1,42 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "ir_checks.h"
+
+namespace chaos { namespace cell {
+
+//! Returns true if \a pointer is, or casts, the alloca of a vec local.
+static bool isVecLocal(const llvm::Value* pointer)
+{
+	auto local = llvm::dyn_cast<llvm::AllocaInst>(pointer->stripPointerCasts());
+	return local && local->getAllocatedType()->isVectorTy();
+}
+
+size_t countVecLocalAccesses(const llvm::Module& module)
+{
+	size_t count = 0;
+	for (auto function = module.begin(); function != module.end(); ++function)
+	{
+		for (auto block = function->begin(); block != function->end(); ++block)
+		{
+			for (auto inst = block->begin(); inst != block->end(); ++inst)
+			{
+				if (auto load = llvm::dyn_cast<llvm::LoadInst>(&*inst))
+					count += isVecLocal(load->getPointerOperand());
+				else if (auto store = llvm::dyn_cast<llvm::StoreInst>(&*inst))
+					count += isVecLocal(store->getPointerOperand());
+			}
+		}
+	}
+	return count;
+}
+
+}} // chaos::cell
@@ -0,0 +1,28 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_ir_checks_H
+#define __CELL_ir_checks_H
+
+#include <cstddef>
+
+namespace llvm {
+	class Module;
+}
+
+namespace chaos { namespace cell {
+
+//! Counts the loads and stores of the vec locals in the functions of \a module.
+//! A vec local lives in an alloca of a vector type until SROA promotes it, so the
+//! optimized code of a script keeps none of them and the count is zero.
+//! The vec arrays are not counted, an element picked at run time has to be in memory.
+size_t countVecLocalAccesses(const llvm::Module& module);
+
+}} // chaos::cell
+
+#endif // __CELL_ir_checks_H
@@ -13,6 +13,9 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Operator.h" // FastMathFlags
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Support/system_error.h" // error_code, not the same as std::error_code
@@ -30,9 +33,17 @@ const string kFunctionPrefix = "cell_";
 //! Casts the generic ASTContext to the specific ContextType.
 #define MC (*contextFrom(ctx))
 
+//! Alignment of array variables on the stack, enough for aligned SSE loads.
+const unsigned kArrayAlignment = 16;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 llvm::Module* loadModule(const char* modulePath)
+{
+	return loadModule(modulePath, llvm::getGlobalContext());
+}
+
+llvm::Module* loadModule(const char* modulePath, llvm::LLVMContext& context)
 {
 	if (modulePath == nullptr || *modulePath == '\0')
 		return nullptr;
@@ -44,7 +55,7 @@ llvm::Module* loadModule(const char* modulePath)
 		return nullptr;
 
 	string error;
-	auto module = llvm::ParseBitcodeFile(buffer.get(), llvm::getGlobalContext(), &error);
+	auto module = llvm::ParseBitcodeFile(buffer.get(), context, &error);
 
 	if (!module)
 	{
@@ -56,31 +67,34 @@ llvm::Module* loadModule(const char* modulePath)
 }
 
 //! Obtain an integer constant
-inline llvm::ConstantInt* makeConstant(int value)
+inline llvm::ConstantInt* makeConstant(llvm::LLVMContext& context, int value)
 {
-	return llvm::ConstantInt::get(llvm::getGlobalContext(), llvm::APInt(/*bits*/32, value, /*isSigned*/true));
+	return llvm::ConstantInt::get(context, llvm::APInt(/*bits*/32, value, /*isSigned*/true));
 }
 
 //! Obtain a real constant.
-inline llvm::ConstantFP* makeConstant(float value)
+inline llvm::ConstantFP* makeConstant(llvm::LLVMContext& context, float value)
 {
-	return llvm::ConstantFP::get(llvm::getGlobalContext(), llvm::APFloat(value));
+	return llvm::ConstantFP::get(context, llvm::APFloat(value));
 }
 
 //! Makes a LLVM type from the given type specifier.
-inline llvm::Type* makeType(TypeSpecifier type, int nElements = 0)
+inline llvm::Type* makeType(llvm::LLVMContext& context, TypeSpecifier type, int nElements = 0)
 {
+	if (nElements > 0) // the elements of an array are laid out contiguously
+		return llvm::ArrayType::get( makeType(context, type), nElements );
+
 	switch (type)
 	{
 	case TS_INT:
-		return llvm::Type::getInt32Ty( llvm::getGlobalContext() );
+		return llvm::Type::getInt32Ty( context );
 
 	case TS_REAL:
-		return llvm::Type::getFloatTy( llvm::getGlobalContext() );
+		return llvm::Type::getFloatTy( context );
 
 	case TS_VECTOR:
 		{
-			auto realType = llvm::Type::getFloatTy( llvm::getGlobalContext() );
+			auto realType = llvm::Type::getFloatTy( context );
 			return llvm::VectorType::get( realType, 2 ); // create a <2 x float>
 		}
 	}
@@ -89,19 +103,35 @@ inline llvm::Type* makeType(TypeSpecifier type, int nElements = 0)
 	return nullptr;
 }
 
-//! The one and only IRBuilder
-MyBuilder theBuilder(llvm::getGlobalContext());
+//! Returns \a true if \a value is the address of an array variable.
+inline bool isArrayAddress(llvm::Value* value)
+{
+	auto pointerType = value ? llvm::dyn_cast<llvm::PointerType>(value->getType()) : nullptr;
+	return pointerType && pointerType->getElementType()->isArrayTy();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // IRGenerator
 
-IRGenerator::IRGenerator(llvm::Module& module, const std::string& functionName)
-	: _builder(theBuilder)
+IRGenerator::IRGenerator(llvm::Module& module, const std::string& functionName, const CodeGenOptions& options)
+	: _options(options)
+	, _context(module.getContext())
+	, _builder(module.getContext())
 	, _module(module)
 	, _main(nullptr) // find the 'cell_main' function
+	, _function(nullptr)
 	, _pCells(nullptr)
 	, _cellCount(nullptr)
 	, _arenaSize(nullptr)
+	, _force(nullptr)
+	, _mainForce(nullptr)
+	, _forceAddress(nullptr)
+	, _globals(nullptr)
+	, _globalsSize(0)
+	, _mainAborted(nullptr)
+	, _aborted(nullptr)
+	, _outOfRange(nullptr)
+	, _fuseMultiplyAdd(false)
 {
 	if (functionName.empty())
 		CellError::raise("main name not specified");
@@ -131,9 +161,6 @@ IRGenerator::IRGenerator(llvm::Module& module, const std::string& functionName)
 	llvm::SmallVector<llvm::ReturnInst*, 10> returns;
 	llvm::CloneFunctionInto(_main, mainTemplate, map, false, returns);
 
-	// obtain the global LLVM context
-	auto& llvmCtx = llvm::getGlobalContext();
-
 	// get the body of the function
 	auto& mainBlock = _main->getEntryBlock();
 
@@ -143,14 +170,19 @@ IRGenerator::IRGenerator(llvm::Module& module, const std::string& functionName)
 	// attach the builder to the function's body
 	_builder.SetInsertPoint(&mainBlock);
 
-	// get the first parameter
-	auto parameter = _main->arg_begin();
-	
 	// save the function's parameters for later use
-	_pCells = parameter;
-	_cellCount = ++parameter;
-	_arenaSize = ++parameter;
-	_force = ++parameter;
+	setFunction(_main);
+
+	// '#Force' is written to a local vec, so the writes stay in registers instead of going
+	// through the pointer each time; the partial writes start from the value of the caller
+	_mainForce = _builder.CreateAlloca(llvm::cast<llvm::PointerType>(_force->getType())->getElementType(), nullptr, "force_local");
+	_builder.CreateStore(_builder.CreateLoad(_force, "force_in"), _mainForce);
+	_forceAddress = _mainForce;
+
+	// raised when an index is out of range in a function of the script, see outOfRangeBlock()
+	_mainAborted = _builder.CreateAlloca(_builder.getInt1Ty(), nullptr, "aborted");
+	_builder.CreateStore(_builder.getFalse(), _mainAborted);
+	_aborted = _mainAborted;
 }
 
 IRGenerator::~IRGenerator()
@@ -159,10 +191,39 @@ IRGenerator::~IRGenerator()
 		delete p.second;
 }
 
+void IRGenerator::setFunction(llvm::Function* function, bool isFast)
+{
+	_function = function;
+
+	// the flags go on every real operation the builder creates from now on
+	llvm::FastMathFlags flags;
+	if (isFast || _options.fastMath)
+		flags.setUnsafeAlgebra();
+	_builder.SetFastMathFlags(flags);
+	_fuseMultiplyAdd = isFast || _options.fastMath || _options.fuseMultiplyAdd;
+
+	// the functions of the script take the parameters of the main function first
+	auto parameter = function->arg_begin();
+	_pCells = parameter;
+	_cellCount = ++parameter;
+	_arenaSize = ++parameter;
+	_force = ++parameter;
+	_globals = ++parameter;
+	_forceAddress = function == _main ? _mainForce : _force;
+	if (function == _main)
+		_aborted = _mainAborted;
+	else // the functions of the script take the flag after them
+		_aborted = ++parameter;
+}
+
 llvm::Value* IRGenerator::evalExpression(ASTNode& node)
 {
 	ContextType newContext;
 	node.accept(*this, &newContext);
+	if (isArrayAddress(newContext.value))
+		CellError::raise(node.parsePosition(), "array element expected");
+	if (newContext.value && newContext.value->getType()->isVoidTy())
+		CellError::raise(node.parsePosition(), "function has no result");
 	return newContext.value;
 }
 
@@ -171,6 +232,8 @@ llvm::Value* IRGenerator::evalAddress(ASTNode& node, llvm::Value** writeIndex)
 	ContextType newContext;
 	newContext.wantsAddress = 1;
 	node.accept(*this, &newContext);
+	if (isArrayAddress(newContext.value))
+		CellError::raise(node.parsePosition(), "cannot assign arrays");
 	if (writeIndex)
 		*writeIndex = newContext.writeIndex;
 	return newContext.value;
@@ -188,10 +251,10 @@ bool IRGenerator::visitIdentifier(IdentifierNode& node, ContextType& ctx)
 		if (it == _symbols.end())
 			CellError::raise(node.parsePosition(), "identifier not found: %s", node.id().c_str());
 
-		if (ctx.wantsAddress)
-			ctx.value = it->second->allocA;
+		if (ctx.wantsAddress || isArrayAddress(it->second->allocA))
+			ctx.value = it->second->allocA; // arrays are indexed in place
 		else // just load it
-			ctx.value = _builder.CreateLoad(it->second->allocA, node.id());
+			ctx.value = _builder.CreateLoad(it->second->allocA, node.id().c_str());
 	}
 	return true;
 }
@@ -213,7 +276,7 @@ bool IRGenerator::visitLogicalExpression(BinaryExpressionBase& node, ContextType
 	if (!(leftTy->isIntegerTy() && rightTy->isIntegerTy()))
 		CellError::raise(node.parsePosition(), "int expected");
 
-	auto zero = makeConstant(0);
+	auto zero = makeConstant(_context, 0);
 
 	switch (node.getOperator())
 	{
@@ -262,7 +325,7 @@ bool IRGenerator::visitBitwiseExpression(BinaryExpressionBase& node, ContextType
 	else if (!leftTy->isIntegerTy() || !rightTy->isIntegerTy())
 		CellError::raise(node.parsePosition(), "int expected");
 
-	auto zero = makeConstant(0);
+	auto zero = makeConstant(_context, 0);
 
 	switch (op)
 	{
@@ -319,7 +382,7 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 	if (leftTy != rightTy)
 		CellError::raise(node.parsePosition(), "cannot compare operands of different types");
 
-	auto intTy = makeType(TS_INT);
+	auto intTy = makeType(_context, TS_INT);
 
 	switch (node.getOperator())
 	{
@@ -341,8 +404,8 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 			left = _builder.CreateFCmpOEQ(left, right, "v_eq");
 			// left is now <2 x i1> but we need i32
 			// extract the two vector elements
-			auto e0 = _builder.CreateExtractElement(left, makeConstant(0), "e0");
-			auto e1 = _builder.CreateExtractElement(left, makeConstant(1), "e1");
+			auto e0 = _builder.CreateExtractElement(left, makeConstant(_context, 0), "e0");
+			auto e1 = _builder.CreateExtractElement(left, makeConstant(_context, 1), "e1");
 			// make e0 & e1 and extend it to i32
 			e0 = _builder.CreateAnd(e0, e1);
 			ctx.value = _builder.CreateZExt(e0, intTy, "v_eq_to_bool");
@@ -367,8 +430,8 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 			left = _builder.CreateFCmpONE(left, right, "v_neq");
 			// left is now <2 x i1> but we need i32
 			// extract the two vector elements
-			auto e0 = _builder.CreateExtractElement(left, makeConstant(0), "e0");
-			auto e1 = _builder.CreateExtractElement(left, makeConstant(1), "e1");
+			auto e0 = _builder.CreateExtractElement(left, makeConstant(_context, 0), "e0");
+			auto e1 = _builder.CreateExtractElement(left, makeConstant(_context, 1), "e1");
 			// make e0 & e1 and extend it to i32
 			e0 = _builder.CreateAnd(e0, e1);
 			ctx.value = _builder.CreateZExt(e0, intTy, "v_neq_to_bool");
@@ -393,8 +456,8 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 			left = _builder.CreateFCmpOGT(left, right, "v_gt");
 			// left is now <2 x i1> but we need i32
 			// extract the two vector elements
-			auto e0 = _builder.CreateExtractElement(left, makeConstant(0), "e0");
-			auto e1 = _builder.CreateExtractElement(left, makeConstant(1), "e1");
+			auto e0 = _builder.CreateExtractElement(left, makeConstant(_context, 0), "e0");
+			auto e1 = _builder.CreateExtractElement(left, makeConstant(_context, 1), "e1");
 			// make e0 & e1 and extend it to i32
 			e0 = _builder.CreateAnd(e0, e1);
 			ctx.value = _builder.CreateZExt(e0, intTy, "v_gt_to_bool");
@@ -416,11 +479,11 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 		}
 		else // assume vector
 		{
-			left = _builder.CreateFCmpOEQ(left, right, "v_gteq");
+			left = _builder.CreateFCmpOGE(left, right, "v_gteq");
 			// left is now <2 x i1> but we need i32
 			// extract the two vector elements
-			auto e0 = _builder.CreateExtractElement(left, makeConstant(0), "e0");
-			auto e1 = _builder.CreateExtractElement(left, makeConstant(1), "e1");
+			auto e0 = _builder.CreateExtractElement(left, makeConstant(_context, 0), "e0");
+			auto e1 = _builder.CreateExtractElement(left, makeConstant(_context, 1), "e1");
 			// make e0 & e1 and extend it to i32
 			e0 = _builder.CreateAnd(e0, e1);
 			ctx.value = _builder.CreateZExt(e0, intTy, "v_gteq_to_bool");
@@ -445,8 +508,8 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 			left = _builder.CreateFCmpOLT(left, right, "v_lt");
 			// left is now <2 x i1> but we need i32
 			// extract the two vector elements
-			auto e0 = _builder.CreateExtractElement(left, makeConstant(0), "e0");
-			auto e1 = _builder.CreateExtractElement(left, makeConstant(1), "e1");
+			auto e0 = _builder.CreateExtractElement(left, makeConstant(_context, 0), "e0");
+			auto e1 = _builder.CreateExtractElement(left, makeConstant(_context, 1), "e1");
 			// make e0 & e1 and extend it to i32
 			e0 = _builder.CreateAnd(e0, e1);
 			ctx.value = _builder.CreateZExt(e0, intTy, "v_lt_to_bool");
@@ -471,8 +534,8 @@ bool IRGenerator::visitRelationalExpression(BinaryExpressionBase& node, ContextT
 			left = _builder.CreateFCmpOLE(left, right, "v_lteq");
 			// left is now <2 x i1> but we need i32
 			// extract the two vector elements
-			auto e0 = _builder.CreateExtractElement(left, makeConstant(0), "e0");
-			auto e1 = _builder.CreateExtractElement(left, makeConstant(1), "e1");
+			auto e0 = _builder.CreateExtractElement(left, makeConstant(_context, 0), "e0");
+			auto e1 = _builder.CreateExtractElement(left, makeConstant(_context, 1), "e1");
 			// make e0 & e1 and extend it to i32
 			e0 = _builder.CreateAnd(e0, e1);
 			ctx.value = _builder.CreateZExt(e0, intTy, "v_lteq_to_bool");
@@ -538,6 +601,10 @@ bool IRGenerator::visitBinaryExpression(BinaryExpressionBase& node, ContextType&
 	case OP_PLUS: // +
 		if (leftTy->isIntegerTy()) // int
 			ctx.value = _builder.CreateAdd(left, right, "i_add");
+		else if (isFusable(left)) // a * b + c
+			ctx.value = createMultiplyAdd(left, right, false);
+		else if (isFusable(right)) // c + a * b
+			ctx.value = createMultiplyAdd(right, left, false);
 		else // real or vec
 			ctx.value = _builder.CreateFAdd(left, right, "f_add");
 		break;
@@ -545,6 +612,10 @@ bool IRGenerator::visitBinaryExpression(BinaryExpressionBase& node, ContextType&
 	case OP_MINUS: // -
 		if (leftTy->isIntegerTy()) // int
 			ctx.value = _builder.CreateSub(left, right, "i_sub");
+		else if (isFusable(left)) // a * b - c
+			ctx.value = createMultiplyAdd(left, _builder.CreateFNeg(right, "f_neg"), false);
+		else if (isFusable(right)) // c - a * b
+			ctx.value = createMultiplyAdd(right, left, true);
 		else // real or vec
 			ctx.value = _builder.CreateFSub(left, right, "f_sub");
 		break;
@@ -556,6 +627,27 @@ bool IRGenerator::visitBinaryExpression(BinaryExpressionBase& node, ContextType&
 	return false;
 }
 
+bool IRGenerator::isFusable(llvm::Value* product) const
+{
+	// only a product computed for this very sum, nothing else reads it
+	auto multiply = llvm::dyn_cast<llvm::BinaryOperator>(product);
+	return _fuseMultiplyAdd && multiply && multiply->getOpcode() == llvm::Instruction::FMul && multiply->use_empty();
+}
+
+llvm::Value* IRGenerator::createMultiplyAdd(llvm::Value* product, llvm::Value* addend, bool negateProduct)
+{
+	auto multiply = llvm::cast<llvm::BinaryOperator>(product);
+	llvm::Value* left = multiply->getOperand(0);
+	if (negateProduct)
+		left = _builder.CreateFNeg(left, "f_neg");
+
+	// llvm.fmuladd is fused where the target has FMA, and split again where it has not
+	auto muladd = llvm::Intrinsic::getDeclaration(&_module, llvm::Intrinsic::fmuladd, product->getType());
+	auto result = _builder.CreateCall3(muladd, left, multiply->getOperand(1), addend, "f_muladd");
+	multiply->eraseFromParent();
+	return result;
+}
+
 bool IRGenerator::visitUnaryExpression(UnaryExpressionBase& node, ContextType& ctx)
 {
 	auto value = evalExpression(*node.operand());
@@ -564,7 +656,7 @@ bool IRGenerator::visitUnaryExpression(UnaryExpressionBase& node, ContextType& c
 		CellError::raise(node.operand()->parsePosition(), "null operand");
 
 	auto type = value->getType();
-	auto zero = makeConstant(0);
+	auto zero = makeConstant(_context, 0);
 
 	switch (node.getOperator())
 	{
@@ -613,6 +705,91 @@ bool IRGenerator::visit(TypeModifierNode& node, ASTContext* ctx)
 	return true;
 }
 
+bool IRGenerator::preVisit(FunctionDefinitionNode& node, ASTContext* ctx)
+{
+	auto& name = node.name();
+	if (_functions.find(name) != _functions.end())
+		CellError::raise(node.declarator()->parsePosition(), "function redefinition: %s", name.c_str());
+
+	vector<ParameterNode*> parameters;
+	node.getParameters(parameters);
+
+	// the parameters of the main function are passed on, so the function sees the arena as well
+	vector<llvm::Type*> types;
+	for (auto arg = _main->arg_begin(); arg != _main->arg_end(); ++arg)
+		types.push_back(arg->getType());
+	types.push_back(_mainAborted->getType());
+	for (auto parameter : parameters)
+		types.push_back(makeType(_context, parameter->type()));
+
+	auto resultType = node.type() == TS_VOID ? llvm::Type::getVoidTy(_context) : makeType(_context, node.type());
+	auto function = llvm::Function::Create(llvm::FunctionType::get(resultType, types, false),
+		llvm::GlobalValue::InternalLinkage, _main->getName() + "." + name.c_str(), &_module);
+
+	// 'inline' forces the function into its callers, otherwise the inliner decides
+	function->addFnAttr(node.isInline() ? llvm::Attribute::AlwaysInline : llvm::Attribute::InlineHint);
+
+	// the main function is suspended while the function is populated
+	auto mainBlock = _builder.GetInsertBlock();
+	auto mainOutOfRange = _outOfRange;
+	IRSymbolMap mainSymbols;
+	mainSymbols.swap(_symbols);
+
+	setFunction(function, node.isFast());
+	_outOfRange = nullptr;
+	_builder.SetInsertPoint(llvm::BasicBlock::Create(_context, "entry", function));
+
+	// the parameters are stored like variables, mem2reg promotes them
+	auto arg = function->arg_begin();
+	for (auto mainArg = _main->arg_begin(); mainArg != _main->arg_end(); ++mainArg, ++arg)
+		arg->setName(mainArg->getName());
+	arg->setName("aborted");
+	++arg;
+
+	for (auto parameter : parameters)
+	{
+		if (_symbols.find(parameter->name()) != _symbols.end())
+			CellError::raise(parameter->parsePosition(), "variable redefenition", parameter->name());
+
+		arg->setName(parameter->name().c_str());
+		auto allocA = _builder.CreateAlloca(arg->getType(), nullptr, parameter->name().c_str());
+		_builder.CreateStore(arg, allocA);
+		_symbols.insert( make_pair(parameter->name(), new IRSymbol(allocA)) );
+		++arg;
+	}
+
+	traverseStatement(*node.body(), nullptr);
+
+	// falling off the end returns zero
+	auto basicBlock = _builder.GetInsertBlock();
+	if (basicBlock && basicBlock->getTerminator() == nullptr)
+	{
+		if (resultType->isVoidTy())
+			_builder.CreateRetVoid();
+		else
+			_builder.CreateRet(llvm::Constant::getNullValue(resultType));
+	}
+
+	llvm::verifyFunction(*function, llvm::PrintMessageAction);
+
+	// resume the main function
+	for (auto p : _symbols)
+		delete p.second;
+	_symbols.swap(mainSymbols);
+
+	setFunction(_main);
+	_outOfRange = mainOutOfRange;
+	if (mainBlock)
+		_builder.SetInsertPoint(mainBlock);
+	else
+		_builder.ClearInsertionPoint();
+
+	// only now the function can be called, so there is no recursion
+	_functions.insert( make_pair(name, function) );
+
+	return false;
+}
+
 bool IRGenerator::preVisit(VariableDeclarationNode& node, ASTContext* ctx)
 {
 	MC.reset();
@@ -621,21 +798,90 @@ bool IRGenerator::preVisit(VariableDeclarationNode& node, ASTContext* ctx)
 
 bool IRGenerator::visit(VariableDeclarationNode& node, ASTContext* ctx)
 {
-	auto& block = _main->getEntryBlock();
-	MyBuilder allocaBuilder(&block, block.begin());
-	auto type = makeType(node.type());
-	auto allocA = allocaBuilder.CreateAlloca(type, MC.value, MC.name);
+	auto type = makeType(_context, node.type(), MC.nElements);
+	llvm::Value* allocA = nullptr;
+
+	if (MC.isGlobal)
+	{
+		if (_function != _main)
+			CellError::raise(node.parsePosition(), "global variables belong to the main block");
+		allocA = allocateGlobal(type, MC.name);
+	}
+	else
+	{
+		auto& block = _function->getEntryBlock();
+		MyBuilder allocaBuilder(&block, block.begin());
+		auto alloca = allocaBuilder.CreateAlloca(type, nullptr, MC.name);
+		if (MC.nElements > 0)
+			alloca->setAlignment(kArrayAlignment);
+		allocA = alloca;
+	}
 
 	auto& it = _symbols.find(MC.name);
 	if (it != _symbols.end())
 		it->second->allocA = allocA; // attach the value to the symbol
 
-	if (MC.isGlobal)
+	return true;
+}
+
+llvm::Value* IRGenerator::allocateGlobal(llvm::Type* type, const std::string& name)
+{
+	// the caller keeps the block between invocations, so unlike the allocas
+	// these values survive until the next tick; each is aligned to its size
+	auto arrayType = llvm::dyn_cast<llvm::ArrayType>(type);
+	auto elementType = arrayType ? arrayType->getElementType() : type;
+	auto size = elementType->getPrimitiveSizeInBits() / 8;
+	_globalsSize = (_globalsSize + size - 1) / size * size;
+
+	auto& block = _main->getEntryBlock();
+	MyBuilder entryBuilder(&block, block.begin());
+	auto address = entryBuilder.CreateConstGEP1_32(_globals, static_cast<unsigned>(_globalsSize), name + "_offset");
+	_globalsSize += size * (arrayType ? arrayType->getNumElements() : 1);
+
+	return entryBuilder.CreateBitCast(address, type->getPointerTo(), name);
+}
+
+void IRGenerator::checkBounds(llvm::Value* index, unsigned length)
+{
+	// one unsigned comparison rejects negative indices too
+	auto inRange = _builder.CreateICmpULT(index, makeConstant(_context, static_cast<int>(length)), "a_in_range");
+
+	// the check is expected to pass, the optimizer folds it when the index is known to be in range
+	auto inRangeBlock = llvm::BasicBlock::Create(_context, "A_IN_RANGE", _function);
+	auto weights = llvm::MDBuilder(_context).createBranchWeights(1000, 1);
+	_builder.CreateCondBr(inRange, inRangeBlock, outOfRangeBlock(), weights);
+	_builder.SetInsertPoint(inRangeBlock);
+}
+
+llvm::BasicBlock* IRGenerator::outOfRangeBlock()
+{
+	// an index out of range ends the whole run like 'quit', as in the interpreter. A function of the
+	// script raises the '_aborted' flag and returns a zero result, its callers see the flag and return too.
+	if (!_outOfRange)
 	{
-		// TODO: Take care of global variables
+		auto resultType = _function->getReturnType();
+		_outOfRange = llvm::BasicBlock::Create(_context, "A_OUT_OF_RANGE", _function);
+		if (_function != _main)
+			new llvm::StoreInst(llvm::ConstantInt::getTrue(_context), _aborted, _outOfRange);
+		llvm::ReturnInst::Create(_context, resultType->isVoidTy() ? nullptr : llvm::Constant::getNullValue(resultType), _outOfRange);
 	}
 
-	return true;
+	return _outOfRange;
+}
+
+void IRGenerator::storeForce()
+{
+	// every way out of the main function passes the local '#Force' to the caller,
+	// the ones through an index out of range included
+	for (auto& block : _main->getBasicBlockList())
+	{
+		auto terminator = block.getTerminator();
+		if (terminator && llvm::isa<llvm::ReturnInst>(terminator))
+		{
+			MyBuilder exitBuilder(terminator);
+			exitBuilder.CreateStore(exitBuilder.CreateLoad(_mainForce, "force_out"), _force);
+		}
+	}
 }
 
 bool IRGenerator::preVisit(VariableDeclaratorNode& node, ASTContext* ctx)
@@ -649,18 +895,28 @@ bool IRGenerator::preVisit(VariableDeclaratorNode& node, ASTContext* ctx)
 	return true;
 }
 
+bool IRGenerator::preVisit(ArraySpecifierNode& node, ASTContext* ctx)
+{
+	auto size = static_cast<IntegerLiteralNode*>(node.firstChild())->value();
+	if (size <= 0 || size > kMaxArrayLength)
+		CellError::raise(node.parsePosition(), "invalid array size");
+
+	MC.nElements = size;
+	return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Literals
 
 bool IRGenerator::visit(IntegerLiteralNode& node, ASTContext* ctx)
 {
-	MC.value = makeConstant(node.value());
+	MC.value = makeConstant(_context, node.value());
 	return true;
 }
 
 bool IRGenerator::visit(RealLiteralNode& node, ASTContext* ctx)
 {
-	MC.value = makeConstant(node.value());
+	MC.value = makeConstant(_context, node.value());
 	return true;
 }
 
@@ -705,7 +961,7 @@ bool IRGenerator::visit(SystemIdentifierNode& node, ASTContext* ctx)
 	{
 		if (!MC.wantsAddress)
 			CellError::raise("write-only variable");
-		MC.value = _force;
+		MC.value = _forceAddress;
 	}
 	else
 	{
@@ -733,9 +989,34 @@ bool IRGenerator::traverseStatement(ASTNode& node, llvm::BasicBlock** blockToUpd
 	return continueTraversal;
 }
 
+void IRGenerator::checkStatement(ASTNode& node)
+{
+	// a statement which never runs is rejected like the others, but its blocks
+	// are deleted; the variables it declares live in the entry block
+	auto insertBlock = _builder.GetInsertBlock();
+	auto insertPoint = _builder.GetInsertPoint();
+	auto outOfRange = _outOfRange;
+
+	llvm::Function::iterator first = &_function->back();
+	++first;
+
+	_builder.SetInsertPoint(llvm::BasicBlock::Create(_context, "DEAD", _function));
+	traverseStatement(node, nullptr);
+
+	for (auto it = first; it != _function->end(); ++it)
+		it->dropAllReferences();
+	_function->getBasicBlockList().erase(first, _function->end());
+	_outOfRange = outOfRange;
+
+	if (insertBlock)
+		_builder.SetInsertPoint(insertBlock, insertPoint);
+	else
+		_builder.ClearInsertionPoint();
+}
+
 bool IRGenerator::visit(BlockNode& node, ASTContext* ctx)
 {
-	if (_main && ASTNode::instanceof(node.parent(), RID_START_SYMBOL))
+	if (_main && node.endsMain())
 	{ // we are exiting form the 'main' block
 		auto basicBlock = _builder.GetInsertBlock();
 		
@@ -743,6 +1024,8 @@ bool IRGenerator::visit(BlockNode& node, ASTContext* ctx)
 		if (basicBlock && basicBlock->getTerminator() == nullptr)
 			_builder.CreateRetVoid();
 
+		storeForce();
+
 		// make sure the populated function is well-formed
 		llvm::verifyFunction(*_main, llvm::PrintMessageAction);
 
@@ -762,22 +1045,27 @@ bool IRGenerator::preVisit(IfStatementNode& node, ASTContext* ctx)
 		CellError::raise(node.parsePosition(), "invalid 'if' condition type");
 
 	if (conditionType->getBitWidth() != 1) // LLVM expects i1, so make a conversion if needed
-		condition = _builder.CreateICmpNE(condition, makeConstant(0), "if_condition");
+		condition = _builder.CreateICmpNE(condition, makeConstant(_context, 0), "if_condition");
 
 	bool hasElse = (node.elseBody() != nullptr);
 
-	auto& llvmCtx = llvm::getGlobalContext();
-	auto& blocks  = _main->getBasicBlockList(); // the list of all function blocks
+	// with a literal condition one body never runs, its code is dropped
+	auto literal = node.literalCondition();
+
+	auto& blocks  = _function->getBasicBlockList(); // the list of all function blocks
 
-	auto mergeBlock = llvm::BasicBlock::Create(llvmCtx, "IF_MERGE");
-	auto thenBlock  = llvm::BasicBlock::Create(llvmCtx, "IF_THEN", _main);
-	auto elseBlock  = hasElse ? llvm::BasicBlock::Create(llvmCtx, "IF_ELSE") : mergeBlock;
+	auto mergeBlock = llvm::BasicBlock::Create(_context, "IF_MERGE");
+	auto thenBlock  = llvm::BasicBlock::Create(_context, "IF_THEN", _function);
+	auto elseBlock  = hasElse ? llvm::BasicBlock::Create(_context, "IF_ELSE") : mergeBlock;
 
 	_builder.CreateCondBr(condition, thenBlock, elseBlock);
 
 	// the then block
 	_builder.SetInsertPoint(thenBlock);
-	traverseStatement( *node.thenBody(), &thenBlock );
+	if (literal && literal->value() == 0)
+		checkStatement( *node.thenBody() );
+	else
+		traverseStatement( *node.thenBody(), &thenBlock );
 	if (thenBlock->getTerminator() == nullptr)
 		_builder.CreateBr(mergeBlock);
 
@@ -786,7 +1074,10 @@ bool IRGenerator::preVisit(IfStatementNode& node, ASTContext* ctx)
 	{
 		blocks.push_back(elseBlock);
 		_builder.SetInsertPoint(elseBlock);
-		traverseStatement( *node.elseBody(), &elseBlock );
+		if (literal && literal->value() != 0)
+			checkStatement( *node.elseBody() );
+		else
+			traverseStatement( *node.elseBody(), &elseBlock );
 		if (elseBlock->getTerminator() == nullptr)
 			_builder.CreateBr(mergeBlock);
 	}
@@ -800,11 +1091,10 @@ bool IRGenerator::preVisit(IfStatementNode& node, ASTContext* ctx)
 
 bool IRGenerator::preVisit(WhileStatementNode& node, ASTContext* ctx)
 {
-	auto& llvmCtx = llvm::getGlobalContext();
 	
-	auto conditionBlock = llvm::BasicBlock::Create(llvmCtx, "WHILE_CONDITION", _main);
-	auto loopBlock = llvm::BasicBlock::Create(llvmCtx, "WHILE_BODY");
-	auto endBlock = llvm::BasicBlock::Create(llvmCtx, "WHILE_END");
+	auto conditionBlock = llvm::BasicBlock::Create(_context, "WHILE_CONDITION", _function);
+	auto loopBlock = llvm::BasicBlock::Create(_context, "WHILE_BODY");
+	auto endBlock = llvm::BasicBlock::Create(_context, "WHILE_END");
 
 	_builder.CreateBr(conditionBlock); // jump right to the condition
 
@@ -818,16 +1108,20 @@ bool IRGenerator::preVisit(WhileStatementNode& node, ASTContext* ctx)
 		CellError::raise(node.parsePosition(), "invalid 'while' condition type");
 
 	if (conditionType->getBitWidth() != 1) // LLVM expects i1, so make a conversion if needed
-		condition = _builder.CreateICmpNE(condition, makeConstant(0), "while_condition");
+		condition = _builder.CreateICmpNE(condition, makeConstant(_context, 0), "while_condition");
 	
 	// select between the body and the end
 	_builder.CreateCondBr(condition, loopBlock, endBlock);
 
 	// the loop body
-	auto& blocks = _main->getBasicBlockList(); // the list of all function blocks
+	auto& blocks = _function->getBasicBlockList(); // the list of all function blocks
 	blocks.push_back(loopBlock); // add the while body to the function's block list
 	_builder.SetInsertPoint(loopBlock);
-	traverseStatement( *node.body(), &loopBlock );
+	auto literal = node.literalCondition();
+	if (literal && literal->value() == 0)
+		checkStatement( *node.body() ); // the loop never runs
+	else
+		traverseStatement( *node.body(), &loopBlock );
 	
 	// jump back to the condition block
 	if (loopBlock->getTerminator() == nullptr)
@@ -842,6 +1136,9 @@ bool IRGenerator::preVisit(WhileStatementNode& node, ASTContext* ctx)
 
 bool IRGenerator::visit(QuitStatementNode& node, ASTContext* ctx)
 {
+	if (_function != _main)
+		CellError::raise(node.parsePosition(), "quit inside a function");
+
 	auto basicBlock = _builder.GetInsertBlock();
 	if (basicBlock->getTerminator() == nullptr)
 		_builder.CreateRetVoid(); // return from the main function
@@ -849,6 +1146,32 @@ bool IRGenerator::visit(QuitStatementNode& node, ASTContext* ctx)
 	return true;
 }
 
+bool IRGenerator::preVisit(ReturnStatementNode& node, ASTContext* ctx)
+{
+	if (_function == _main)
+		CellError::raise(node.parsePosition(), "return outside a function");
+
+	auto resultType = _function->getReturnType();
+
+	if (node.value())
+	{
+		auto value = evalExpression(*node.value());
+		if (value->getType() != resultType)
+			CellError::raise(node.parsePosition(), "invalid return type");
+		_builder.CreateRet(value);
+	}
+	else
+	{
+		if (!resultType->isVoidTy())
+			CellError::raise(node.parsePosition(), "return value expected");
+		_builder.CreateRetVoid();
+	}
+
+	// the statements after 'return' are unreachable, the optimizer drops them
+	_builder.SetInsertPoint(llvm::BasicBlock::Create(_context, "AFTER_RETURN", _function));
+	return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Expressions
 
@@ -947,6 +1270,8 @@ bool IRGenerator::preVisit(MemberAccessNode& node, ASTContext* ctx)
 {
 //	if (!(MC.value->getType()->isVectorTy()))
 //		CellError::raise(node.parsePosition(), "only vectors have memebers");
+	if (isArrayAddress(MC.value))
+		CellError::raise(node.parsePosition(), "only vectors have members");
 
 	auto first = node.firstChild();
 	auto member = ASTNode::instanceof(first, RID_QUALIFIED_IDENTIFIER) ? static_cast<QualifiedIdentifierNode*>(first) : nullptr;
@@ -955,9 +1280,9 @@ bool IRGenerator::preVisit(MemberAccessNode& node, ASTContext* ctx)
 	if (MC.wantsAddress)
 	{
 		if (id == "x")
-			MC.writeIndex = makeConstant(0);
+			MC.writeIndex = makeConstant(_context, 0);
 		else if (id == "y")
-			MC.writeIndex = makeConstant(1);
+			MC.writeIndex = makeConstant(_context, 1);
 		else
 			CellError::raise(node.parsePosition(), "unknown member");
 	}
@@ -965,11 +1290,11 @@ bool IRGenerator::preVisit(MemberAccessNode& node, ASTContext* ctx)
 	{
 		if (id == "x")
 		{
-			MC.value = _builder.CreateExtractElement(MC.value, makeConstant(0), "extract_x");
+			MC.value = _builder.CreateExtractElement(MC.value, makeConstant(_context, 0), "extract_x");
 		}
 		else if (id == "y")
 		{
-			MC.value = _builder.CreateExtractElement(MC.value, makeConstant(1), "extract_y");
+			MC.value = _builder.CreateExtractElement(MC.value, makeConstant(_context, 1), "extract_y");
 		}
 		else if (id == "length")
 		{
@@ -995,16 +1320,36 @@ bool IRGenerator::preVisit(ElementAccessNode& node, ASTContext* ctx)
 	auto index = evalExpression(*node.firstChild());
 	auto leftTy = MC.value->getType();
 
-	if (leftTy->isVectorTy()) // vector access
+	if (isArrayAddress(MC.value)) // array access
+	{
+		if (!index->getType()->isIntegerTy(32))
+			CellError::raise(node.parsePosition(), "int index expected");
+
+		auto arrayType = llvm::cast<llvm::ArrayType>(llvm::cast<llvm::PointerType>(leftTy)->getElementType());
+		auto length = static_cast<unsigned>(arrayType->getNumElements());
+
+		// a constant index is checked here and needs no code
+		if (auto constantIndex = llvm::dyn_cast<llvm::ConstantInt>(index))
+		{
+			auto i = constantIndex->getSExtValue();
+			if (i < 0 || i >= length)
+				CellError::raise(node.parsePosition(), "index out of range");
+		}
+		else
+		{
+			checkBounds(index, length);
+		}
+
+		llvm::Value* indices[] = { makeConstant(_context, 0), index };
+		auto element = _builder.CreateInBoundsGEP(MC.value, indices, "a_element");
+		MC.value = MC.wantsAddress ? element : _builder.CreateLoad(element, "a_load");
+	}
+	else if (leftTy->isVectorTy()) // vector access
 	{
 		if (llvm::dyn_cast_or_null<llvm::Constant>(index))
 			CellError::raise(node.parsePosition(), "constant index expected");
 		MC.value = _builder.CreateExtractElement(MC.value, index, "v_element");
 	}
-	else if (leftTy->isArrayTy()) // array access
-	{
-		MC.value = _builder.CreateGEP(MC.value, index, "a_element");
-	}
 	else if (llvm::dyn_cast_or_null<llvm::Function>(MC.value)) // some of the 'read_XXX' functions
 	{
 		MC.value = _builder.CreateCall2(MC.value, _pCells, index, "read_call");
@@ -1020,17 +1365,65 @@ bool IRGenerator::preVisit(ElementAccessNode& node, ASTContext* ctx)
 bool IRGenerator::preVisit(InvocationNode& node, ASTContext* ctx)
 {
 	auto calleeName = static_cast<QualifiedIdentifierNode*>(node.invocationName())->id();
-	auto callee = _module.getFunction(kFunctionPrefix + calleeName);
+
+	// the functions of the script hide the builtins
+	auto function = _functions.find(calleeName);
+	auto callee = function != _functions.end() ? function->second : _module.getFunction(kFunctionPrefix + calleeName.str());
 
 	if (!callee)
 		CellError::raise(node.parsePosition(), "function not found %s", calleeName.c_str());
 
 	vector<llvm::Value*> args;
 
-	for (auto arg = node.invocationArguments()->firstChild(); arg != nullptr; arg = arg->nextSibling())
-		args.push_back( evalExpression(*arg) );
+	if (function != _functions.end())
+	{ // the functions of the script take the parameters of the main function first
+		args.push_back(_pCells);
+		args.push_back(_cellCount);
+		args.push_back(_arenaSize);
+		args.push_back(_forceAddress);
+		args.push_back(_globals);
+		args.push_back(_aborted);
+	}
+	else if (callee->arg_size() >= 2 && callee->arg_begin()->getType() == _pCells->getType())
+	{ // arena-wide builtins take the cell array and the cell count as hidden leading parameters
+		args.push_back(_pCells);
+		args.push_back(_cellCount);
+	}
+	auto hiddenCount = static_cast<int>(args.size());
 
-	MC.value = _builder.CreateCall(callee, args, calleeName);
+	// a single argument is not wrapped in an argument list
+	auto arguments = node.invocationArguments();
+	if (ASTNode::instanceof(arguments, RID_ARGUMENT_LIST))
+	{
+		for (auto arg = arguments->firstChild(); arg != nullptr; arg = arg->nextSibling())
+			args.push_back( evalExpression(*arg) );
+	}
+	else if (arguments)
+	{
+		args.push_back( evalExpression(*arguments) );
+	}
+
+	auto functionType = callee->getFunctionType();
+	if (args.size() != functionType->getNumParams())
+		CellError::raise(node.parsePosition(), "%s expects %d arguments", calleeName.c_str(), static_cast<int>(functionType->getNumParams()) - hiddenCount);
+
+	for (size_t i = hiddenCount; i < args.size(); ++i)
+	{
+		if (args[i] == nullptr || args[i]->getType() != functionType->getParamType(static_cast<unsigned>(i)))
+			CellError::raise(node.parsePosition(), "invalid type of argument %d of %s", static_cast<int>(i) - hiddenCount + 1, calleeName.c_str());
+	}
+
+	// a call without a result cannot be named
+	MC.value = _builder.CreateCall(callee, args, functionType->getReturnType()->isVoidTy() ? "" : calleeName.c_str());
+
+	if (function != _functions.end())
+	{ // an index out of range in the callee ends the caller as well
+		auto aborted = _builder.CreateLoad(_aborted, "aborted");
+		auto completedBlock = llvm::BasicBlock::Create(_context, "CALL_COMPLETED", _function);
+		auto weights = llvm::MDBuilder(_context).createBranchWeights(1, 1000);
+		_builder.CreateCondBr(aborted, outOfRangeBlock(), completedBlock, weights);
+		_builder.SetInsertPoint(completedBlock);
+	}
 	return false;
 }
 
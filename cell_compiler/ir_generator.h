@@ -18,9 +18,12 @@
 
 namespace chaos { namespace cell {
 
-//! Loads a module from a .bc file.
+//! Loads a module from a .bc file into the global LLVM context.
 llvm::Module* loadModule(const char* modulePath);
 
+//! Loads a module from a .bc file into the given LLVM context.
+llvm::Module* loadModule(const char* modulePath, llvm::LLVMContext& context);
+
 //! Dumps a module to a file.
 //void dumpModule(const llvm::Module& module, const char* path);
 
@@ -78,6 +81,9 @@ struct IRSymbol
 //! The symbol table is just a simple hash-map.
 typedef boost::unordered_map<std::string, IRSymbol*> IRSymbolMap;
 
+//! The functions defined by the script, by name.
+typedef boost::unordered_map<std::string, llvm::Function*> IRFunctionMap;
+
 //! Specialization for IRBuilder.
 #ifdef _DEBUG
 	typedef llvm::IRBuilder</*preserveNames*/true> MyBuilder;
@@ -89,17 +95,23 @@ typedef boost::unordered_map<std::string, IRSymbol*> IRSymbolMap;
 class IRGenerator : public ASTVisitorMix<IRContext>
 {
 public:
-	IRGenerator(llvm::Module& module, const std::string& functionName);
+	IRGenerator(llvm::Module& module, const std::string& functionName, const CodeGenOptions& options = CodeGenOptions());
 	virtual ~IRGenerator();
 
+	//! Gets the size in bytes of the block holding the global variables.
+	size_t globalsSize() const { return _globalsSize; }
+
 	virtual bool visit(IntegerLiteralNode& node, ASTContext* ctx);
 	virtual bool visit(RealLiteralNode& node, ASTContext* ctx);
 
 	virtual bool visit(TypeModifierNode& node, ASTContext* ctx);
 
+	virtual bool preVisit(FunctionDefinitionNode& node, ASTContext* ctx);
+
 	virtual bool preVisit(VariableDeclarationNode& node, ASTContext* ctx);
 	virtual bool visit(VariableDeclarationNode& node, ASTContext* ctx);
 	virtual bool preVisit(VariableDeclaratorNode& node, ASTContext* ctx);
+	virtual bool preVisit(ArraySpecifierNode& node, ASTContext* ctx);
 
 	virtual bool visit(IdentifierNode& node, ASTContext* ctx);
 	virtual bool visit(QualifiedIdentifierNode& node, ASTContext* ctx);
@@ -115,6 +127,7 @@ public:
 	virtual bool preVisit(IfStatementNode& node, ASTContext* ctx);
 	virtual bool preVisit(WhileStatementNode& node, ASTContext* ctx);
 	virtual bool visit(QuitStatementNode& node, ASTContext* ctx);
+	virtual bool preVisit(ReturnStatementNode& node, ASTContext* ctx);
 
 	virtual bool preVisit(AssignmentNode& node, ASTContext* ctx);
 
@@ -132,7 +145,9 @@ public:
 	virtual bool preVisit(PostfixExpressionNode& node, ASTContext* ctx);
 
 private:
+	void setFunction(llvm::Function* function, bool isFast = false);
 	bool traverseStatement(ASTNode& node, llvm::BasicBlock** blockToUpdate);
+	void checkStatement(ASTNode& node);
 	llvm::Value* evalExpression(ASTNode& node);
 	llvm::Value* evalAddress(ASTNode& node, llvm::Value** writeIndex = nullptr);
 	bool visitIdentifier(IdentifierNode& node, ContextType& ctx);
@@ -141,16 +156,34 @@ private:
 	bool visitRelationalExpression(BinaryExpressionBase& node, ContextType& ctx);
 	bool visitBinaryExpression(BinaryExpressionBase& node, ContextType& ctx);
 	bool visitUnaryExpression(UnaryExpressionBase& node, ContextType& ctx);
+	bool isFusable(llvm::Value* product) const;
+	llvm::Value* createMultiplyAdd(llvm::Value* product, llvm::Value* addend, bool negateProduct);
+	llvm::Value* allocateGlobal(llvm::Type* type, const std::string& name);
+	void checkBounds(llvm::Value* index, unsigned length);
+	llvm::BasicBlock* outOfRangeBlock();
+	void storeForce();
 
 private:
-	IRSymbolMap _symbols; //! the symbol table
-	MyBuilder& _builder;
+	CodeGenOptions _options; //! how the real math is generated
+	IRSymbolMap _symbols; //! the symbol table of the function being populated
+	IRFunctionMap _functions; //! the functions defined so far
+	llvm::LLVMContext& _context; //! the context of the module
+	MyBuilder _builder;
 	llvm::Module& _module; //! the module to be populated
-	llvm::Function* _main; //! points to 'void cell_main(Cell* all, int count, int arenaSize)'
-	llvm::Argument* _pCells; //! points to the 'all' parameter
+	llvm::Function* _main; //! points to 'void cell_main(Cell* all, int count, float arenaSize, vec* force, char* globals)'
+	llvm::Function* _function; //! the function being populated, '_main' or a function of the script
+	llvm::Argument* _pCells; //! points to the 'all' parameter of '_function'
 	llvm::Argument* _cellCount; //! points to the 'count' parameter
 	llvm::Argument* _arenaSize; //! points to the 'arenaSize' parameter
 	llvm::Argument* _force; //! The output from the main function.
+	llvm::Value* _mainForce; //! the local copy of '#Force' in '_main', stored to '_force' when it returns
+	llvm::Value* _forceAddress; //! where '#Force' is written: '_mainForce', or '_force' in a function of the script
+	llvm::Argument* _globals; //! points to the 'globals' parameter
+	size_t _globalsSize; //! bytes of the globals block used so far
+	llvm::Value* _mainAborted; //! the flag the functions of the script raise when an array index is out of range
+	llvm::Value* _aborted; //! '_mainAborted', or the flag parameter in a function of the script
+	llvm::BasicBlock* _outOfRange; //! ends the run from '_function' when an array index is out of range, created on demand
+	bool _fuseMultiplyAdd; //! set if the sums of products in '_function' are contracted
 };
 
 }} // chaos::cell
@@ -0,0 +1,60 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "line_map.h"
+
+#include <algorithm> // upper_bound()
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+//! Columns per tab, the default of Spirit's position_iterator.
+const int kTabSize = 4;
+
+////////////////////////////////////////////////////////////////////////////////
+// LineMap
+
+LineMap::LineMap()
+	: _first(nullptr)
+	, _last(nullptr)
+{}
+
+void LineMap::reset(const char* first, const char* last)
+{
+	_first = first;
+	_last = last;
+	_lineStarts.clear();
+}
+
+void LineMap::position(const char* where, int& line, int& column) const
+{
+	if (_lineStarts.empty())
+	{
+		_lineStarts.push_back(_first);
+		for (auto p = _first; p != _last; ++p)
+		{
+			if (*p == '\n' || (*p == '\r' && (p + 1 == _last || p[1] != '\n')))
+				_lineStarts.push_back(p + 1);
+		}
+	}
+
+	auto it = upper_bound(_lineStarts.begin(), _lineStarts.end(), where) - 1;
+	line = static_cast<int>(it - _lineStarts.begin()) + 1;
+	column = 1;
+
+	for (auto p = *it; p != where; ++p)
+	{
+		if (*p == '\t')
+			column += kTabSize - (column - 1) % kTabSize;
+		else if (*p != '\r') // the '\r' of "\r\n" takes no column
+			++column;
+	}
+}
+
+}} // chaos::cell
@@ -0,0 +1,39 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_line_map_H
+#define __CELL_line_map_H
+
+#include <vector>
+
+namespace chaos { namespace cell {
+
+//! Finds the line and column of a place in a source text.
+//! Counts them like Spirit's position_iterator: a tab stops every four columns
+//! and a line ends with '\n', "\r\n" or a single '\r'. The line starts are
+//! found on the first request, so sources which are never asked pay nothing.
+class LineMap
+{
+public:
+	LineMap();
+
+	//! Starts over on the source [first, last).
+	void reset(const char* first, const char* last);
+
+	//! Computes the line and column of \a where, which points into the source.
+	void position(const char* where, int& line, int& column) const;
+
+private:
+	const char* _first;
+	const char* _last;
+	mutable std::vector<const char*> _lineStarts;
+};
+
+}} // chaos::cell
+
+#endif // __CELL_line_map_H
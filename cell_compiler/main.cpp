@@ -6,24 +6,101 @@
 	http://www.boost.org/LICENSE_1_0.txt.
 */
 
+#include "llvm/IR/Module.h"
+
 #include "cell_compiler.h"
+#include "ir_checks.h"
+#include "native_module.h"
 #include "string_utils.h"
 
 #include <cstdlib>
+#include <fstream>
 
 using namespace std;
 using namespace chaos::cell;
 
+// The base module used when the command line names none, looked up in the working directory.
+static const char* const kDefaultBaseModule = ".\\base.bc";
+
 int main(int argc, char* argv[])
 {
 	try
 	{
-		if (argc > 1)
+		if (argc > 3 && string(argv[1]) == "--check-vec-locals")
+		{
+			// cell_compiler --check-vec-locals <base module> <script>... optimizes each script as an object file would be
+			// and fails if its optimized code still loads or stores a vec local, see check_scripts.bat
+			auto failed = false;
+			for (auto i = 3; i < argc; ++i)
+			{
+				// a fresh base module for each script, the optimizer drops what the script doesn't call
+				auto baseModule = loadModule(argv[2]);
+				if (!baseModule)
+					CellError::raise("cannot load the base module");
+
+				CellCompiler compiler;
+				compiler.run(baseModule, argv[i], kNativeFunctionName);
+				optimizeModule(*baseModule, nullptr);
+
+				const auto count = countVecLocalAccesses(*baseModule);
+				cout << argv[i] << ": " << count << " loads and stores of vec locals" << endl;
+				if (count)
+					failed = true;
+				delete baseModule;
+			}
+
+			if (failed)
+				return EXIT_FAILURE;
+		}
+		else if (argc > 2 && string(argv[1]) == "--check")
+		{
+			// cell_compiler --check <script> [base module] compiles the script into the base module
+			// as cell_game's JIT does, reporting its errors
+			auto baseModule = loadModule(argc > 3 ? argv[3] : kDefaultBaseModule);
+			if (!baseModule)
+				CellError::raise("cannot load the base module");
+
+			CellCompiler compiler;
+			compiler.run(baseModule, argv[2], "custom_cell_ai_0");
+			delete baseModule;
+		}
+		else if (argc > 3)
+		{
+			// cell_compiler <script> <object file> <cpu> [base module] compiles the script ahead of time.
+			// The object is linked into a shared library which cell_game loads without LLVM.
+			auto baseModule = loadModule(argc > 4 ? argv[4] : kDefaultBaseModule);
+			if (!baseModule)
+				CellError::raise("cannot load the base module");
+
+			CellCompiler compiler;
+			compiler.run(baseModule, argv[1], kNativeFunctionName);
+			emitObjectFile(baseModule, compiler.globalsSize(), argv[3], compiler.options(), argv[2]);
+		}
+		else if (argc > 2)
+		{
+			// cell_compiler <script> <bytecode file> saves the script's bytecode for the interpreter
+			CellCompiler compiler;
+			if (!compiler.parse(argv[1]))
+				CellError::raise("cannot parse %s", argv[1]);
+
+			Program program;
+			compiler.generateBytecode(program);
+
+			ofstream out(argv[2], ios::binary);
+			if (!out)
+				CellError::raise("cannot open %s", argv[2]);
+			saveProgram(program, out);
+		}
+		else if (argc > 1)
 		{
+			// cell_compiler <script> is cell_compiler --check <script> with the default base module
+			auto baseModule = loadModule(kDefaultBaseModule);
+			if (!baseModule)
+				CellError::raise("cannot load the base module");
 
-			auto baseModule = loadModule("D:\\projects\\cell\\cell_compiler\\base.bc");
 			CellCompiler compiler;
 			compiler.run(baseModule, argv[1], "custom_cell_ai_0");
+			delete baseModule;
 		}
 	}
 	catch (exception& e)
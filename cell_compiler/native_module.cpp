@@ -0,0 +1,144 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
+#include "native_module.h"
+#include "error.h"
+
+namespace chaos { namespace cell {
+
+using namespace std;
+
+void optimizeModule(llvm::Module& module, llvm::TargetMachine* machine)
+{
+	llvm::PassManagerBuilder builder;
+	builder.OptLevel = 3;
+	builder.Inliner = llvm::createFunctionInliningPass();
+	builder.LoopVectorize = true;
+	builder.SLPVectorize = true;
+
+	llvm::FunctionPassManager fpm(&module);
+	fpm.add(new llvm::DataLayout(&module));
+	if (machine)
+		machine->addAnalysisPasses(fpm);
+	builder.populateFunctionPassManager(fpm);
+
+	fpm.doInitialization();
+	for (auto function = module.begin(); function != module.end(); ++function)
+		fpm.run(*function);
+	fpm.doFinalization();
+
+	const char* exports[] = { kNativeFunctionName, kNativeGlobalsSizeName };
+
+	llvm::PassManager pm;
+	pm.add(new llvm::DataLayout(&module));
+	if (machine)
+		machine->addAnalysisPasses(pm);
+	pm.add(llvm::createInternalizePass(exports));
+	builder.populateModulePassManager(pm);
+	pm.add(llvm::createGlobalDCEPass());
+	pm.run(module);
+}
+
+void emitObjectFile(llvm::Module* module, size_t globalsSize, const std::string& cpu, const CodeGenOptions& options,
+	const std::string& objectPath)
+{
+	if (!module)
+		CellError::raise("null module");
+
+	if (!module->getFunction(kNativeFunctionName))
+		CellError::raise("cannot find %s", kNativeFunctionName);
+
+	// the loader allocates the globals block, it has no compiler to ask for its size
+	auto sizeType = llvm::Type::getInt32Ty(module->getContext());
+	new llvm::GlobalVariable(*module, sizeType, true, llvm::GlobalValue::ExternalLinkage,
+		llvm::ConstantInt::get(sizeType, globalsSize), kNativeGlobalsSizeName);
+
+	// the object runs on the same kind of machine as the compiler
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+
+	const string triple = llvm::sys::getDefaultTargetTriple();
+	string error;
+	auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+	if (!target)
+		CellError::raise("cannot find the target %s: %s", triple.c_str(), error.c_str());
+
+	// the same floating point options as the JIT, see setCodeGenOptions() of cell_game
+	llvm::TargetOptions targetOptions;
+	if (options.fastMath)
+	{
+		targetOptions.UnsafeFPMath = true;
+		targetOptions.NoInfsFPMath = true;
+		targetOptions.NoNaNsFPMath = true;
+	}
+	targetOptions.AllowFPOpFusion = (options.fastMath || options.fuseMultiplyAdd) ? llvm::FPOpFusion::Fast : llvm::FPOpFusion::Standard;
+
+	// the name of the host CPU enables its features as well
+	const string targetCPU = cpu == "native" ? llvm::sys::getHostCPUName().str() : cpu;
+
+	// shared libraries need position independent code
+	llvm::OwningPtr<llvm::TargetMachine> machine(target->createTargetMachine(triple, targetCPU, "", targetOptions,
+		llvm::Reloc::PIC_, llvm::CodeModel::Default, llvm::CodeGenOpt::Aggressive));
+	if (!machine)
+		CellError::raise("cannot create a target machine for %s", targetCPU.c_str());
+
+	module->setTargetTriple(triple);
+	module->setDataLayout(machine->getDataLayout()->getStringRepresentation());
+
+	if (llvm::verifyModule(*module, llvm::ReturnStatusAction, &error))
+		CellError::raise("invalid module: %s", error.c_str());
+
+	optimizeModule(*module, machine.get());
+
+	// a DLL exports what the object asks it to, the other formats export every external symbol
+	if (llvm::Triple(triple).isOSWindows())
+	{
+		module->getFunction(kNativeFunctionName)->setLinkage(llvm::GlobalValue::DLLExportLinkage);
+		module->getGlobalVariable(kNativeGlobalsSizeName)->setLinkage(llvm::GlobalValue::DLLExportLinkage);
+	}
+
+	string errorInfo;
+	llvm::tool_output_file out(objectPath.c_str(), errorInfo, llvm::sys::fs::F_Binary);
+	if (!errorInfo.empty())
+		CellError::raise("cannot open %s: %s", objectPath.c_str(), errorInfo.c_str());
+
+	{
+		llvm::PassManager pm;
+		pm.add(new llvm::DataLayout(*machine->getDataLayout()));
+		machine->addAnalysisPasses(pm);
+
+		// the stream flushes into the file when it goes out of scope
+		llvm::formatted_raw_ostream stream(out.os());
+		if (machine->addPassesToEmitFile(pm, stream, llvm::TargetMachine::CGFT_ObjectFile))
+			CellError::raise("the target %s cannot emit object files", triple.c_str());
+
+		pm.run(*module);
+	}
+
+	out.keep();
+}
+
+}} // chaos::cell
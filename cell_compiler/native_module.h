@@ -0,0 +1,52 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_native_module_H
+#define __CELL_native_module_H
+
+#include "types.h"
+
+#include <string>
+
+namespace llvm {
+	class Module;
+	class TargetMachine;
+}
+
+namespace chaos { namespace cell {
+
+//! The name of the script's function in a native object. It has the signature of 'cell_main_template'.
+const char* const kNativeFunctionName = "cell_ai";
+
+//! The name of the unsigned 32-bit constant holding the size of the function's globals block.
+const char* const kNativeGlobalsSizeName = "cell_ai_globals_size";
+
+//! The extension of the shared libraries the native objects are linked into.
+#ifdef _WIN32
+const char* const kNativeLibraryExtension = ".dll";
+#else
+const char* const kNativeLibraryExtension = ".so";
+#endif
+
+//! Optimizes \a module with the standard -O3 pipeline, as emitObjectFile() does.
+//! Everything but the exported names becomes internal, so the helpers of the base module
+//! the script doesn't call are dropped. \a machine adds the cost models of its target, it may be null.
+void optimizeModule(llvm::Module& module, llvm::TargetMachine* machine);
+
+//! Compiles \a module ahead of time into a native object file at \a objectPath.
+//! The module holds the base module and the script's function, generated as kNativeFunctionName.
+//! Only the function and the base module's helpers it calls are kept, optimized at -O3 for \a cpu
+//! of the host's target. "native" stands for the CPU the compiler runs on, an empty name for a generic one.
+//! The code is position independent, ready to be linked into a shared library.
+//! Raises CellError if the target or the file are not available.
+void emitObjectFile(llvm::Module* module, size_t globalsSize, const std::string& cpu, const CodeGenOptions& options,
+	const std::string& objectPath);
+
+}} // chaos::cell
+
+#endif // __CELL_native_module_H
@@ -29,6 +29,11 @@ const char* toString(RuleID rid)
 	case RID_START_SYMBOL:                      return "start_symbol";
 	case RID_TRANSLATION_UNIT:                  return "translation_unit";
 	case RID_GLOBAL_DECLARATION:                return "global_declaration";
+	case RID_FUNCTION_DEFINITION:               return "function_definition";
+	case RID_FUNCTION_MODIFIER:                 return "function_modifier";
+	case RID_FUNCTION_DECLARATOR:               return "function_declarator";
+	case RID_PARAMETER_LIST:                    return "parameter_list";
+	case RID_PARAMETER:                         return "parameter";
 	case RID_TYPE_SPECIFIER:                    return "type_specifier";
 	case RID_TYPE_MODIFIER:                     return "type_modifier";
 	case RID_ARGUMENT_LIST:                     return "argument_list";
@@ -77,6 +82,7 @@ const char* toString(RuleID rid)
 	case RID_WHILE_STATEMENT:                   return "while_statement";
 	case RID_STATEMENT_EXPRESSION_LIST:         return "statement_expression_list";
 	case RID_QUIT_STATEMENT:                    return "quit_statement";
+	case RID_RETURN_STATEMENT:                  return "return_statement";
 	case RID_QUALIFIED_IDENTIFIER:              return "qualified_identifier";
 	case RID_TYPE_DECLARATION:                  return "type_declaration";
 	case RID_ARRAY_SPECIFIER:                   return "array_specifier";
@@ -42,6 +42,11 @@ enum RuleID
 	RID_START_SYMBOL,
 	RID_TRANSLATION_UNIT,
 	RID_GLOBAL_DECLARATION,
+	RID_FUNCTION_DEFINITION,
+	RID_FUNCTION_MODIFIER,
+	RID_FUNCTION_DECLARATOR,
+	RID_PARAMETER_LIST,
+	RID_PARAMETER,
 
 // Types
 
@@ -99,6 +104,7 @@ enum RuleID
 	RID_WHILE_STATEMENT,
 	RID_STATEMENT_EXPRESSION_LIST,
 	RID_QUIT_STATEMENT,
+	RID_RETURN_STATEMENT,
 	RID_QUALIFIED_IDENTIFIER,
 	RID_TYPE_DECLARATION,
 	RID_ARRAY_SPECIFIER,
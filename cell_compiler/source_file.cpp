@@ -0,0 +1,83 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "source_file.h"
+
+namespace chaos { namespace cell {
+
+using namespace boost::interprocess;
+
+////////////////////////////////////////////////////////////////////////////////
+// SourceFile
+
+SourceFile::SourceFile()
+	: _first(nullptr)
+	, _last(nullptr)
+{}
+
+bool SourceFile::open(const std::string& path)
+{
+	close();
+
+	try
+	{
+		file_mapping(path.c_str(), read_only).swap(_file);
+	}
+	catch (interprocess_exception&)
+	{
+		return false;
+	}
+
+	try
+	{
+		mapped_region(_file, read_only).swap(_region);
+		_first = static_cast<const char*>(_region.get_address());
+		_last = _first + _region.get_size();
+	}
+	catch (interprocess_exception&)
+	{
+		// an empty file cannot be mapped, it is an empty source
+	}
+
+	_path = path;
+	_lines.reset(_first, _last);
+	return true;
+}
+
+void SourceFile::close()
+{
+	mapped_region().swap(_region);
+	file_mapping().swap(_file);
+
+	_path.clear();
+	std::vector<char>().swap(_text);
+	_first = _last = nullptr;
+	_lines.reset(nullptr, nullptr);
+}
+
+void SourceFile::takeText(std::vector<char>& text)
+{
+	mapped_region().swap(_region);
+	file_mapping().swap(_file);
+
+	_text.swap(text);
+	std::vector<char>().swap(text);
+
+	_first = _text.empty() ? nullptr : &_text[0];
+	_last = _first + _text.size();
+	_lines.reset(_first, _last);
+}
+
+ParsePosition SourceFile::position(const char* where) const
+{
+	int line, column;
+	_lines.position(where, line, column);
+	return ParsePosition(_path, line, column);
+}
+
+}} // chaos::cell
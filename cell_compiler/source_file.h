@@ -0,0 +1,68 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#ifndef __CELL_source_file_H
+#define __CELL_source_file_H
+
+#include "spirit.h" // ParsePosition
+#include "line_map.h"
+#include "boost/noncopyable.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+
+#include <string>
+#include <vector>
+
+namespace chaos { namespace cell {
+
+//! A script file mapped read-only into memory.
+//! The parsers read straight from the mapping and the AST keeps pointers into
+//! it, so a position is only computed when an error asks for one. Once the tree
+//! is built the text is copied out with takeText(), a mapped file cannot be
+//! saved over on Windows.
+class SourceFile : boost::noncopyable
+{
+public:
+	SourceFile();
+
+	//! Maps the file at \a path, releasing the previous one.
+	//! Returns \a false if the file cannot be opened.
+	bool open(const std::string& path);
+
+	//! Releases the mapping.
+	void close();
+
+	//! Makes \a text, a copy of the mapped source, the source and releases
+	//! the mapping. \a text is left empty.
+	void takeText(std::vector<char>& text);
+
+	//! Gets the path of the mapped file.
+	const std::string& path() const { return _path; }
+
+	//! Gets the first character of the source.
+	const char* begin() const { return _first; }
+
+	//! Gets the end of the source.
+	const char* end() const { return _last; }
+
+	//! Computes the position of \a where, which points into the source.
+	ParsePosition position(const char* where) const;
+
+private:
+	std::string                        _path;
+	boost::interprocess::file_mapping  _file;
+	boost::interprocess::mapped_region _region;
+	std::vector<char>                  _text; //! Set by takeText().
+	const char*                        _first;
+	const char*                        _last;
+	LineMap                            _lines;
+};
+
+}} // chaos::cell
+
+#endif // __CELL_source_file_H
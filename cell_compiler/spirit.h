@@ -32,7 +32,7 @@ namespace spirit_classic = boost::spirit::classic;
 
 namespace chaos { namespace cell {
 
-typedef spirit_classic::position_iterator<std::string::iterator> ParseIterator;
+typedef spirit_classic::position_iterator<const char*> ParseIterator;
 typedef ParseIterator::position_t ParsePosition;
 typedef spirit_classic::tree_parse_info<ParseIterator, spirit_classic::node_iter_data_factory<> > TreeParseResult;
 typedef spirit_classic::tree_match<ParseIterator, spirit_classic::node_iter_data_factory<> > TreeMatch;
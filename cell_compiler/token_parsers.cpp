@@ -191,6 +191,7 @@ TypeSpecifier getTypeSpecifier(const string& text)
 				str_p( INT_T    )[ assign_a( result, TS_INT    ) ]
 			|	str_p( REAL_T   )[ assign_a( result, TS_REAL   ) ]
 			|	str_p( VECTOR_T )[ assign_a( result, TS_VECTOR ) ]
+			|	str_p( VOID_T   )[ assign_a( result, TS_VOID   ) ]
 		]
 		;
 		parse(text.c_str(), r, skip);
@@ -70,11 +70,14 @@
 
 #define ELSE_T              "else"
 #define FALSE_T             "false"
+#define FAST_T              "fast"
 #define GLOBAL_T            "global"
 #define IF_T                "if"
+#define INLINE_T            "inline"
 #define TRUE_T              "true"
 #define WHILE_T             "while"
 #define QUIT_T              "quit"
+#define RETURN_T            "return"
 
 // VRSL built-in types
 
@@ -83,6 +86,7 @@
 #define MATRIX_T            "mat"
 #define VECTOR_T            "vec"
 #define BOOL_T              "bool"
+#define VOID_T              "void"
 
 #endif // __CELL_tokens_H
 
@@ -20,7 +20,25 @@ enum TypeSpecifier
 	TS_NONE,
 	TS_INT,
 	TS_REAL,
-	TS_VECTOR
+	TS_VECTOR,
+	TS_VOID    //! Only the result of functions.
+};
+
+//! Arrays hold at most this many elements. They live on the stack of the
+//! generated function and in the registers of the interpreter.
+const int kMaxArrayLength = 1024;
+
+//! How the native code computes with reals. A script may ask for 'fastMath'
+//! in its own functions with the 'fast' modifier, which implies 'fuseMultiplyAdd'.
+//! The interpreter always computes exactly as written.
+struct CodeGenOptions
+{
+	CodeGenOptions() : fastMath(false), fuseMultiplyAdd(false), targetHostCPU(false)
+	{}
+
+	bool fastMath;        //! Real math may be reordered as if it were exact, and never sees NaN or infinity.
+	bool fuseMultiplyAdd; //! 'a * b + c' may be computed with a single rounding where the CPU has FMA.
+	bool targetHostCPU;   //! The code is tuned for the CPU which runs it and may use all its features.
 };
 
 //! Operators.
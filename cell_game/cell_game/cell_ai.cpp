@@ -9,17 +9,38 @@
 // LLVM
 #include "llvm\PassManager.h"
 #include "llvm\IR\DataLayout.h"
+#include "llvm\IR\LLVMContext.h"
+#include "llvm\Support\CodeGen.h"
+#include "llvm\Support\Host.h"
 #include "llvm\Support\TargetSelect.h"
+#include "llvm\Support\Threading.h"
 #include "llvm\Analysis\Passes.h"
 #include "llvm\Analysis\Verifier.h"
 #include "llvm\Transforms\IPO.h"
+#include "llvm\Transforms\IPO\PassManagerBuilder.h"
 #include "llvm\Transforms\Scalar.h"
+#include "llvm\Target\TargetOptions.h"
 #include "llvm\ExecutionEngine\JIT.h"
 #include "llvm\ExecutionEngine\ExecutionEngine.h"
 
 // Cell Compiler project
 #include "..\..\cell_compiler\ir_generator.h"
 
+// Standard headers
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// Platform headers, for loading shared libraries
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
 // Project headers
 #include "cell.h"
 #include "cell_ai.h"
@@ -29,6 +50,24 @@ using namespace std;
 using namespace llvm;
 using namespace chaos::cell;
 
+// Passes the script's code generation options on to the code generator of an execution engine.
+static void setCodeGenOptions(EngineBuilder &builder, const CodeGenOptions &options) {
+	TargetOptions targetOptions;
+	if (options.fastMath) {
+		targetOptions.UnsafeFPMath = true;
+		targetOptions.NoInfsFPMath = true;
+		targetOptions.NoNaNsFPMath = true;
+	}
+	// The standard setting only fuses the llvm.fmuladd calls of the 'fast' functions, fast fuses every product and sum.
+	targetOptions.AllowFPOpFusion = (options.fastMath || options.fuseMultiplyAdd) ? FPOpFusion::Fast : FPOpFusion::Standard;
+	builder.setTargetOptions(targetOptions);
+
+	// The name of the host CPU enables its features as well, SSE4 and AVX included.
+	if (options.targetHostCPU) {
+		builder.setMCPU(sys::getHostCPUName());
+	}
+}
+
 ////////////////////////////////////////////////////////////
 // ICellAI implementation
 
@@ -38,23 +77,77 @@ ICellAI::~ICellAI() {
 void ICellAI::prepare() {
 }
 
+void ICellAI::reload() {
+	prepare();
+}
+
+////////////////////////////////////////////////////////////
+// CustomAI::OptimizedTier declaration
+
+// Builds a fully optimized version of the script on a background thread.
+// The tier owns a private LLVM context, base module and execution engine so it never
+// touches the objects the fast tier uses on the main thread. The only shared object is
+// the compiler's AST, which is read-only while the tier runs. An abandoned tier takes the compiler along.
+class CustomAI::OptimizedTier {
+
+public:
+	OptimizedTier(const string &modulePath, CellCompiler &scriptCompiler, const string &functionName, atomic<CustomAIFuncion> &result);
+	~OptimizedTier();
+
+	// Gives up on the tier without waiting for it and falls back to the fast tier. Its result is discarded,
+	// and once the worker finishes it deletes itself and the compiler. Returns false if the worker had
+	// already finished, the tier is deleted right away then and the caller keeps the compiler.
+	static bool abandon(OptimizedTier *tier);
+
+private:
+	OptimizedTier(const OptimizedTier &);
+	OptimizedTier& operator=(const OptimizedTier &);
+
+	string baseModulePath;
+	string uniqueScriptName;
+	CellCompiler &compiler;
+	atomic<CustomAIFuncion> &optimizedAI;
+
+	LLVMContext context;
+	Module *module;
+	ExecutionEngine *executionEngine;
+	thread worker;
+
+	// Guards the flags below, the worker checks them before it publishes its result.
+	mutex stateLock;
+	bool abandoned;
+	bool finished;
+
+	void run();
+	void compile();
+	void optimizeModule();
+	void publish(CustomAIFuncion function);
+};
+
 ////////////////////////////////////////////////////////////
 // CustomAI implementation
 
 int CustomAI::instanceCount = 0;
 Module* CustomAI::baseModule = NULL;
 ExecutionEngine *CustomAI::executionEngine = NULL;
-CellCompiler CustomAI::compiler;
 
-CustomAI::CustomAI(const char *modulePath, const char *scriptPath, const char *uniqueName) 
-	: baseModulePath(modulePath)
+CustomAI::CustomAI(const char *modulePath, const char *scriptPath, const char *uniqueName, bool useTieredCompilation, const CodeGenOptions &codeGenOptions) 
+	: compiler(new CellCompiler())
+	, baseModulePath(modulePath)
 	, playerScriptPath(scriptPath)
 	, uniqueScriptName(uniqueName)
-	, customAI(NULL) {
+	, tieredCompilation(useTieredCompilation)
+	, customAI(NULL)
+	, optimizedAI(NULL)
+	, optimizedTier(NULL) {
+	compiler->setOptions(codeGenOptions);
 	++instanceCount;
 }
 
 CustomAI::~CustomAI() {
+	stopOptimizedTier();
+	delete compiler;
+
 	--instanceCount;
 	if (instanceCount == 0) {
 		delete executionEngine;
@@ -64,6 +157,9 @@ CustomAI::~CustomAI() {
 }
 
 void CustomAI::prepare() {
+	// 0. The optimized tier of the previous script may still be compiling. Leave it behind rather than wait for it.
+	abandonOptimizedTier();
+
 	// 1. Make sure we have a loaded LLVM module.
 	loadBaseModule();
 
@@ -74,29 +170,66 @@ void CustomAI::prepare() {
 	if (baseModule) {
 		// 3.1. Parse the script file and add the function's definition to the base module.
 		try {
-			compiler.run(baseModule, playerScriptPath, uniqueScriptName);
+			compiler->run(baseModule, playerScriptPath, uniqueScriptName);
 		} catch (const CellError &e) {
 			// There was a problem with the parsing or code generation.
 			printf("%s\n", e.what());
 			return;
 		}
 
-		// 3.2. Now that we have the function's definition in the base module run optimization passes on the whole thing.
-		runtimeOptimizeModule();
+		// 3.2. A new script starts with its global variables zeroed.
+		globals.assign((compiler->globalsSize() + sizeof(double) - 1) / sizeof(double), 0.0);
 
 		// 3.3. Get a pointer to the function's definition in the base module.
 		Function *llvmCustomAIFunction = baseModule->getFunction(uniqueScriptName);
-		if (llvmCustomAIFunction && executionEngine) {
-			// 3.4. JIT compile the retrieved function definition and aquire an invokable C++ pointer to the compiled image.
-			customAI = reinterpret_cast<CustomAIFuncion>(executionEngine->getPointerToFunction(llvmCustomAIFunction));
+		if (!llvmCustomAIFunction || !executionEngine) {
+			return;
+		}
+
+		if (tieredCompilation) {
+			// 3.4. Fast tier. Only expand the functions the script marks 'inline' and promote the locals to registers,
+			// the engine generates code without optimizations.
+			PassManager pm;
+			pm.add(createAlwaysInlinerPass());
+			pm.run(*baseModule);
+
+			FunctionPassManager fpm(baseModule);
+			fpm.add(createPromoteMemoryToRegisterPass());
+			fpm.doInitialization();
+			fpm.run(*llvmCustomAIFunction);
+			// the script's own functions are named after it
+			const string functionPrefix = uniqueScriptName + ".";
+			for (Module::iterator function = baseModule->begin(); function != baseModule->end(); ++function) {
+				if (!function->isDeclaration() && function->getName().startswith(functionPrefix)) {
+					fpm.run(*function);
+				}
+			}
+			fpm.doFinalization();
+		} else {
+			// 3.4. Now that we have the function's definition in the base module run optimization passes on the whole thing.
+			runtimeOptimizeModule();
+		}
+
+		// 3.5. JIT compile the retrieved function definition and aquire an invokable C++ pointer to the compiled image.
+		customAI = reinterpret_cast<CustomAIFuncion>(executionEngine->getPointerToFunction(llvmCustomAIFunction));
+
+		// 3.6. Build the optimized tier in the background. It replaces the fast tier as soon as it is ready.
+		if (tieredCompilation && customAI) {
+			startOptimizedTier();
 		}
 	}
 }
 
 void CustomAI::calculateForce(vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const {
-	// 4. Invoke the custom AI function.
-	if (customAI && !cells.empty()) {
-		customAI(&(cells[0]), liveCellCount, arenaRadius, &force);
+	// 4. Invoke the custom AI function. The pointer is read once per call, so switching to the optimized tier
+	//    always happens at a tick boundary.
+	CustomAIFuncion function = optimizedAI.load(memory_order_acquire);
+	if (!function) {
+		function = customAI;
+	}
+
+	if (function && !cells.empty()) {
+		function(&(cells[0]), liveCellCount, arenaRadius, &force, globals.empty() ? NULL : reinterpret_cast<char *>(&globals[0]));
 	}
 }
 
@@ -124,9 +257,18 @@ void CustomAI::createExecutionEngine() {
 		// 2.1. Initialize the native target so we can JIT compile code for it.
 		InitializeNativeTarget();
 
-		// 2.2. Create the LLVM execution engine.
+		// 2.2. The optimized tier uses LLVM from a background thread.
+		llvm_start_multithreaded();
+
+		// 2.3. Create the LLVM execution engine. With tiered compilation it only serves the fast tier so skip code generator optimizations.
+		//      The engine is shared, the options of the first script apply to all of them.
 		string errorMessage;
-		executionEngine = EngineBuilder(baseModule).setEngineKind(EngineKind::JIT).setErrorStr(&errorMessage).create();
+		EngineBuilder builder(baseModule);
+		builder.setEngineKind(EngineKind::JIT)
+			.setOptLevel(tieredCompilation ? CodeGenOpt::None : CodeGenOpt::Default)
+			.setErrorStr(&errorMessage);
+		setCodeGenOptions(builder, compiler->options());
+		executionEngine = builder.create();
 		if (!errorMessage.empty()) {
 			// There is a problem with the execution engine.
 			printf("Failed to create an execution engine!\n%s\n", errorMessage.c_str());
@@ -144,14 +286,16 @@ void CustomAI::runtimeOptimizeModule() {
 
 		// Provide basic AliasAnalysis support for GVN.
 		pm.add(createBasicAliasAnalysisPass());
-		// Promote allocas to registers.
-		pm.add(createPromoteMemoryToRegisterPass());
+		// Split the vec and array allocas into scalars and promote them to registers.
+		pm.add(createSROAPass());
 		// Do simple "peephole" optimizations and bit-twiddling optimizations.
 		pm.add(createInstructionCombiningPass());
 		// Reassociate expressions.
 		pm.add(createReassociatePass());
 		// Eliminate Common SubExpressions.
 		pm.add(createGVNPass());
+		// Fold the array bounds checks which the loop conditions already imply.
+		pm.add(createCorrelatedValuePropagationPass());
 		// Simplify the control flow graph (deleting unreachable blocks, etc).
 		pm.add(createCFGSimplificationPass());
 		// Constant propagation pass.
@@ -167,6 +311,32 @@ void CustomAI::runtimeOptimizeModule() {
 	}
 }
 
+void CustomAI::startOptimizedTier() {
+	optimizedTier = new OptimizedTier(baseModulePath, *compiler, uniqueScriptName, optimizedAI);
+}
+
+void CustomAI::stopOptimizedTier() {
+	// Fall back to the fast tier before the optimized code is released.
+	optimizedAI.store(NULL, memory_order_release);
+
+	// Joins the background thread.
+	delete optimizedTier;
+	optimizedTier = NULL;
+}
+
+void CustomAI::abandonOptimizedTier() {
+	if (optimizedTier) {
+		// Falls back to the fast tier as well.
+		if (OptimizedTier::abandon(optimizedTier)) {
+			// The tier keeps reading the AST of the previous script, parse the next one with a compiler of our own.
+			CellCompiler *nextCompiler = new CellCompiler();
+			nextCompiler->setOptions(compiler->options());
+			compiler = nextCompiler;
+		}
+		optimizedTier = NULL;
+	}
+}
+
 void CustomAI::reload() {
 	static int invokeCount = 0;
 
@@ -179,6 +349,282 @@ void CustomAI::reload() {
 	prepare();
 }
 
+////////////////////////////////////////////////////////////
+// CustomAI::OptimizedTier implementation
+
+CustomAI::OptimizedTier::OptimizedTier(const string &modulePath, CellCompiler &scriptCompiler, const string &functionName, atomic<CustomAIFuncion> &result)
+	: baseModulePath(modulePath)
+	, uniqueScriptName(functionName)
+	, compiler(scriptCompiler)
+	, optimizedAI(result)
+	, module(NULL)
+	, executionEngine(NULL)
+	, abandoned(false)
+	, finished(false) {
+	// Start the worker last, everything it uses is initialized by now.
+	worker = thread(&OptimizedTier::run, this);
+}
+
+CustomAI::OptimizedTier::~OptimizedTier() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+
+	// The execution engine owns the module.
+	if (executionEngine) {
+		delete executionEngine;
+	} else {
+		delete module;
+	}
+}
+
+bool CustomAI::OptimizedTier::abandon(OptimizedTier *tier) {
+	bool running;
+	{
+		lock_guard<mutex> guard(tier->stateLock);
+		// Under the lock, so a result published just before is withdrawn and none can follow.
+		tier->abandoned = true;
+		tier->optimizedAI.store(NULL, memory_order_release);
+
+		// A running worker cleans up after itself, see run().
+		running = !tier->finished;
+		if (running) {
+			tier->worker.detach();
+		}
+	}
+
+	if (!running) {
+		delete tier;
+	}
+	return running;
+}
+
+void CustomAI::OptimizedTier::run() {
+	compile();
+
+	bool selfDelete;
+	{
+		lock_guard<mutex> guard(stateLock);
+		finished = true;
+		selfDelete = abandoned;
+	}
+
+	// Nobody owns an abandoned tier any more, nor the compiler it was handed.
+	if (selfDelete) {
+		CellCompiler *abandonedCompiler = &compiler;
+		delete this;
+		delete abandonedCompiler;
+	}
+}
+
+void CustomAI::OptimizedTier::publish(CustomAIFuncion function) {
+	lock_guard<mutex> guard(stateLock);
+	if (!abandoned) {
+		optimizedAI.store(function, memory_order_release);
+	}
+}
+
+void CustomAI::OptimizedTier::compile() {
+	try {
+		// 1. Load a private copy of the base module.
+		module = loadModule(baseModulePath.c_str(), context);
+		if (!module) {
+			return;
+		}
+
+		// 2. Generate the function from the already parsed script.
+		compiler.generate(module, uniqueScriptName);
+
+		// 3. Optimize the whole module.
+		optimizeModule();
+
+		// 4. Create an engine with full code generator optimizations.
+		string errorMessage;
+		EngineBuilder builder(module);
+		builder.setEngineKind(EngineKind::JIT)
+			.setOptLevel(CodeGenOpt::Aggressive)
+			.setErrorStr(&errorMessage);
+		setCodeGenOptions(builder, compiler.options());
+		executionEngine = builder.create();
+		if (!executionEngine) {
+			printf("Failed to create an execution engine for the optimized tier!\n%s\n", errorMessage.c_str());
+			return;
+		}
+
+		// 5. Compile everything the function calls right now rather than lazily on the simulation thread.
+		executionEngine->DisableLazyCompilation(true);
+
+		Function *llvmCustomAIFunction = module->getFunction(uniqueScriptName);
+		if (llvmCustomAIFunction) {
+			// 6. Publish the optimized function. The simulation picks it up on its next tick.
+			void *function = executionEngine->getPointerToFunction(llvmCustomAIFunction);
+			publish(reinterpret_cast<CustomAIFuncion>(function));
+		}
+	} catch (const CellError &e) {
+		// The fast tier keeps running.
+		printf("%s\n", e.what());
+	}
+}
+
+void CustomAI::OptimizedTier::optimizeModule() {
+	// The standard -O3 pipeline.
+	PassManagerBuilder builder;
+	builder.OptLevel = 3;
+	builder.Inliner = createFunctionInliningPass();
+	builder.LoopVectorize = true;
+	builder.SLPVectorize = true;
+
+	FunctionPassManager fpm(module);
+	fpm.add(new DataLayout(module->getDataLayout()));
+	builder.populateFunctionPassManager(fpm);
+
+	fpm.doInitialization();
+	for (Module::iterator function = module->begin(); function != module->end(); ++function) {
+		fpm.run(*function);
+	}
+	fpm.doFinalization();
+
+	PassManager pm;
+	pm.add(new DataLayout(module->getDataLayout()));
+	builder.populateModulePassManager(pm);
+	pm.run(*module);
+}
+
+////////////////////////////////////////////////////////////
+// InterpretedAI implementation
+
+// The interpreter reads the cells through CellData.
+typedef char CellLayoutCheck[(sizeof(Cell) == sizeof(CellData)) ? 1 : -1];
+
+InterpretedAI::InterpretedAI(const char *scriptPath)
+	: playerScriptPath(scriptPath) {
+}
+
+InterpretedAI::~InterpretedAI() {
+}
+
+void InterpretedAI::prepare() {
+	Program program;
+
+	try {
+		const size_t extensionLength = strlen(kBytecodeExtension);
+		if (playerScriptPath.size() > extensionLength &&
+			playerScriptPath.compare(playerScriptPath.size() - extensionLength, extensionLength, kBytecodeExtension) == 0) {
+			// 1. Load the bytecode saved by the compiler. This skips parsing altogether.
+			ifstream in(playerScriptPath.c_str(), ios::binary);
+			if (in) {
+				loadProgram(program, in);
+			} else {
+				printf("cannot open %s\n", playerScriptPath.c_str());
+			}
+		} else if (compiler.parse(playerScriptPath)) {
+			// 1. Parse the script and generate its bytecode.
+			compiler.generateBytecode(program);
+		} else {
+			printf("cannot parse %s\n", playerScriptPath.c_str());
+		}
+	} catch (const CellError &e) {
+		// There was a problem with the parsing, code generation or the saved bytecode.
+		printf("%s\n", e.what());
+		program.clear();
+	}
+
+	// 2. Replace the previous program. A failed script leaves the cell without a force.
+	interpreter.load(program);
+}
+
+void InterpretedAI::calculateForce(vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const {
+	// 3. Run the program. Cell has the same layout as the script's cells.
+	if (interpreter.loaded() && !cells.empty()) {
+		interpreter.run(reinterpret_cast<const CellData*>(&(cells[0])), liveCellCount, arenaRadius, &force.x);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// NativeAI implementation
+
+static void* openLibrary(const char *path) {
+#ifdef _WIN32
+	return LoadLibraryA(path);
+#else
+	return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* findSymbol(void *library, const char *name) {
+#ifdef _WIN32
+	return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+	return dlsym(library, name);
+#endif
+}
+
+static void closeLibrary(void *library) {
+#ifdef _WIN32
+	FreeLibrary(static_cast<HMODULE>(library));
+#else
+	dlclose(library);
+#endif
+}
+
+NativeAI::NativeAI(const char *libraryPath)
+	: playerLibraryPath(libraryPath)
+	, library(NULL)
+	, nativeAI(NULL) {
+}
+
+NativeAI::~NativeAI() {
+	unloadLibrary();
+}
+
+bool NativeAI::isLibraryPath(const char *path) {
+	const size_t pathLength = strlen(path);
+	const size_t extensionLength = strlen(kNativeLibraryExtension);
+	return pathLength > extensionLength && strcmp(path + pathLength - extensionLength, kNativeLibraryExtension) == 0;
+}
+
+void NativeAI::prepare() {
+	// 1. Release the previous library, or the system hands out the same one again.
+	unloadLibrary();
+
+	// 2. Load the library.
+	library = openLibrary(playerLibraryPath.c_str());
+	if (!library) {
+		printf("cannot load %s\n", playerLibraryPath.c_str());
+		return;
+	}
+
+	// 3. Find the script's function and the size of its global variables.
+	NativeAIFunction function = reinterpret_cast<NativeAIFunction>(findSymbol(library, kNativeFunctionName));
+	const unsigned int *globalsSize = static_cast<const unsigned int*>(findSymbol(library, kNativeGlobalsSizeName));
+	if (!function || !globalsSize) {
+		printf("%s is not a compiled script\n", playerLibraryPath.c_str());
+		unloadLibrary();
+		return;
+	}
+
+	// 4. A new script starts with its global variables zeroed.
+	globals.assign((*globalsSize + sizeof(double) - 1) / sizeof(double), 0.0);
+	nativeAI = function;
+}
+
+void NativeAI::calculateForce(vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const {
+	// 5. Invoke the compiled function, it has the signature of CustomAI's.
+	if (nativeAI && !cells.empty()) {
+		nativeAI(&(cells[0]), liveCellCount, arenaRadius, &force, globals.empty() ? NULL : reinterpret_cast<char *>(&globals[0]));
+	}
+}
+
+void NativeAI::unloadLibrary() {
+	nativeAI = NULL;
+	globals.clear();
+
+	if (library) {
+		closeLibrary(library);
+		library = NULL;
+	}
+}
+
 ////////////////////////////////////////////////////////////
 // DefaultAI implementation
 
@@ -10,9 +10,12 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
 
 // Cell Compiler project
 #include "..\..\cell_compiler\cell_compiler.h"
+#include "..\..\cell_compiler\interpreter.h"
+#include "..\..\cell_compiler\native_module.h"
 
 namespace llvm {
 	class ExecutionEngine;
@@ -34,6 +37,9 @@ public:
 
 	virtual void prepare();
 
+	// Picks up changes of the script. Prepares the AI again by default.
+	virtual void reload();
+
 	virtual void calculateForce(std::vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const = 0;
 };
 
@@ -43,14 +49,15 @@ public:
 class CustomAI : public ICellAI {
 	
 public:
-	CustomAI(const char *modulePath, const char *scriptPath, const char *uniqueName);
+	CustomAI(const char *modulePath, const char *scriptPath, const char *uniqueName, bool useTieredCompilation = true,
+		const CodeGenOptions &codeGenOptions = CodeGenOptions());
 	virtual ~CustomAI();
 
 	virtual void prepare();
 
 	virtual void calculateForce(std::vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const;
 
-	void reload();
+	virtual void reload();
 
 private:
 	static int instanceCount;
@@ -58,21 +65,97 @@ private:
 	static llvm::Module *baseModule;
 	static llvm::ExecutionEngine *executionEngine;
 
-	static chaos::cell::CellCompiler compiler;
-
 	CustomAI(const CustomAI &);
 	CustomAI& operator=(const CustomAI &);
 
+	class OptimizedTier;
+
+	// On the heap, a reload hands the previous one over to the optimized tier still compiling it.
+	chaos::cell::CellCompiler *compiler;
+
 	std::string baseModulePath;
 	std::string playerScriptPath;
 	std::string uniqueScriptName;
+	bool tieredCompilation;
 
-	typedef void (*CustomAIFuncion)(Cell *, int, float, Vector *);
+	typedef void (*CustomAIFuncion)(Cell *, int, float, Vector *, char *);
 	CustomAIFuncion customAI;
 
+	// The script's global variables. Both tiers share the layout, so the values survive the switch.
+	// Doubles keep the block aligned for vec.
+	mutable std::vector<double> globals;
+
+	// Published by the optimized tier once its background compilation finishes.
+	std::atomic<CustomAIFuncion> optimizedAI;
+	OptimizedTier *optimizedTier;
+
 	void loadBaseModule();
 	void createExecutionEngine();
 	void runtimeOptimizeModule();
+	void startOptimizedTier();
+	void stopOptimizedTier();
+	void abandonOptimizedTier();
+};
+
+////////////////////////////////////////////////////////////
+// InterpretedAI declaration
+
+// Runs the player's script in the bytecode interpreter. Needs neither the base module nor LLVM's JIT.
+class InterpretedAI : public ICellAI {
+
+public:
+	InterpretedAI(const char *scriptPath);
+	virtual ~InterpretedAI();
+
+	virtual void prepare();
+
+	virtual void calculateForce(std::vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const;
+
+private:
+	InterpretedAI(const InterpretedAI &);
+	InterpretedAI& operator=(const InterpretedAI &);
+
+	chaos::cell::CellCompiler compiler;
+
+	std::string playerScriptPath;
+
+	// Running a program only touches the interpreter's registers.
+	mutable chaos::cell::Interpreter interpreter;
+};
+
+////////////////////////////////////////////////////////////
+// NativeAI declaration
+
+// Runs the player's script compiled ahead of time by cell_compiler and linked into a shared library.
+// Needs neither the base module nor LLVM, the code is loaded as it is.
+class NativeAI : public ICellAI {
+
+public:
+	NativeAI(const char *libraryPath);
+	virtual ~NativeAI();
+
+	// Whether the path names a shared library rather than a script.
+	static bool isLibraryPath(const char *path);
+
+	// Loads the library again, it may have been rebuilt in the meantime.
+	virtual void prepare();
+
+	virtual void calculateForce(std::vector<Cell> &cells, const int liveCellCount, const float arenaRadius, Vector &force) const;
+
+private:
+	NativeAI(const NativeAI &);
+	NativeAI& operator=(const NativeAI &);
+
+	std::string playerLibraryPath;
+	void *library;
+
+	typedef void (*NativeAIFunction)(Cell *, int, float, Vector *, char *);
+	NativeAIFunction nativeAI;
+
+	// The script's global variables, allocated like CustomAI's.
+	mutable std::vector<double> globals;
+
+	void unloadLibrary();
 };
 
 ////////////////////////////////////////////////////////////
@@ -0,0 +1,94 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include <cmath>
+
+#include "cell.h"
+#include "cell_grid.h"
+#include "math_utils.h"
+
+using namespace std;
+using namespace chaos::cell;
+
+// Keeps the bucket array small for huge cell counts.
+static const int MAX_COLUMN_COUNT = 1024;
+
+////////////////////////////////////////////////////////////
+// CellGrid implementation
+
+CellGrid::CellGrid()
+	: columnCount(1)
+	, bucketSize(1.0f)
+	, inverseBucketSize(1.0f)
+	, maxRadius(0.0f)
+	, bucketStarts(2, 0) {
+}
+
+void CellGrid::build(const vector<Cell> &cells, int cellCount, const Vector &arenaCenter, float arenaRadius, int cellsPerBucket) {
+	// 1. Size the grid for the number of cells.
+	columnCount = clamp(static_cast<int>(sqrtf(static_cast<float>(cellCount) / chaos::cell::max(1, cellsPerBucket))), 1, MAX_COLUMN_COUNT);
+	bucketSize = chaos::cell::max(2.0f * arenaRadius / columnCount, EPSILON);
+	inverseBucketSize = 1.0f / bucketSize;
+	origin = arenaCenter - Vector(arenaRadius, arenaRadius);
+	maxRadius = 0.0f;
+
+	// 2. Count the cells of each bucket.
+	bucketStarts.assign(columnCount * columnCount + 1, 0);
+	cellBuckets.resize(cellCount);
+	for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex) {
+		const Cell &cell = cells[cellIndex];
+		if (cell.isDead()) {
+			cellBuckets[cellIndex] = -1;
+			continue;
+		}
+
+		int bucket = getRow(cell.position.y) * columnCount + getColumn(cell.position.x);
+		cellBuckets[cellIndex] = bucket;
+		++bucketStarts[bucket + 1];
+		maxRadius = chaos::cell::max(maxRadius, cell.radius);
+	}
+
+	// 3. Turn the counts into starts and file the cells.
+	for (size_t bucket = 1; bucket < bucketStarts.size(); ++bucket) {
+		bucketStarts[bucket] += bucketStarts[bucket - 1];
+	}
+
+	cellIndices.resize(bucketStarts.back());
+	vector<int> bucketEnds(bucketStarts.begin(), bucketStarts.end() - 1);
+	for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex) {
+		if (0 <= cellBuckets[cellIndex]) {
+			cellIndices[bucketEnds[cellBuckets[cellIndex]]++] = cellIndex;
+		}
+	}
+}
+
+void CellGrid::query(const Vector &minimum, const Vector &maximum, vector<int> &result) const {
+	const int firstColumn = getColumn(minimum.x - maxRadius);
+	const int lastColumn = getColumn(maximum.x + maxRadius);
+	const int firstRow = getRow(minimum.y - maxRadius);
+	const int lastRow = getRow(maximum.y + maxRadius);
+
+	for (int row = firstRow; row <= lastRow; ++row) {
+		// The buckets of a row are next to each other.
+		const int first = bucketStarts[row * columnCount + firstColumn];
+		const int last = bucketStarts[row * columnCount + lastColumn + 1];
+		result.insert(result.end(), cellIndices.begin() + first, cellIndices.begin() + last);
+	}
+}
+
+float CellGrid::getMaxRadius() const {
+	return maxRadius;
+}
+
+int CellGrid::getColumn(float x) const {
+	return clamp(static_cast<int>(floorf((x - origin.x) * inverseBucketSize)), 0, columnCount - 1);
+}
+
+int CellGrid::getRow(float y) const {
+	return clamp(static_cast<int>(floorf((y - origin.y) * inverseBucketSize)), 0, columnCount - 1);
+}
@@ -0,0 +1,57 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vector2d.h"
+
+namespace chaos {
+namespace cell {
+
+class Cell;
+
+////////////////////////////////////////////////////////////
+// CellGrid declaration
+
+// A uniform grid of buckets over the arena. Each live cell is filed under the bucket of its center,
+// the buckets are stored one after the other so a rebuild is two passes over the cells.
+// A query widens the area by the largest radius, so it finds every cell which may overlap it.
+class CellGrid {
+
+public:
+	CellGrid();
+
+	// Files the first cellCount cells, the dead ones are left out. The grid covers the square
+	// around the arena with about cellsPerBucket cells in each bucket.
+	void build(const std::vector<Cell> &cells, int cellCount, const Vector &arenaCenter, float arenaRadius, int cellsPerBucket = 2);
+
+	// Appends the indices of the cells which may overlap the rectangle [minimum, maximum], by bucket.
+	void query(const Vector &minimum, const Vector &maximum, std::vector<int> &cellIndices) const;
+
+	float getMaxRadius() const;
+
+private:
+	int columnCount;
+	Vector origin;
+	float bucketSize;
+	float inverseBucketSize;
+	float maxRadius;
+
+	// The cells of bucket b are cellIndices[bucketStarts[b]] up to cellIndices[bucketStarts[b + 1]].
+	std::vector<int> bucketStarts;
+	std::vector<int> cellIndices;
+	std::vector<int> cellBuckets;
+
+	int getColumn(float x) const;
+	int getRow(float y) const;
+};
+
+}; // namespace cell
+}; // namespace chaos
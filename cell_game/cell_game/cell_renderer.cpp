@@ -0,0 +1,185 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+// Standard headers
+#include <algorithm>
+#include <cmath>
+
+// Project headers
+#include "cell.h"
+#include "cell_grid.h"
+#include "cell_renderer.h"
+#include "math_utils.h"
+
+// GLUT - include last because of a redefinition problem
+#include "glut.h"
+
+using namespace std;
+using namespace chaos::cell;
+
+// The segments of the coarsest level of detail.
+static const int MIN_CIRCLE_SEGMENT_COUNT = 8;
+
+// How far in pixels the edges of a circle may stray from the true circle.
+static const float MAX_PIXEL_ERROR = 0.25f;
+
+// Cells with a smaller radius in pixels are drawn as points.
+static const float MIN_CIRCLE_PIXEL_RADIUS = 0.5f;
+
+static const unsigned char ARENA_COLOR[4] = { 255, 255, 255, 255 };
+static const unsigned char PREY_COLOR[4] = { 0, 255, 0, 255 };
+static const unsigned char PREDATOR_COLOR[4] = { 255, 0, 0, 255 };
+static const unsigned char PLAYER_COLOR[4] = { 0, 0, 255, 255 };
+
+////////////////////////////////////////////////////////////
+// CellRenderer implementation
+
+CellRenderer::CellRenderer()
+	: viewportPixelsPerUnit(320.0f)
+	, pixelsPerUnit(320.0f)
+	, viewMinimum(-1.0f, -1.0f)
+	, viewMaximum(1.0f, 1.0f) {
+	for (int level = 0; level < LOD_LEVEL_COUNT; ++level) {
+		const int segmentCount = MIN_CIRCLE_SEGMENT_COUNT << level;
+
+		unitCircles[level].reserve(segmentCount);
+		for (int segment = 0; segment < segmentCount; ++segment) {
+			float angleRadian = DOUBLE_PI * segment / segmentCount;
+			unitCircles[level].push_back(Vector(cosf(angleRadian), sinf(angleRadian)));
+		}
+	}
+}
+
+CellRenderer::~CellRenderer() {
+}
+
+void CellRenderer::setViewport(int width, int height) {
+	viewportPixelsPerUnit = 0.5f * chaos::cell::min(width, height);
+}
+
+void CellRenderer::setCamera(const Vector &center, float zoom) {
+	const float halfSize = 1.0f / zoom;
+	viewMinimum = center - Vector(halfSize, halfSize);
+	viewMaximum = center + Vector(halfSize, halfSize);
+	pixelsPerUnit = viewportPixelsPerUnit * zoom;
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(viewMinimum.x, viewMaximum.x, viewMinimum.y, viewMaximum.y, -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+}
+
+void CellRenderer::drawArena(const Vector &center, float radius) {
+	const vector<Vector> &unitCircle = getUnitCircle(radius);
+
+	vertices.clear();
+	for (vector<Vector>::const_iterator point = unitCircle.begin(); point != unitCircle.end(); ++point) {
+		Vertex vertex = { center.x + radius * point->x, center.y + radius * point->y, { 0, 0, 0, 0 } };
+		vertices.push_back(vertex);
+	}
+
+	glColor4ubv(ARENA_COLOR);
+	glLineWidth(2.0f);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &vertices[0].x);
+	glDrawArrays(GL_LINE_LOOP, 0, static_cast<GLsizei>(vertices.size()));
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void CellRenderer::drawCells(const vector<Cell> &cells, const CellGrid &grid, const Cell &playerCell) {
+	vertices.clear();
+	indices.clear();
+	points.clear();
+
+	// 1. Find the cells near the view. The grid returns them by bucket, put them back in their
+	//    order so the same cells are drawn over each other as without the camera.
+	visibleCells.clear();
+	grid.query(viewMinimum, viewMaximum, visibleCells);
+	sort(visibleCells.begin(), visibleCells.end());
+
+	// 2. Place the ones in view in the arrays. Later cells are drawn over earlier ones.
+	for (vector<int>::const_iterator cellIndex = visibleCells.begin(); cellIndex != visibleCells.end(); ++cellIndex) {
+		const Cell &cell = cells[*cellIndex];
+		if (isVisible(cell.position, cell.radius)) {
+			addCell(cell.position, cell.radius, cell.radius < playerCell.radius ? PREY_COLOR : PREDATOR_COLOR);
+		}
+	}
+	// The player's cell stays a circle however small.
+	if (isVisible(playerCell.position, playerCell.radius)) {
+		addCircle(playerCell.position, playerCell.radius, PLAYER_COLOR);
+	}
+
+	// 3. Draw all of them at once, the points under the circles.
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	if (!points.empty()) {
+		glPointSize(1.0f);
+		glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &points[0].x);
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), points[0].color);
+		glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(points.size()));
+	}
+
+	if (!indices.empty()) {
+		glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &vertices[0].x);
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), vertices[0].color);
+		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, &indices[0]);
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+const vector<Vector>& CellRenderer::getUnitCircle(float radius) const {
+	// A chord of n segments strays r * (1 - cos(pi / n)) ~ r * (pi / n)^2 / 2 from the circle.
+	// Take the coarsest level which keeps that under MAX_PIXEL_ERROR.
+	const float pixelRadius = radius * pixelsPerUnit;
+	const float segmentCount = PI * sqrtf(0.5f * pixelRadius / MAX_PIXEL_ERROR);
+
+	int level = 0;
+	while (level + 1 < LOD_LEVEL_COUNT && (MIN_CIRCLE_SEGMENT_COUNT << level) < segmentCount) {
+		++level;
+	}
+	return unitCircles[level];
+}
+
+bool CellRenderer::isVisible(const Vector &center, float radius) const {
+	return viewMinimum.x <= center.x + radius && center.x - radius <= viewMaximum.x
+		&& viewMinimum.y <= center.y + radius && center.y - radius <= viewMaximum.y;
+}
+
+void CellRenderer::addCell(const Vector &center, float radius, const unsigned char color[4]) {
+	if (radius * pixelsPerUnit < MIN_CIRCLE_PIXEL_RADIUS) {
+		Vertex point = { center.x, center.y, { color[0], color[1], color[2], color[3] } };
+		points.push_back(point);
+	} else {
+		addCircle(center, radius, color);
+	}
+}
+
+void CellRenderer::addCircle(const Vector &center, float radius, const unsigned char color[4]) {
+	const vector<Vector> &unitCircle = getUnitCircle(radius);
+
+	// A fan around the center, as separate triangles so all circles share one draw call.
+	const unsigned int centerIndex = static_cast<unsigned int>(vertices.size());
+	const unsigned int segmentCount = static_cast<unsigned int>(unitCircle.size());
+
+	Vertex vertex = { center.x, center.y, { color[0], color[1], color[2], color[3] } };
+	vertices.push_back(vertex);
+
+	for (unsigned int segment = 0; segment < segmentCount; ++segment) {
+		vertex.x = center.x + radius * unitCircle[segment].x;
+		vertex.y = center.y + radius * unitCircle[segment].y;
+		vertices.push_back(vertex);
+
+		indices.push_back(centerIndex);
+		indices.push_back(centerIndex + 1 + segment);
+		indices.push_back(centerIndex + 1 + (segment + 1) % segmentCount);
+	}
+}
@@ -0,0 +1,83 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vector2d.h"
+
+namespace chaos {
+namespace cell {
+
+class Cell;
+class CellGrid;
+
+////////////////////////////////////////////////////////////
+// CellRenderer declaration
+
+// Draws the arena and the cells with vertex arrays. Each frame every cell is placed
+// from a cached unit circle into one interleaved vertex array, which is drawn with a
+// single call. Only OpenGL 1.1 is needed, so software implementations like Mesa work too.
+// The detail of a circle follows its size on the screen, cells smaller than a pixel are points.
+// A camera zooms into a part of the arena, only the cells in view are placed.
+class CellRenderer {
+
+public:
+	CellRenderer();
+	~CellRenderer();
+
+	// Called when the window is resized. The arena [-1, 1] fits the smaller dimension.
+	void setViewport(int width, int height);
+
+	// Shows the square around center with a half size of 1 / zoom. Called every frame before drawing.
+	void setCamera(const Vector &center, float zoom);
+
+	// Draws the outline of the arena.
+	void drawArena(const Vector &center, float radius);
+
+	// Draws the live cells in view, the player's cell on top of them. The grid is built over the cells.
+	void drawCells(const std::vector<Cell> &cells, const CellGrid &grid, const Cell &playerCell);
+
+private:
+	CellRenderer(const CellRenderer &);
+	CellRenderer& operator=(const CellRenderer &);
+
+	struct Vertex {
+		float x;
+		float y;
+		unsigned char color[4];
+	};
+
+	// The unit circles of the levels of detail, twice the segments of the previous level each.
+	static const int LOD_LEVEL_COUNT = 5;
+	std::vector<Vector> unitCircles[LOD_LEVEL_COUNT];
+
+	float viewportPixelsPerUnit;
+	float pixelsPerUnit;
+
+	// The visible part of the arena.
+	Vector viewMinimum;
+	Vector viewMaximum;
+
+	// Rebuilt every frame, the capacity is kept.
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Vertex> points;
+	std::vector<int> visibleCells;
+
+	bool isVisible(const Vector &center, float radius) const;
+
+	const std::vector<Vector>& getUnitCircle(float radius) const;
+
+	void addCircle(const Vector &center, float radius, const unsigned char color[4]);
+	void addCell(const Vector &center, float radius, const unsigned char color[4]);
+};
+
+}; // namespace cell
+}; // namespace chaos
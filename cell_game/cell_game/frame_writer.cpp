@@ -0,0 +1,169 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include <cctype>
+#include <cstring>
+
+#include "frame_writer.h"
+
+using namespace std;
+using namespace chaos::cell;
+
+// Returns true if path ends with extension, ignoring the case.
+static bool hasExtension(const char *path, const char *extension) {
+	size_t pathLength = strlen(path);
+	size_t extensionLength = strlen(extension);
+	if (pathLength < extensionLength) {
+		return false;
+	}
+
+	const char *pathExtension = path + pathLength - extensionLength;
+	for (size_t i = 0; i < extensionLength; ++i) {
+		if (tolower(static_cast<unsigned char>(pathExtension[i])) != extension[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// BT.601 full range, what the 'C420jpeg' of the Y4M header means.
+inline unsigned char toLuma(int red, int green, int blue) {
+	return static_cast<unsigned char>((77 * red + 150 * green + 29 * blue + 128) >> 8);
+}
+
+// The chroma of pure blue and pure red rounds up to 256.
+inline unsigned char clampToByte(int value) {
+	return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+inline unsigned char toBlueChroma(int red, int green, int blue) {
+	return clampToByte(((-43 * red - 85 * green + 128 * blue + 128) >> 8) + 128);
+}
+
+inline unsigned char toRedChroma(int red, int green, int blue) {
+	return clampToByte(((128 * red - 107 * green - 21 * blue + 128) >> 8) + 128);
+}
+
+////////////////////////////////////////////////////////////
+// FrameWriter implementation
+
+FrameWriter::FrameWriter()
+	: file(NULL)
+	, format(RAW)
+	, width(0)
+	, height(0) {
+}
+
+FrameWriter::~FrameWriter() {
+	close();
+}
+
+bool FrameWriter::open(const char *path, int frameWidth, int frameHeight, int framesPerSecondNumerator, int framesPerSecondDenominator) {
+	close();
+
+	if (hasExtension(path, ".y4m")) {
+		format = Y4M;
+	} else if (hasExtension(path, ".ppm")) {
+		format = PPM;
+	} else {
+		format = RAW;
+	}
+
+	// The chroma planes of 4:2:0 cover two by two pixels.
+	if (frameWidth <= 0 || frameHeight <= 0 || (format == Y4M && (frameWidth % 2 != 0 || frameHeight % 2 != 0))) {
+		return false;
+	}
+
+	file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+
+	width = frameWidth;
+	height = frameHeight;
+
+	if (format == Y4M) {
+		fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", width, height, framesPerSecondNumerator, framesPerSecondDenominator);
+	}
+
+	return true;
+}
+
+void FrameWriter::close() {
+	if (file) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+bool FrameWriter::write(const unsigned int *pixels) {
+	if (!file || !pixels) {
+		return false;
+	}
+
+	const unsigned char *rgba = reinterpret_cast<const unsigned char*>(pixels);
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+
+	switch (format) {
+		case RAW: {
+			return fwrite(rgba, 4, pixelCount, file) == pixelCount;
+		}
+		case PPM: {
+			convertToRGB(rgba);
+			fprintf(file, "P6\n%d %d\n255\n", width, height);
+			return fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+		}
+		case Y4M: {
+			convertToYUV420(rgba);
+			fputs("FRAME\n", file);
+			return fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+		}
+	}
+
+	return false;
+}
+
+void FrameWriter::convertToRGB(const unsigned char *rgba) {
+	buffer.resize(static_cast<size_t>(width) * height * 3);
+
+	unsigned char *rgb = &buffer[0];
+	for (int i = width * height; 0 < i; --i, rgba += 4, rgb += 3) {
+		rgb[0] = rgba[0];
+		rgb[1] = rgba[1];
+		rgb[2] = rgba[2];
+	}
+}
+
+void FrameWriter::convertToYUV420(const unsigned char *rgba) {
+	const int chromaWidth = width / 2;
+	const int chromaHeight = height / 2;
+	buffer.resize(static_cast<size_t>(width) * height + 2 * chromaWidth * chromaHeight);
+
+	unsigned char *luma = &buffer[0];
+	unsigned char *blueChroma = luma + width * height;
+	unsigned char *redChroma = blueChroma + chromaWidth * chromaHeight;
+
+	for (int i = 0; i < width * height; ++i) {
+		luma[i] = toLuma(rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2]);
+	}
+
+	// Each chroma sample is taken from the average of its two by two pixels.
+	for (int y = 0; y < chromaHeight; ++y) {
+		for (int x = 0; x < chromaWidth; ++x) {
+			const unsigned char *topLeft = rgba + 4 * (2 * y * width + 2 * x);
+			const unsigned char *bottomLeft = topLeft + 4 * width;
+
+			int red = (topLeft[0] + topLeft[4] + bottomLeft[0] + bottomLeft[4] + 2) >> 2;
+			int green = (topLeft[1] + topLeft[5] + bottomLeft[1] + bottomLeft[5] + 2) >> 2;
+			int blue = (topLeft[2] + topLeft[6] + bottomLeft[2] + bottomLeft[6] + 2) >> 2;
+
+			blueChroma[y * chromaWidth + x] = toBlueChroma(red, green, blue);
+			redChroma[y * chromaWidth + x] = toRedChroma(red, green, blue);
+		}
+	}
+}
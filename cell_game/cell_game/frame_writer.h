@@ -0,0 +1,61 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+namespace chaos {
+namespace cell {
+
+////////////////////////////////////////////////////////////
+// FrameWriter declaration
+
+// Streams RGBA frames into a file for encoding later. The format follows the extension:
+//  .y4m - YUV4MPEG2 with 4:2:0 chroma, what ffmpeg and x264 read directly;
+//  .ppm - one binary PPM image after the other, for ffmpeg's image2pipe;
+//  anything else - the raw RGBA bytes of each frame.
+class FrameWriter {
+
+public:
+	FrameWriter();
+	~FrameWriter();
+
+	// Starts a new file. The frame rate is framesPerSecondNumerator / framesPerSecondDenominator, only Y4M keeps it.
+	// Returns false if the file cannot be created or the size does not suit the format.
+	bool open(const char *path, int frameWidth, int frameHeight, int framesPerSecondNumerator, int framesPerSecondDenominator);
+	void close();
+
+	// Appends a frame of width x height pixels, R, G, B, A bytes each, from the top row down.
+	bool write(const unsigned int *pixels);
+
+private:
+	FrameWriter(const FrameWriter &);
+	FrameWriter& operator=(const FrameWriter &);
+
+	enum Format {
+		RAW,
+		PPM,
+		Y4M
+	};
+
+	FILE *file;
+	Format format;
+	int width;
+	int height;
+
+	// The converted frame, kept between frames.
+	std::vector<unsigned char> buffer;
+
+	void convertToRGB(const unsigned char *rgba);
+	void convertToYUV420(const unsigned char *rgba);
+};
+
+}; // namespace cell
+}; // namespace chaos
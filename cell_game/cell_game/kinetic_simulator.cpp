@@ -0,0 +1,241 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include "cell.h"
+#include "settings.h"
+#include "kinetic_simulator.h"
+#include "math_utils.h"
+
+using namespace std;
+using namespace chaos::cell;
+
+////////////////////////////////////////////////////////////
+// KineticSimulator implementation
+
+KineticSimulator::KineticSimulator(const Settings &gameSettings)
+	: Simulator(gameSettings)
+	, windowTime(0.0f)
+	, windowLength(0.0f)
+	, windowMaxSpeed(0.0f)
+	, windowMaxRadius(0.0f) {
+}
+
+void KineticSimulator::populate() {
+	Simulator::populate();
+
+	bodies = cells;
+	bodyTimes.assign(bodies.size(), 0.0f);
+	bodyVersions.assign(bodies.size(), 0);
+	events = priority_queue<Contact>();
+
+	// The first tick starts a window.
+	windowTime = 0.0f;
+	windowLength = 0.0f;
+
+	publishCells();
+}
+
+void KineticSimulator::setPlayerAI(const ICellAI *cellAI) {
+	Simulator::setPlayerAI(cellAI);
+
+	if (PLAYER_BODY < (int)bodies.size()) {
+		bodies[PLAYER_BODY].ai = cellAI;
+	}
+}
+
+void KineticSimulator::simulateNextTick() {
+	// 1. Finish simulation if player died.
+	if (bodies[PLAYER_BODY].isDead()) {
+		finish(PLAYER_LOST, false);
+		return;
+	}
+
+	// 2. Finish simulation if player won.
+	if (liveCellsCount == 1) {
+		finish(PLAYER_WON, false);
+		return;
+	}
+
+	// 3. Fast-forward: finish simulation as soon as the outcome cannot change.
+	if (settings.fastForward && isGameDecided()) {
+		return;
+	}
+
+	// 4. Predict the events of the coming ticks once the last prediction runs out.
+	if (windowLength < windowTime + settings.tickLength) {
+		startWindow();
+	}
+
+	// 5. Let player cell figure out where to go. It goes on another way from now.
+	steerPlayerCell();
+
+	// 6. Take the events of the tick in time order, then show the cells where they are at its end.
+	takeEvents(windowTime + settings.tickLength);
+	windowTime += settings.tickLength;
+	publishCells();
+}
+
+void KineticSimulator::startWindow() {
+	// 1. Bring every body to now, the times start over.
+	for (int body = 0; body < (int)bodies.size(); ++body) {
+		moveCell(bodies[body], windowTime - bodyTimes[body]);
+		bodyTimes[body] = 0.0f;
+	}
+	windowTime = 0.0f;
+	windowLength = chaos::cell::max(1, settings.kineticWindow) * settings.tickLength;
+	events = priority_queue<Contact>();
+
+	// 2. A bite only mixes velocities and the AI speeds the player's cell up by at most a tick length in a tick.
+	windowMaxSpeed = 0.0f;
+	for (vector<Cell>::const_iterator body = bodies.begin(); body != bodies.end(); ++body) {
+		if (!body->isDead()) {
+			windowMaxSpeed = chaos::cell::max(windowMaxSpeed, body->velocity.length());
+		}
+	}
+	windowMaxSpeed += windowLength;
+
+	// 3. The first events of each body and pair.
+	broadphase.build(bodies, (int)bodies.size(), settings.arenaCenter, settings.arenaRadius);
+	windowMaxRadius = broadphase.getMaxRadius();
+	for (int body = 0; body < (int)bodies.size(); ++body) {
+		predictEvents(body, true, -1);
+	}
+}
+
+void KineticSimulator::steerPlayerCell() {
+	Cell &playerCell = cells[playerCellIndex];
+	if (!playerCell.ai) {
+		return;
+	}
+
+	accelerateCell(playerCell);
+
+	moveBody(PLAYER_BODY, windowTime);
+	bodies[PLAYER_BODY].velocity = playerCell.velocity;
+	++bodyVersions[PLAYER_BODY];
+	predictEvents(PLAYER_BODY, false, -1);
+}
+
+void KineticSimulator::takeEvents(float endTime) {
+	while (!events.empty() && events.top().time <= endTime) {
+		Contact event = events.top();
+		events.pop();
+
+		if (event.lhsVersion != bodyVersions[event.lhs] || (0 <= event.rhs && event.rhsVersion != bodyVersions[event.rhs])) {
+			continue;
+		}
+
+		Cell &lhs = bodies[event.lhs];
+		if (lhs.isDead()) {
+			continue;
+		}
+
+		moveBody(event.lhs, event.time);
+		++bodyVersions[event.lhs];
+
+		if (event.rhs < 0) {
+			bounceBody(lhs);
+			predictEvents(event.lhs, false, -1);
+			continue;
+		}
+
+		Cell &rhs = bodies[event.rhs];
+		moveBody(event.rhs, event.time);
+		++bodyVersions[event.rhs];
+
+		collideCells(lhs, rhs);
+		windowMaxRadius = chaos::cell::max(windowMaxRadius, chaos::cell::max(lhs.radius, rhs.radius));
+
+		// Incident after the bite or passing without one, the two don't meet again on their new ways.
+		predictEvents(event.lhs, false, event.rhs);
+		predictEvents(event.rhs, false, event.lhs);
+	}
+}
+
+void KineticSimulator::publishCells() {
+	// The player's cell first, even dead, then the live cells.
+	cells.clear();
+	for (int body = 0; body < (int)bodies.size(); ++body) {
+		if (body == PLAYER_BODY || !bodies[body].isDead()) {
+			cells.push_back(bodies[body]);
+			moveCell(cells.back(), windowTime - bodyTimes[body]);
+		}
+	}
+
+	playerCellIndex = 0;
+	liveCellsCount = (int)cells.size();
+
+	if (!cells[playerCellIndex].isDead()) {
+		sortCells();
+	}
+}
+
+void KineticSimulator::predictEvents(int body, bool onlyLaterBodies, int excludedBody) {
+	const Cell &cell = bodies[body];
+	if (cell.isDead()) {
+		return;
+	}
+
+	const float bodyTime = bodyTimes[body];
+
+	// 1. The bounce off the wall.
+	const float wallTime = bodyTime + getWallTime(cell, settings.arenaCenter, settings.arenaRadius);
+	if (wallTime <= windowLength) {
+		Contact bounce = { wallTime, body, -1, bodyVersions[body], 0 };
+		events.push(bounce);
+	}
+
+	// 2. The bites. The grid holds the bodies where the window started, they have moved at most
+	//    windowMaxSpeed * windowLength since and the radii may have grown past the grid's largest.
+	Vector destination = cell.position + (windowLength - bodyTime) * cell.velocity;
+	float reach = cell.radius + windowMaxSpeed * windowLength + windowMaxRadius - broadphase.getMaxRadius();
+	Vector minimum(chaos::cell::min(cell.position.x, destination.x) - reach, chaos::cell::min(cell.position.y, destination.y) - reach);
+	Vector maximum(chaos::cell::max(cell.position.x, destination.x) + reach, chaos::cell::max(cell.position.y, destination.y) + reach);
+
+	neighbours.clear();
+	broadphase.query(minimum, maximum, neighbours);
+
+	for (vector<int>::const_iterator neighbour = neighbours.begin(); neighbour != neighbours.end(); ++neighbour) {
+		if (*neighbour == body || *neighbour == excludedBody || (onlyLaterBodies && *neighbour < body) || bodies[*neighbour].isDead()) {
+			continue;
+		}
+
+		// Compare the two bodies at the same time.
+		const float startTime = chaos::cell::max(bodyTime, bodyTimes[*neighbour]);
+		Cell lhs = cell;
+		Cell rhs = bodies[*neighbour];
+		moveCell(lhs, startTime - bodyTime);
+		moveCell(rhs, startTime - bodyTimes[*neighbour]);
+
+		float time = getBiteTime(lhs, rhs, windowLength - startTime);
+		if (0.0f <= time) {
+			Contact bite = { startTime + time, body, *neighbour, bodyVersions[body], bodyVersions[*neighbour] };
+			events.push(bite);
+		}
+	}
+}
+
+void KineticSimulator::moveBody(int body, float time) {
+	moveCell(bodies[body], time - bodyTimes[body]);
+	bodyTimes[body] = time;
+}
+
+void KineticSimulator::bounceBody(Cell &body) {
+	// Find the unit vector pointing away from the arena at the point of collision.
+	Vector normal = body.position - settings.arenaCenter;
+	normal.normalize();
+
+	// Keep it just inside, a body which has grown into the wall is pushed back.
+	body.position = settings.arenaCenter + (settings.arenaRadius - body.radius - EPSILON) * normal;
+
+	// Reflect the velocity if it still points out.
+	float outwardSpeed = dot(normal, body.velocity);
+	if (0.0f < outwardSpeed) {
+		body.velocity -= 2.0f * outwardSpeed * normal;
+	}
+}
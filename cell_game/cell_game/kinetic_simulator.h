@@ -0,0 +1,67 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <queue>
+#include <vector>
+
+#include "simulator.h"
+
+namespace chaos {
+namespace cell {
+
+////////////////////////////////////////////////////////////
+// KineticSimulator declaration
+
+// Plays the same game as Simulator, but the cells move straight from one event to the next: a bite or
+// a bounce off the wall, taken at the exact time it happens. The events of settings.kineticWindow ticks
+// are predicted at once and only the ones of the cells an event changes are predicted again. The ticks
+// remain for the player's AI, the cells are brought to the time of each tick for it to look at them.
+class KineticSimulator : public Simulator {
+
+public:
+	KineticSimulator(const Settings &gameSettings);
+
+	virtual void populate();
+	virtual void setPlayerAI(const ICellAI *cellAI);
+
+	virtual void simulateNextTick();
+
+private:
+	// The player's cell is the first body.
+	static const int PLAYER_BODY = 0;
+
+	// The cells in the order they were created. Each is where it was at its own time, it moves straight on from there.
+	// Simulator::cells holds them as they are at the current tick, sorted for the AI.
+	std::vector<Cell> bodies;
+	std::vector<float> bodyTimes;
+	std::vector<int> bodyVersions; // Changed by every event, the older predictions of the body are dropped.
+
+	// The bites, and the bounces with Contact::rhs -1, in time order.
+	std::priority_queue<Contact> events;
+
+	// The times count from the start of the window, for which the events are predicted.
+	float windowTime; // The current tick.
+	float windowLength;
+	float windowMaxSpeed; // No cell gets faster within the window.
+	float windowMaxRadius;
+	std::vector<int> neighbours;
+
+	void startWindow();
+	void steerPlayerCell();
+	void takeEvents(float endTime);
+	void publishCells();
+
+	void predictEvents(int body, bool onlyLaterBodies, int excludedBody);
+	void moveBody(int body, float time);
+	void bounceBody(Cell &body);
+};
+
+}; // namespace cell
+}; // namespace chaos
@@ -9,10 +9,19 @@
 // Project headers
 #include "cell.h"
 #include "cell_ai.h"
+#include "cell_renderer.h"
+#include "frame_writer.h"
+#include "kinetic_simulator.h"
 #include "settings.h"
 #include "simulator.h"
+#include "simulation_thread.h"
+#include "software_renderer.h"
 #include "math_utils.h"
 
+// Standard headers
+#include <chrono>
+#include <thread>
+
 // GLUT - include last because of a redefinition problem
 #include "glut.h"
 
@@ -20,66 +29,41 @@ using namespace std;
 using namespace chaos::cell;
 
 Settings settings;
-Simulator simulator(settings);
-
-inline int getCircleSegmentCount(float radius) {
-	static const float MAX_LINE_LENGTH = 0.001f;
-	return clamp(DOUBLE_PI * radius / MAX_LINE_LENGTH, 8.0f, 128.0f);
-}
-
-void drawCircle(const Vector &center, float radius, bool fillCircle) {
-	int circleSegmentCount = getCircleSegmentCount(radius);
-
-	float stepAngleRadian = DOUBLE_PI / circleSegmentCount;
-	float stepCos = cosf(stepAngleRadian);
-	float stepSin = sinf(stepAngleRadian);
-
-	float x = radius;
-	float y = 0.0f;
-
-	glBegin(fillCircle ? GL_TRIANGLE_FAN : GL_LINE_LOOP);
-	while (0 < circleSegmentCount) {
-		glVertex2f(center.x + x, center.y + y);
-
-		float rotatedX = stepCos * x - stepSin * y;
-		float rotatedY = stepSin * x + stepCos * y;
-		x = rotatedX;
-		y = rotatedY;
-
-		--circleSegmentCount;
-	}
-	glEnd();
-}
+Simulator tickSimulator(settings);
+KineticSimulator kineticSimulator(settings);
+Simulator *simulator = &tickSimulator; // Picked by selectSimulator() once the settings are loaded.
+SimulationThread simulationThread(settings);
+CellRenderer renderer;
+
+// The camera, at zoom 1 it shows the square [-1, 1].
+const float MIN_CAMERA_ZOOM = 0.25f;
+const float MAX_CAMERA_ZOOM = 4096.0f;
+const float CAMERA_ZOOM_STEP = 1.25f;
+const float CAMERA_PAN_STEP = 0.1f; // Of the visible size.
+
+Vector cameraCenter;
+float cameraZoom = 1.0f;
+bool cameraFollowsPlayer = false;
 
 void display() {
 	// Clear buffer
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	// Draw arena
-	glColor3f(1.0f, 1.0f, 1.0f);
-	glLineWidth(2.0f);
-	drawCircle(settings.arenaCenter, settings.arenaRadius, false);
-
-	// Get simulator data
-	int liveCellCount = 1;
-	const Cell &smartCell = simulator.getPlayerCell();
-	const vector<Cell> &cells = simulator.getCells(liveCellCount);
-
-	// Draw cells
-	vector<Cell>::const_iterator liveCellsEnd = cells.begin() + liveCellCount;
-	for (vector<Cell>::const_iterator cellIterator = cells.begin(); cellIterator != liveCellsEnd; ++cellIterator) {
-		if (cellIterator->radius < smartCell.radius) {
-			glColor3f(0.0f, 1.0f, 0.0f);
-		} else {
-			glColor3f(1.0f, 0.0f, 0.0f);
-		}
-		drawCircle(cellIterator->position, cellIterator->radius, true);
+	// Get the latest frame of the simulation
+	const SimulationFrame &frame = simulationThread.getFrame();
+
+	// Aim the camera
+	if (cameraFollowsPlayer) {
+		cameraCenter = frame.playerCell.position;
 	}
+	renderer.setCamera(cameraCenter, cameraZoom);
+
+	// Draw arena
+	renderer.drawArena(settings.arenaCenter, settings.arenaRadius);
 
-	// Draw smart cell
-	glColor3f(0.0f, 0.0f, 1.0f);
-	drawCircle(smartCell.position, smartCell.radius, true);
+	// Draw the cells in view, the smart cell last
+	renderer.drawCells(frame.cells, frame.grid, frame.playerCell);
 
 	// Swap buffers
 	glutSwapBuffers();
@@ -88,26 +72,31 @@ void display() {
 void reshape(int width, int height) {
 	int minDimension = chaos::cell::min(width, height);
 	glViewport((width - minDimension) / 2, (height - minDimension) / 2, minDimension, minDimension);
+	renderer.setViewport(width, height);
 }
 
 void idle() {
 	static int simulatedTicks = 0;
 	static int referenceTime = 0;
 
-	const Simulator::State &simulatorState = simulator.getState();
-	if (simulatorState == Simulator::READY) {
-		simulator.simulateNextTick();
+	// The simulation runs on its own thread, only draw what it has published.
+	if (simulationThread.updateFrame()) {
+		if (simulationThread.getFrame().state == Simulator::FINISHED && settings.exitOnSimulationFinished) {
+			exit(0);
+		}
 		glutPostRedisplay();
-	} else if (simulatorState == Simulator::FINISHED && settings.exitOnSimulationFinished) {
-		exit(0);
+	} else {
+		// Nothing new to draw, leave the processor to the simulation.
+		this_thread::sleep_for(chrono::milliseconds(1));
 	}
 
-	++simulatedTicks;
-	int elapsedTime = glutGet(GLUT_ELAPSED_TIME) - referenceTime;
+	simulatedTicks += simulationThread.takeTickCount();
+	int currentTime = glutGet(GLUT_ELAPSED_TIME);
+	int elapsedTime = currentTime - referenceTime;
 
-	if (elapsedTime - referenceTime > 1000) {
-		printf("Simulation steps per second: %f\n", (1000.0f * simulatedTicks) / (elapsedTime - referenceTime));	
-		referenceTime = elapsedTime;
+	if (elapsedTime > 1000) {
+		printf("Simulation steps per second: %f\n", (1000.0f * simulatedTicks) / elapsedTime);	
+		referenceTime = currentTime;
 		simulatedTicks = 0;
 	}
 }
@@ -116,6 +105,17 @@ void keyboardNormal(unsigned char key, int x, int y) {
 	static const unsigned char KEYBOARD_ESCAPE_KEY = 27;
 	static const unsigned char KEYBOARD_SPACE_KEY = ' ';
 	static const unsigned char KEYBOARD_R_KEY = 'r';
+	static const unsigned char KEYBOARD_F_KEY = 'f';
+	static const unsigned char KEYBOARD_W_KEY = 'w';
+	static const unsigned char KEYBOARD_A_KEY = 'a';
+	static const unsigned char KEYBOARD_S_KEY = 's';
+	static const unsigned char KEYBOARD_D_KEY = 'd';
+	static const unsigned char KEYBOARD_PLUS_KEY = '+';
+	static const unsigned char KEYBOARD_EQUALS_KEY = '=';
+	static const unsigned char KEYBOARD_MINUS_KEY = '-';
+	static const unsigned char KEYBOARD_0_KEY = '0';
+
+	const float panStep = CAMERA_PAN_STEP * 2.0f / cameraZoom;
 
 	switch (key) {
 		case KEYBOARD_ESCAPE_KEY: {
@@ -123,41 +123,197 @@ void keyboardNormal(unsigned char key, int x, int y) {
 			break;
 		}
 		case KEYBOARD_SPACE_KEY: {
-			simulator.toggleSimulationPause();
+			simulationThread.togglePause();
 			break;
 		}
 		case KEYBOARD_R_KEY: {
-			const ICellAI *playerAI = simulator.getPlayerCell().ai;
-			CustomAI *customAI = const_cast<CustomAI*>(static_cast<const CustomAI*>(playerAI));
-			if (customAI) {
-				customAI->reload();
-			}
+			simulationThread.reloadPlayerAI();
+			break;
+		}
+		case KEYBOARD_F_KEY: {
+			cameraFollowsPlayer = !cameraFollowsPlayer;
+			break;
+		}
+		case KEYBOARD_W_KEY: {
+			cameraFollowsPlayer = false;
+			cameraCenter.y += panStep;
+			break;
+		}
+		case KEYBOARD_A_KEY: {
+			cameraFollowsPlayer = false;
+			cameraCenter.x -= panStep;
+			break;
+		}
+		case KEYBOARD_S_KEY: {
+			cameraFollowsPlayer = false;
+			cameraCenter.y -= panStep;
+			break;
+		}
+		case KEYBOARD_D_KEY: {
+			cameraFollowsPlayer = false;
+			cameraCenter.x += panStep;
+			break;
+		}
+		case KEYBOARD_PLUS_KEY:
+		case KEYBOARD_EQUALS_KEY: {
+			cameraZoom = chaos::cell::min(cameraZoom * CAMERA_ZOOM_STEP, MAX_CAMERA_ZOOM);
+			break;
+		}
+		case KEYBOARD_MINUS_KEY: {
+			cameraZoom = chaos::cell::max(cameraZoom / CAMERA_ZOOM_STEP, MIN_CAMERA_ZOOM);
+			break;
+		}
+		case KEYBOARD_0_KEY: {
+			cameraFollowsPlayer = false;
+			cameraCenter = Vector();
+			cameraZoom = 1.0f;
 			break;
 		}
 	}
+
+	// The camera may have moved while the simulation is paused.
+	glutPostRedisplay();
 }
 
 void keyboardSpecial(int key, int x, int y) {
 	switch (key) {
 		case GLUT_KEY_UP: {
-			settings.tickLength += 0.001f;
+			simulationThread.changeTickLength(0.001f);
 			break;
 		}
 		case GLUT_KEY_RIGHT: {
-			if (simulator.getState() == Simulator::PAUSED) {
-				simulator.simulateNextTick();
-				glutPostRedisplay();
-			}
+			simulationThread.stepPaused();
 			break;
 		}
 		case GLUT_KEY_DOWN: {
-			settings.tickLength -= 0.001f;
+			simulationThread.changeTickLength(-0.001f);
+			break;
+		}
+	}
+}
+
+void selectSimulator() {
+	if (settings.kineticSimulation) {
+		simulator = &kineticSimulator;
+	} else {
+		simulator = &tickSimulator;
+	}
+}
+
+// Loads the player's script, JIT compiled, interpreted or compiled ahead of time, and hands it to the simulator.
+ICellAI* loadPlayerAI() {
+	ICellAI *playerAI = NULL;
+	if (NativeAI::isLibraryPath(settings.playerScriptPath)) {
+		// Compiled ahead of time by cell_compiler, there is nothing left to compile.
+		playerAI = new NativeAI(settings.playerScriptPath);
+	} else if (settings.scriptInterpreter) {
+		playerAI = new InterpretedAI(settings.playerScriptPath);
+	} else {
+		CodeGenOptions codeGenOptions;
+		codeGenOptions.fastMath = settings.scriptFastMath != 0;
+		codeGenOptions.fuseMultiplyAdd = settings.scriptFuseMultiplyAdd != 0;
+		codeGenOptions.targetHostCPU = settings.scriptTargetHostCPU != 0;
+		playerAI = new CustomAI(settings.baseModulePath, settings.playerScriptPath, "custom_cell_ai_", settings.tieredCompilation != 0, codeGenOptions);
+	}
+	playerAI->prepare();
+	simulator->setPlayerAI(playerAI);
+	return playerAI;
+}
+
+void printOutcome(int tick) {
+	static const char *OUTCOME_NAMES[] = { "undecided", "won", "lost" };
+
+	int liveCellCount = 0;
+	simulator->getCells(liveCellCount);
+
+	printf("Player %s%s after %d ticks, %d cells left\n", OUTCOME_NAMES[simulator->getOutcome()], simulator->isOutcomeProjected() ? " (projected)" : "", tick, liveCellCount);
+}
+
+// Plays the game without a window as fast as possible and prints how it ended.
+int evaluateGame() {
+	// Decided games end early.
+	settings.fastForward = 1;
+
+	simulator->populate();
+	ICellAI *playerAI = loadPlayerAI();
+
+	typedef chrono::steady_clock Clock;
+	Clock::time_point startTime = Clock::now();
+
+	int tick = 0;
+	while (simulator->getState() == Simulator::READY && (settings.exportTickLimit <= 0 || tick < settings.exportTickLimit)) {
+		simulator->simulateNextTick();
+		++tick;
+	}
+
+	// How fast the simulator is, to compare them on the same levels.
+	const double seconds = chrono::duration<double>(Clock::now() - startTime).count();
+	printOutcome(tick);
+	printf("%s simulator: %.3f s, %.0f ticks per second\n", settings.kineticSimulation ? "Kinetic" : "Tick", seconds, 0.0 < seconds ? tick / seconds : 0.0);
+
+	delete playerAI;
+	return 0;
+}
+
+// Plays the game without a window and streams every rendered frame into framesPath.
+int exportGame(const char *framesPath) {
+	// Y4M needs an even frame size.
+	SoftwareRenderer softwareRenderer(settings.displayResolution & ~1);
+	const int frameSize = softwareRenderer.getSize();
+
+	// Played back at the frame rate of the simulated time.
+	const int renderEveryNthTick = chaos::cell::max(1, settings.renderEveryNthTick);
+	const int microsecondsPerFrame = chaos::cell::max(1, static_cast<int>(1000000.0f * settings.tickLength * renderEveryNthTick + 0.5f));
+
+	FrameWriter frameWriter;
+	if (!frameWriter.open(framesPath, frameSize, frameSize, 1000000, microsecondsPerFrame)) {
+		printf("Cannot export the frames to %s\n", framesPath);
+		return 1;
+	}
+
+	simulator->populate();
+	ICellAI *playerAI = loadPlayerAI();
+
+	int tick = 0;
+	int frameCount = 0;
+	for (;;) {
+		if (tick % renderEveryNthTick == 0 || simulator->getState() != Simulator::READY) {
+			int liveCellCount = 0;
+			const vector<Cell> &cells = simulator->getCells(liveCellCount);
+			softwareRenderer.render(cells, liveCellCount, simulator->getPlayerCell(), settings.arenaCenter, settings.arenaRadius);
+			if (!frameWriter.write(softwareRenderer.getPixels())) {
+				printf("Cannot write frame %d to %s\n", frameCount, framesPath);
+				break;
+			}
+			++frameCount;
+		}
+
+		if (simulator->getState() != Simulator::READY || (0 < settings.exportTickLimit && settings.exportTickLimit <= tick)) {
 			break;
 		}
+
+		simulator->simulateNextTick();
+		++tick;
 	}
+
+	printf("Exported %d frames of %d ticks to %s\n", frameCount, tick, framesPath);
+	printOutcome(tick);
+
+	frameWriter.close();
+	delete playerAI;
+	return 0;
 }
 
 int main(int argc, char **argv) {
+	// Play a game without a display: script, level seed and the file for the frames, or - for none
+	if (argc == 4) {
+		settings.load();
+		strncpy(settings.playerScriptPath, argv[1], sizeof(settings.playerScriptPath));
+		settings.levelSeed = atoi(argv[2]);
+		selectSimulator();
+		return strcmp(argv[3], "-") == 0 ? evaluateGame() : exportGame(argv[3]);
+	}
+
 	// Initialize GLUT
 	glutInit(&argc, argv);
 
@@ -194,12 +350,14 @@ int main(int argc, char **argv) {
 	}
 
 	// Populate the level for the simulation
-	simulator.populate();
+	selectSimulator();
+	simulator->populate();
+
+	// Load the custom AI: JIT compiled, interpreted, or the native library compiled ahead of time
+	loadPlayerAI();
 
-	// Load the custom AI
-	CustomAI customAI(settings.baseModulePath, settings.playerScriptPath, "custom_cell_ai_");
-	customAI.prepare();
-	simulator.setPlayerAI(&customAI);
+	// From now on the simulator belongs to its thread
+	simulationThread.start(*simulator);
 	
 	// Enter GLUT's event processing cycle
 	glutMainLoop();
@@ -41,8 +41,26 @@ public:
 	int displayResolution;
 	int exitOnSimulationFinished;
 	char baseModulePath[MAX_PATH];
+	int tieredCompilation;
+	int scriptInterpreter;
+	int scriptFastMath;
+	int scriptFuseMultiplyAdd;
+	int scriptTargetHostCPU;
+	int maxTicksPerSecond; // 0 for as many as the processor can do.
+	int renderEveryNthTick;
+	int exportTickLimit; // Headless games stop after this many ticks, 0 to play until the game ends.
 	char settingsFilePath[MAX_PATH];
 
+	// Simulation parameters read after the system ones, the settings file lists them last.
+	float physicsStepLength; // The ticks are simulated in steps of this length, 0 for one step per tick.
+	float substepTravel; // A cell moves at most this part of the smallest radius in a substep, 0 for no substeps.
+	int maxSubstepCount; // Faster cells are swept instead.
+	int continuousCollision; // Bites are taken in the order they happen within a step.
+	int fastForward; // Ends decided games early and skips the cells which cannot collide.
+	int fastForwardHorizon; // Ticks between the searches for such cells.
+	int kineticSimulation; // Moves the cells from one collision to the next instead of in ticks.
+	int kineticWindow; // Ticks the collisions are predicted for at once.
+
 	Settings() 
 		: levelSeed(0)
 		, tickLength(0.005f)
@@ -55,7 +73,23 @@ public:
 		, cellVelocityVariance(0.2f)
 		, playerCellInitialRadius(0.01f)
 		, displayResolution(640)
-		, exitOnSimulationFinished(1) {
+		, exitOnSimulationFinished(1)
+		, tieredCompilation(1)
+		, scriptInterpreter(0)
+		, scriptFastMath(0)
+		, scriptFuseMultiplyAdd(0)
+		, scriptTargetHostCPU(0)
+		, maxTicksPerSecond(0)
+		, renderEveryNthTick(1)
+		, exportTickLimit(60000)
+		, physicsStepLength(0.0f)
+		, substepTravel(0.0f)
+		, maxSubstepCount(16)
+		, continuousCollision(0)
+		, fastForward(0)
+		, fastForwardHorizon(16)
+		, kineticSimulation(0)
+		, kineticWindow(16) {
 		playerScriptPath[0] = '\0';
 		strncpy(baseModulePath, ".\\base.bc", sizeof(baseModulePath));
 		strncpy(settingsFilePath, ".\\settings.txt", sizeof(baseModulePath));
@@ -78,6 +112,22 @@ public:
 			fscanf(settingsFile, "%*s %d", &displayResolution);
 			fscanf(settingsFile, "%*s %d", &exitOnSimulationFinished);
 			fscanf(settingsFile, "%*s %256s", baseModulePath);
+			fscanf(settingsFile, "%*s %d", &tieredCompilation);
+			fscanf(settingsFile, "%*s %d", &scriptInterpreter);
+			fscanf(settingsFile, "%*s %d", &scriptFastMath);
+			fscanf(settingsFile, "%*s %d", &scriptFuseMultiplyAdd);
+			fscanf(settingsFile, "%*s %d", &scriptTargetHostCPU);
+			fscanf(settingsFile, "%*s %d", &maxTicksPerSecond);
+			fscanf(settingsFile, "%*s %d", &renderEveryNthTick);
+			fscanf(settingsFile, "%*s %d", &exportTickLimit);
+			fscanf(settingsFile, "%*s %f", &physicsStepLength);
+			fscanf(settingsFile, "%*s %f", &substepTravel);
+			fscanf(settingsFile, "%*s %d", &maxSubstepCount);
+			fscanf(settingsFile, "%*s %d", &continuousCollision);
+			fscanf(settingsFile, "%*s %d", &fastForward);
+			fscanf(settingsFile, "%*s %d", &fastForwardHorizon);
+			fscanf(settingsFile, "%*s %d", &kineticSimulation);
+			fscanf(settingsFile, "%*s %d", &kineticWindow);
 			
 			fclose(settingsFile);
 		}
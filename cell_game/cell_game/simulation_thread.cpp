@@ -0,0 +1,164 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#include <chrono>
+
+#include "cell_ai.h"
+#include "settings.h"
+#include "simulation_thread.h"
+
+using namespace std;
+using namespace chaos::cell;
+
+////////////////////////////////////////////////////////////
+// SimulationThread implementation
+
+SimulationThread::SimulationThread(Settings &gameSettings)
+	: simulator(NULL)
+	, settings(gameSettings)
+	, requests(0)
+	, tickLengthChange(0)
+	, tickCount(0)
+	, running(false)
+	, tick(0) {
+}
+
+SimulationThread::~SimulationThread() {
+	stop();
+}
+
+void SimulationThread::start(Simulator &gameSimulator) {
+	if (!running) {
+		simulator = &gameSimulator;
+
+		// The display has something to draw before the first tick.
+		publishFrame();
+
+		running = true;
+		worker = thread(&SimulationThread::run, this);
+	}
+}
+
+void SimulationThread::stop() {
+	running = false;
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void SimulationThread::togglePause() {
+	requests.fetch_or(TOGGLE_PAUSE);
+}
+
+void SimulationThread::stepPaused() {
+	requests.fetch_or(STEP_PAUSED);
+}
+
+void SimulationThread::reloadPlayerAI() {
+	requests.fetch_or(RELOAD_PLAYER_AI);
+}
+
+void SimulationThread::changeTickLength(float change) {
+	tickLengthChange.fetch_add(static_cast<int>(change * 1000000.0f + (change < 0.0f ? -0.5f : 0.5f)));
+}
+
+bool SimulationThread::updateFrame() {
+	return frames.update();
+}
+
+const SimulationFrame& SimulationThread::getFrame() const {
+	return frames.getFront();
+}
+
+int SimulationThread::takeTickCount() {
+	return tickCount.exchange(0);
+}
+
+void SimulationThread::run() {
+	typedef chrono::steady_clock Clock;
+	Clock::time_point nextTickTime = Clock::now();
+
+	while (running) {
+		// 1. Carry out the requests of the GLUT thread. They show in the next frame.
+		bool isFrameDue = handleRequests();
+
+		// 2. Simulate the next tick.
+		if (simulator->getState() == Simulator::READY) {
+			simulator->simulateNextTick();
+			++tick;
+			++tickCount;
+
+			const int renderEveryNthTick = settings.renderEveryNthTick < 1 ? 1 : settings.renderEveryNthTick;
+			isFrameDue = isFrameDue || tick % renderEveryNthTick == 0 || simulator->getState() != Simulator::READY;
+		}
+
+		// 3. Publish the frame. The display skips the ones it has no time for.
+		if (isFrameDue) {
+			publishFrame();
+		}
+
+		// 4. Keep to the tick rate. Paused or finished, only wait for requests.
+		if (simulator->getState() != Simulator::READY) {
+			this_thread::sleep_for(chrono::milliseconds(1));
+			nextTickTime = Clock::now();
+		} else if (0 < settings.maxTicksPerSecond) {
+			nextTickTime += chrono::microseconds(1000000 / settings.maxTicksPerSecond);
+
+			// Don't hurry to catch up after falling behind.
+			Clock::time_point now = Clock::now();
+			if (nextTickTime < now) {
+				nextTickTime = now;
+			} else {
+				this_thread::sleep_until(nextTickTime);
+			}
+		}
+	}
+}
+
+bool SimulationThread::handleRequests() {
+	const int pendingRequests = requests.exchange(0);
+	const int pendingTickLengthChange = tickLengthChange.exchange(0);
+
+	if (pendingTickLengthChange != 0) {
+		settings.tickLength += 0.000001f * pendingTickLengthChange;
+	}
+
+	if (pendingRequests & TOGGLE_PAUSE) {
+		simulator->toggleSimulationPause();
+	}
+
+	if ((pendingRequests & STEP_PAUSED) && simulator->getState() == Simulator::PAUSED) {
+		simulator->simulateNextTick();
+		++tick;
+		++tickCount;
+	}
+
+	if (pendingRequests & RELOAD_PLAYER_AI) {
+		// The AI only runs on this thread, so it can be compiled again between ticks.
+		ICellAI *playerAI = const_cast<ICellAI*>(simulator->getPlayerCell().ai);
+		if (playerAI) {
+			playerAI->reload();
+		}
+	}
+
+	return pendingRequests != 0;
+}
+
+void SimulationThread::publishFrame() {
+	SimulationFrame &frame = frames.getBack();
+
+	int liveCellCount = 0;
+	const vector<Cell> &cells = simulator->getCells(liveCellCount);
+	frame.cells.assign(cells.begin(), cells.begin() + liveCellCount);
+	frame.grid.build(frame.cells, liveCellCount, settings.arenaCenter, settings.arenaRadius);
+	frame.playerCell = simulator->getPlayerCell();
+	frame.state = simulator->getState();
+	frame.tick = tick;
+
+	frames.publish();
+}
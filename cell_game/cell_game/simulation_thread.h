@@ -0,0 +1,102 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "cell.h"
+#include "cell_grid.h"
+#include "simulator.h"
+#include "triple_buffer.h"
+
+namespace chaos {
+namespace cell {
+
+class Settings;
+
+////////////////////////////////////////////////////////////
+// SimulationFrame declaration
+
+// A picture of the simulation after a tick, what the renderer draws.
+struct SimulationFrame {
+	std::vector<Cell> cells; // The live cells only.
+	CellGrid grid; // Finds the cells in a part of the arena.
+	Cell playerCell;
+	Simulator::State state;
+	int tick;
+
+	SimulationFrame()
+		: playerCell(0.0f, Vector(), Vector())
+		, state(Simulator::READY)
+		, tick(0) {
+	}
+};
+
+////////////////////////////////////////////////////////////
+// SimulationThread declaration
+
+// Runs the simulator on its own thread, so the simulation speed does not depend on the frame rate.
+// Every settings.renderEveryNthTick ticks a frame is published through a triple buffer, the
+// display picks up the latest one. The simulator and the player's AI are only touched by the
+// thread once it starts, the requests of the GLUT thread are carried out between ticks.
+class SimulationThread {
+
+public:
+	SimulationThread(Settings &gameSettings);
+	~SimulationThread();
+
+	// The simulator belongs to the thread from now on.
+	void start(Simulator &gameSimulator);
+	void stop();
+
+	// Requests carried out before the next tick.
+	void togglePause();
+	void stepPaused();
+	void reloadPlayerAI();
+	void changeTickLength(float change);
+
+	// Picks up the latest frame. Returns false if there is no new one.
+	bool updateFrame();
+	const SimulationFrame& getFrame() const;
+
+	// The number of ticks simulated since the last call.
+	int takeTickCount();
+
+private:
+	SimulationThread(const SimulationThread &);
+	SimulationThread& operator=(const SimulationThread &);
+
+	enum Request {
+		TOGGLE_PAUSE = 1,
+		STEP_PAUSED = 2,
+		RELOAD_PLAYER_AI = 4
+	};
+
+	Simulator *simulator;
+	Settings &settings;
+
+	TripleBuffer<SimulationFrame> frames;
+
+	std::atomic<int> requests;
+	std::atomic<int> tickLengthChange; // In microseconds.
+	std::atomic<int> tickCount;
+	std::atomic<bool> running;
+	std::thread worker;
+
+	int tick;
+
+	void run();
+	bool handleRequests();
+	void publishFrame();
+};
+
+}; // namespace cell
+}; // namespace chaos
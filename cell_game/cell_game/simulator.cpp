@@ -21,6 +21,9 @@ using namespace chaos::cell;
 ////////////////////////////////////////////////////////////
 // Helpers
 
+// Fast-forward lists the active cells once at least one cell in this many is quiet.
+static const int MIN_QUIET_CELL_SHARE = 4;
+
 class DistanceToPlayerComparator {
 
 public:
@@ -34,7 +37,24 @@ public:
 	}
 
 private:
-	const Cell &playerCell;
+	// A copy, the sort moves other cells into the place of the player's cell.
+	const Cell playerCell;
+};
+
+// Orders the indices of the cells the way DistanceToPlayerComparator orders the cells.
+class CellIndexComparator {
+
+public:
+	CellIndexComparator(const vector<Cell> &inputCells, const Cell &playerCell) : cells(inputCells), cellComparator(playerCell) {
+	}
+
+	bool operator()(int lhs, int rhs) {
+		return cellComparator(cells[lhs], cells[rhs]);
+	}
+
+private:
+	const vector<Cell> &cells;
+	DistanceToPlayerComparator cellComparator;
 };
 
 ////////////////////////////////////////////////////////////
@@ -44,7 +64,17 @@ Simulator::Simulator(const Settings &gameSettings)
 	: settings(gameSettings)
 	, playerCellIndex(-1)
 	, liveCellsCount(0)
-	, state(READY) {
+	, state(READY)
+	, outcome(UNDECIDED)
+	, outcomeProjected(false)
+	, pendingTime(0.0f)
+	, ticksSinceSchedule(0)
+	, quietMaxSpeed(0.0f)
+	, closingDistance(0.0f)
+	, tickGrowth(0.0f) {
+}
+
+Simulator::~Simulator() {
 }
 
 const vector<Cell>& Simulator::getCells(int &liveCellCountOutput) const {
@@ -60,6 +90,14 @@ const Simulator::State& Simulator::getState() const {
 	return state;
 }
 
+const Simulator::Outcome& Simulator::getOutcome() const {
+	return outcome;
+}
+
+bool Simulator::isOutcomeProjected() const {
+	return outcomeProjected;
+}
+
 void Simulator::populate() {
 	cells.reserve(settings.cellCount);
 
@@ -67,6 +105,10 @@ void Simulator::populate() {
 	liveCellsCount = settings.cellCount;
 
 	state = READY;
+	outcome = UNDECIDED;
+	outcomeProjected = false;
+	pendingTime = 0.0f;
+	awakeSlots.clear();
 
 	srand(settings.levelSeed);
 
@@ -90,6 +132,12 @@ void Simulator::populate() {
 			}
 		}
 	}
+
+	cellSlots.resize(cells.size());
+	for (int cellIndex = 0; cellIndex < (int)cells.size(); ++cellIndex) {
+		cellSlots[cellIndex] = cellIndex;
+	}
+	slotCells = cellSlots;
 }
 
 void Simulator::setPlayerAI(const ICellAI *cellAI) {
@@ -99,57 +147,45 @@ void Simulator::setPlayerAI(const ICellAI *cellAI) {
 }
 
 void Simulator::simulateNextTick() {
-	// 1. Resolve cell collisions with the arena walls and other cells. Some cells may die.
-	vector<Cell>::iterator liveCellsEnd = cells.begin() + liveCellsCount;
-	for (vector<Cell>::iterator firstCellIterator = cells.begin(); firstCellIterator != liveCellsEnd; ++firstCellIterator) {
-		if (firstCellIterator->isDead()) {
-			continue;
-		}
-
-		// Collide with arena walls
-		collideCellWithArena(*firstCellIterator);
-
-		for (vector<Cell>::iterator secondCellIterator = firstCellIterator + 1; secondCellIterator != liveCellsEnd; ++secondCellIterator) {
-			if (secondCellIterator->isDead()) {
-				continue;
-			}
+	tickGrowth = 0.0f;
 
-			// Collide with another cell
-			collideCells(*firstCellIterator, *secondCellIterator);
-
-			if (firstCellIterator->isDead()) {
-				break;
-			}
-		}
-	}
+	// 1. Resolve cell collisions with the arena walls and other cells. Some cells may die.
+	resolveCollisions();
 
 	// 2. Finish simulation if player died.
 	Cell &playerCell = cells[playerCellIndex];
 	if (playerCell.isDead()) {
-		state = FINISHED;
+		finish(PLAYER_LOST, false);
 		return;
 	}
 
 	// 3. Sorts all the cells using distance to player. Closest cells are first.
 	//    Since distance to dead cells is infinity we also partition our cell vector in two sections - living cells and dead cells.
-	sort(cells.begin(), liveCellsEnd, DistanceToPlayerComparator(playerCell));
+	sortCells();
 
 	// 4. Update live cell count.
 	updateLiveCellCount();
 
 	// 5. Finish simulation if player won.
 	if (liveCellsCount == 1) {
-		state = FINISHED;
+		finish(PLAYER_WON, false);
+		return;
+	}
+
+	// 6. Fast-forward: finish simulation as soon as the outcome cannot change.
+	if (settings.fastForward && isGameDecided()) {
 		return;
 	}
 
-	// 6. Let player cell figure out where to go. Accelerate player cell.
+	// 7. Let player cell figure out where to go. Accelerate player cell.
 	accelerateCell(playerCell);
 
-	// 7. Move all cells.
-	liveCellsEnd = cells.begin() + liveCellsCount;
-	for (vector<Cell>::iterator cellIterator = cells.begin(); cellIterator != liveCellsEnd; ++cellIterator) {
-		moveCell(*cellIterator);
+	// 8. Move all cells. The cells which die on the way stay until the next tick.
+	const float time = advanceCells();
+
+	// 9. Fast-forward: the quiet cells got closer to colliding.
+	if (isSkippingQuietCells()) {
+		closeQuietCells(time);
 	}
 }
 
@@ -161,6 +197,190 @@ void Simulator::toggleSimulationPause() {
 	}
 }
 
+bool Simulator::isSkippingQuietCells() const {
+	// The clearances shrink once per tick, the steps within a tick would need it more often.
+	// The continuous collision only looks at the nearby cells anyway, the kinetic one at the events.
+	return settings.fastForward && !settings.kineticSimulation && settings.physicsStepLength <= 0.0f && settings.substepTravel <= 0.0f && !settings.continuousCollision;
+}
+
+void Simulator::sortCells() {
+	const Cell &playerCell = cells[playerCellIndex];
+	if (!isSkippingQuietCells()) {
+		sort(cells.begin(), cells.begin() + liveCellsCount, DistanceToPlayerComparator(playerCell));
+		return;
+	}
+
+	// The slots have to follow their cells.
+	cellOrder.resize(liveCellsCount);
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		cellOrder[cellIndex] = cellIndex;
+	}
+	sort(cellOrder.begin(), cellOrder.end(), CellIndexComparator(cells, playerCell));
+
+	sortedCells.clear();
+	sortedSlots.clear();
+	for (vector<int>::const_iterator cellIndex = cellOrder.begin(); cellIndex != cellOrder.end(); ++cellIndex) {
+		sortedCells.push_back(cells[*cellIndex]);
+		sortedSlots.push_back(cellSlots[*cellIndex]);
+	}
+	copy(sortedCells.begin(), sortedCells.end(), cells.begin());
+	copy(sortedSlots.begin(), sortedSlots.end(), cellSlots.begin());
+
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		slotCells[cellSlots[cellIndex]] = cellIndex;
+	}
+}
+
+void Simulator::finish(Outcome gameOutcome, bool isProjected) {
+	state = FINISHED;
+	outcome = gameOutcome;
+	outcomeProjected = isProjected;
+}
+
+bool Simulator::isGameDecided() {
+	// A cell with more than half of all the matter is bigger than any other can become, nothing
+	// can eat it. If it is the player's, the player cannot lose, otherwise it cannot win.
+	float totalArea = 0.0f;
+	float largestArea = 0.0f;
+	int largestCellIndex = -1;
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		if (cells[cellIndex].isDead()) {
+			continue;
+		}
+
+		float area = cells[cellIndex].getArea();
+		totalArea += area;
+		if (largestArea < area) {
+			largestArea = area;
+			largestCellIndex = cellIndex;
+		}
+	}
+
+	if (largestArea <= 0.5f * totalArea) {
+		return false;
+	}
+
+	finish(largestCellIndex == playerCellIndex ? PLAYER_WON : PLAYER_LOST, true);
+	return true;
+}
+
+void Simulator::scheduleQuietCells() {
+	const int horizon = chaos::cell::max(1, settings.fastForwardHorizon);
+	ticksSinceSchedule = 0;
+
+	awakeSlots.assign(cells.size(), false);
+	awakeSlotList.clear();
+	wallEvents = priority_queue<WakeEvent>();
+	approachEvents = priority_queue<WakeEvent>();
+
+	broadphase.build(cells, liveCellsCount, settings.arenaCenter, settings.arenaRadius);
+
+	// The player's cell is left out, it is tested against every cell.
+	quietMaxSpeed = 0.0f;
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		if (cellIndex != playerCellIndex && !cells[cellIndex].isDead()) {
+			quietMaxSpeed = chaos::cell::max(quietMaxSpeed, cells[cellIndex].velocity.length());
+		}
+	}
+
+	// Look as far as the cells may get closer within the horizon.
+	const float range = 3.0f * quietMaxSpeed * horizon * settings.tickLength;
+
+	// The cells out of the arena are pulled back in the coming collisions, by no more than a tick's move.
+	closingDistance = quietMaxSpeed * settings.tickLength;
+
+	vector<int> neighbours;
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		const Cell &cell = cells[cellIndex];
+		if (cell.isDead() || cellIndex == playerCellIndex) {
+			continue;
+		}
+
+		const int slot = cellSlots[cellIndex];
+
+		// A tick early, the moves add up to a little more or less than the straight line.
+		const float wallTick = floorf(getWallTime(cell, settings.arenaCenter, settings.arenaRadius) / settings.tickLength) - 1.0f;
+		if (wallTick <= 0.0f) {
+			wakeSlot(slot);
+			continue;
+		} else if (wallTick < horizon) {
+			WakeEvent wallEvent = { wallTick, slot };
+			wallEvents.push(wallEvent);
+		}
+
+		float gap = range;
+
+		neighbours.clear();
+		broadphase.query(cell.position - (cell.radius + range), cell.position + (cell.radius + range), neighbours);
+		for (vector<int>::const_iterator neighbour = neighbours.begin(); neighbour != neighbours.end(); ++neighbour) {
+			if (*neighbour != cellIndex && *neighbour != playerCellIndex && !cells[*neighbour].isDead()) {
+				gap = chaos::cell::min(gap, distance(cell, cells[*neighbour]) - EPSILON);
+			}
+		}
+
+		if (gap <= closingDistance) {
+			wakeSlot(slot);
+		} else {
+			WakeEvent approachEvent = { gap, slot };
+			approachEvents.push(approachEvent);
+		}
+	}
+}
+
+void Simulator::wakeDueCells() {
+	for (; !wallEvents.empty() && wallEvents.top().time <= ticksSinceSchedule; wallEvents.pop()) {
+		wakeSlot(wallEvents.top().slot);
+	}
+	for (; !approachEvents.empty() && approachEvents.top().time <= closingDistance; approachEvents.pop()) {
+		wakeSlot(approachEvents.top().slot);
+	}
+
+	activeCells.clear();
+	for (vector<int>::const_iterator slot = awakeSlotList.begin(); slot != awakeSlotList.end(); ++slot) {
+		const int cellIndex = slotCells[*slot];
+		if (cellIndex < liveCellsCount && !cells[cellIndex].isDead()) {
+			activeCells.push_back(cellIndex);
+		}
+	}
+	sort(activeCells.begin(), activeCells.end());
+}
+
+void Simulator::wakeSlot(int slot) {
+	if (!awakeSlots[slot]) {
+		awakeSlots[slot] = true;
+		awakeSlotList.push_back(slot);
+	}
+}
+
+void Simulator::wakeCell(int cellIndex, size_t &firstActiveCell, size_t &secondActiveCell) {
+	wakeSlot(cellSlots[cellIndex]);
+
+	// Keep the active cells in order. Its pairs with the cells passed already were tested
+	// while it was quiet, where resolveCollisions() tests them, they did not touch then.
+	vector<int>::iterator position = lower_bound(activeCells.begin(), activeCells.end(), cellIndex);
+	const size_t activeCell = position - activeCells.begin();
+	activeCells.insert(position, cellIndex);
+
+	if (activeCell <= firstActiveCell) {
+		++firstActiveCell;
+	}
+	if (activeCell <= secondActiveCell) {
+		++secondActiveCell;
+	}
+}
+
+void Simulator::closeQuietCells(float time) {
+	// Only the awake cells change their speed, in bites with the player's cell.
+	float maxSpeed = quietMaxSpeed;
+	for (vector<int>::const_iterator cellIndex = activeCells.begin(); cellIndex != activeCells.end(); ++cellIndex) {
+		maxSpeed = chaos::cell::max(maxSpeed, cells[*cellIndex].velocity.length());
+	}
+
+	// A cell gets closer to another by its own move and the other's, which the wall may push
+	// back as far again, and by the radii growing.
+	closingDistance += 3.0f * maxSpeed * time + tickGrowth + EPSILON;
+}
+
 void Simulator::updateLiveCellCount() {
 	// Very few cells die in a single tick (one or two at most) so this is faster than binary search.
 	while (0 < liveCellsCount && cells[liveCellsCount - 1].isDead()) {
@@ -180,8 +400,388 @@ void Simulator::accelerateCell(Cell &playerCell) {
 	}
 }
 
-void Simulator::moveCell(Cell &cell) {
-	cell.position += cell.velocity * settings.tickLength;
+void Simulator::resolveCollisions() {
+	if (settings.continuousCollision) {
+		resolveNearbyCollisions();
+		return;
+	}
+
+	if (isSkippingQuietCells()) {
+		resolveActiveCollisions();
+	} else {
+		resolveAllCollisions();
+	}
+}
+
+void Simulator::resolveAllCollisions() {
+	vector<Cell>::iterator liveCellsEnd = cells.begin() + liveCellsCount;
+	for (vector<Cell>::iterator firstCellIterator = cells.begin(); firstCellIterator != liveCellsEnd; ++firstCellIterator) {
+		if (firstCellIterator->isDead()) {
+			continue;
+		}
+
+		// Collide with arena walls
+		collideCellWithArena(*firstCellIterator);
+
+		for (vector<Cell>::iterator secondCellIterator = firstCellIterator + 1; secondCellIterator != liveCellsEnd; ++secondCellIterator) {
+			if (secondCellIterator->isDead()) {
+				continue;
+			}
+
+			// Collide with another cell
+			collideCells(*firstCellIterator, *secondCellIterator);
+
+			if (firstCellIterator->isDead()) {
+				break;
+			}
+		}
+	}
+}
+
+void Simulator::resolveActiveCollisions() {
+	const int horizon = chaos::cell::max(1, settings.fastForwardHorizon);
+	if (awakeSlots.size() != cells.size() || horizon <= ticksSinceSchedule) {
+		scheduleQuietCells();
+	} else {
+		++ticksSinceSchedule;
+	}
+
+	wakeDueCells();
+
+	// Crowded, hardly any pair is left out. Testing them all is faster than going through the lists.
+	if (liveCellsCount - 1 - static_cast<int>(activeCells.size()) < liveCellsCount / MIN_QUIET_CELL_SHARE) {
+		resolveAllCollisions();
+
+		// The bites with the player's cell change the quiet cells their events were made for.
+		ticksSinceSchedule = horizon;
+		return;
+	}
+
+	// The same pairs in the same order as resolveCollisions(), without the quiet cells. A quiet cell
+	// cannot touch any other before the radii have grown by its gap in this tick.
+	size_t firstActiveCell = 0;
+	size_t secondActiveCell = 0;
+
+	// The player's cell may turn any time, it is tested against every cell. It is the first after the sort.
+	Cell &playerCell = cells[playerCellIndex];
+	if (!playerCell.isDead()) {
+		collideCellWithArena(playerCell);
+
+		for (int cellIndex = playerCellIndex + 1; cellIndex < liveCellsCount; ++cellIndex) {
+			if (cells[cellIndex].isDead()) {
+				continue;
+			}
+
+			// A bitten cell goes another way than its events were made for.
+			if (collideCells(playerCell, cells[cellIndex]) && !awakeSlots[cellSlots[cellIndex]]) {
+				wakeCell(cellIndex, firstActiveCell, secondActiveCell);
+			}
+			if (!approachEvents.empty() && approachEvents.top().time <= closingDistance + tickGrowth) {
+				wakeApproachedCells(firstActiveCell, secondActiveCell);
+			}
+
+			if (playerCell.isDead()) {
+				break;
+			}
+		}
+	}
+
+	for (firstActiveCell = 0; firstActiveCell < activeCells.size(); ++firstActiveCell) {
+		Cell &firstCell = cells[activeCells[firstActiveCell]];
+		if (firstCell.isDead()) {
+			continue;
+		}
+
+		// Collide with arena walls
+		collideCellWithArena(firstCell);
+
+		for (secondActiveCell = firstActiveCell + 1; secondActiveCell < activeCells.size(); ++secondActiveCell) {
+			Cell &secondCell = cells[activeCells[secondActiveCell]];
+			if (secondCell.isDead()) {
+				continue;
+			}
+
+			// Collide with another cell
+			collideCells(firstCell, secondCell);
+			if (!approachEvents.empty() && approachEvents.top().time <= closingDistance + tickGrowth) {
+				wakeApproachedCells(firstActiveCell, secondActiveCell);
+			}
+
+			if (firstCell.isDead()) {
+				break;
+			}
+		}
+	}
+}
+
+void Simulator::wakeApproachedCells(size_t &firstActiveCell, size_t &secondActiveCell) {
+	for (; !approachEvents.empty() && approachEvents.top().time <= closingDistance + tickGrowth; approachEvents.pop()) {
+		const int slot = approachEvents.top().slot;
+		const int cellIndex = slotCells[slot];
+		if (!awakeSlots[slot] && cellIndex < liveCellsCount && !cells[cellIndex].isDead()) {
+			wakeCell(cellIndex, firstActiveCell, secondActiveCell);
+		}
+	}
+}
+
+void Simulator::resolveNearbyCollisions() {
+	broadphase.build(cells, liveCellsCount, settings.arenaCenter, settings.arenaRadius);
+
+	// The same pairs in the same order as resolveCollisions(), without the ones too far apart to touch.
+	vector<int> neighbours;
+	for (int firstCellIndex = 0; firstCellIndex < liveCellsCount; ++firstCellIndex) {
+		Cell &firstCell = cells[firstCellIndex];
+		if (firstCell.isDead()) {
+			continue;
+		}
+
+		// Collide with arena walls
+		collideCellWithArena(firstCell);
+
+		neighbours.clear();
+		broadphase.query(firstCell.position - firstCell.radius, firstCell.position + firstCell.radius, neighbours);
+		sort(neighbours.begin(), neighbours.end());
+
+		for (vector<int>::const_iterator neighbour = upper_bound(neighbours.begin(), neighbours.end(), firstCellIndex); neighbour != neighbours.end(); ++neighbour) {
+			Cell &secondCell = cells[*neighbour];
+			if (secondCell.isDead()) {
+				continue;
+			}
+
+			// Collide with another cell
+			collideCells(firstCell, secondCell);
+
+			if (firstCell.isDead()) {
+				break;
+			}
+		}
+	}
+}
+
+float Simulator::advanceCells() {
+	if (settings.physicsStepLength <= 0.0f) {
+		stepCells(settings.tickLength, true);
+		return settings.tickLength;
+	}
+
+	// The steps stay the same whatever the tick length, the remainder waits for the next tick.
+	pendingTime += settings.tickLength;
+
+	float time = 0.0f;
+	bool isResolved = true;
+	while (settings.physicsStepLength <= pendingTime) {
+		pendingTime -= settings.physicsStepLength;
+		stepCells(settings.physicsStepLength, isResolved);
+		time += settings.physicsStepLength;
+		isResolved = false;
+	}
+	return time;
+}
+
+void Simulator::stepCells(float stepLength, bool isResolved) {
+	float maxSpeed = 0.0f;
+	float maxTravel = 0.0f;
+	const int substepCount = getSubstepCount(stepLength, maxSpeed, maxTravel);
+	const float substepLength = stepLength / substepCount;
+
+	// Only the cells faster than this may still pass through others.
+	const float speedLimit = maxTravel / substepLength;
+
+	for (int substep = 0; substep < substepCount; ++substep) {
+		if (0 < substep || !isResolved) {
+			resolveCollisions();
+		}
+
+		vector<Cell>::iterator liveCellsEnd = cells.begin() + liveCellsCount;
+		if (settings.continuousCollision) {
+			collideContinuously(substepLength);
+		} else if (0.0f < maxTravel && speedLimit < maxSpeed) {
+			sweepFastCells(substepLength, maxSpeed, speedLimit);
+
+			for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+				if (!sweptCells[cellIndex]) {
+					moveCell(cells[cellIndex], substepLength);
+				}
+			}
+		} else {
+			for (vector<Cell>::iterator cellIterator = cells.begin(); cellIterator != liveCellsEnd; ++cellIterator) {
+				moveCell(*cellIterator, substepLength);
+			}
+		}
+	}
+}
+
+int Simulator::getSubstepCount(float stepLength, float &maxSpeed, float &maxTravel) const {
+	maxSpeed = 0.0f;
+	maxTravel = 0.0f;
+	if (settings.substepTravel <= 0.0f) {
+		return 1;
+	}
+
+	float minRadius = LARGE_FLOAT;
+	vector<Cell>::const_iterator liveCellsEnd = cells.begin() + liveCellsCount;
+	for (vector<Cell>::const_iterator cellIterator = cells.begin(); cellIterator != liveCellsEnd; ++cellIterator) {
+		if (!cellIterator->isDead()) {
+			maxSpeed = chaos::cell::max(maxSpeed, cellIterator->velocity.length());
+			minRadius = chaos::cell::min(minRadius, cellIterator->radius);
+		}
+	}
+
+	maxTravel = settings.substepTravel * minRadius;
+	if (maxTravel <= 0.0f || LARGE_FLOAT <= minRadius) {
+		maxTravel = 0.0f;
+		return 1;
+	}
+
+	return chaos::cell::clamp(static_cast<int>(ceilf(maxSpeed * stepLength / maxTravel)), 1, chaos::cell::max(1, settings.maxSubstepCount));
+}
+
+void Simulator::sweepFastCells(float substepLength, float maxSpeed, float speedLimit) {
+	sweptCells.assign(liveCellsCount, false);
+	broadphase.build(cells, liveCellsCount, settings.arenaCenter, settings.arenaRadius);
+
+	vector<int> neighbours;
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		Cell &cell = cells[cellIndex];
+		if (sweptCells[cellIndex] || cell.isDead() || cell.velocity.length() <= speedLimit) {
+			continue;
+		}
+
+		// 1. The cells which may meet this one during the substep, wherever they go.
+		Vector destination = cell.position + substepLength * cell.velocity;
+		float reach = cell.radius + maxSpeed * substepLength;
+		Vector minimum(chaos::cell::min(cell.position.x, destination.x) - reach, chaos::cell::min(cell.position.y, destination.y) - reach);
+		Vector maximum(chaos::cell::max(cell.position.x, destination.x) + reach, chaos::cell::max(cell.position.y, destination.y) + reach);
+
+		neighbours.clear();
+		broadphase.query(minimum, maximum, neighbours);
+
+		// 2. Find the first one it touches.
+		int hitIndex = -1;
+		float hitTime = substepLength;
+		for (vector<int>::const_iterator neighbour = neighbours.begin(); neighbour != neighbours.end(); ++neighbour) {
+			if (*neighbour == cellIndex || sweptCells[*neighbour] || cells[*neighbour].isDead()) {
+				continue;
+			}
+
+			float time = getBiteTime(cell, cells[*neighbour], substepLength);
+			if (0.0f <= time && (hitIndex < 0 || time < hitTime)) {
+				hitIndex = *neighbour;
+				hitTime = time;
+			}
+		}
+
+		if (hitIndex < 0) {
+			continue;
+		}
+
+		// 3. Take the bite the smaller substeps would have taken on the way.
+		Cell &hitCell = cells[hitIndex];
+		moveCell(cell, hitTime);
+		moveCell(hitCell, hitTime);
+		collideCells(cell, hitCell);
+		moveCell(cell, substepLength - hitTime);
+		moveCell(hitCell, substepLength - hitTime);
+
+		sweptCells[cellIndex] = true;
+		sweptCells[hitIndex] = true;
+	}
+}
+
+void Simulator::collideContinuously(float stepLength) {
+	// 1. Every cell starts at the beginning of the step.
+	cellTimes.assign(liveCellsCount, 0.0f);
+	cellVersions.assign(liveCellsCount, 0);
+	broadphase.build(cells, liveCellsCount, settings.arenaCenter, settings.arenaRadius);
+
+	// A bite only mixes velocities, no cell gets faster than this during the step.
+	float maxSpeed = 0.0f;
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		if (!cells[cellIndex].isDead()) {
+			maxSpeed = chaos::cell::max(maxSpeed, cells[cellIndex].velocity.length());
+		}
+	}
+
+	// 2. The first contact of each pair.
+	vector<int> neighbours;
+	priority_queue<Contact> contacts;
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		findContacts(cellIndex, true, stepLength, maxSpeed, neighbours, contacts);
+	}
+
+	// 3. Take the bites in time order. A bite changes the paths of both cells, their other
+	//    contacts are dropped and found again from where they are now.
+	while (!contacts.empty()) {
+		Contact contact = contacts.top();
+		contacts.pop();
+
+		if (contact.lhsVersion != cellVersions[contact.lhs] || contact.rhsVersion != cellVersions[contact.rhs]) {
+			continue;
+		}
+
+		Cell &lhs = cells[contact.lhs];
+		Cell &rhs = cells[contact.rhs];
+		if (lhs.isDead() || rhs.isDead()) {
+			continue;
+		}
+
+		moveCell(lhs, contact.time - cellTimes[contact.lhs]);
+		moveCell(rhs, contact.time - cellTimes[contact.rhs]);
+		cellTimes[contact.lhs] = contact.time;
+		cellTimes[contact.rhs] = contact.time;
+
+		collideCells(lhs, rhs);
+
+		++cellVersions[contact.lhs];
+		++cellVersions[contact.rhs];
+		findContacts(contact.lhs, false, stepLength, maxSpeed, neighbours, contacts);
+		findContacts(contact.rhs, false, stepLength, maxSpeed, neighbours, contacts);
+	}
+
+	// 4. Bring every cell to the end of the step.
+	for (int cellIndex = 0; cellIndex < liveCellsCount; ++cellIndex) {
+		moveCell(cells[cellIndex], stepLength - cellTimes[cellIndex]);
+	}
+}
+
+void Simulator::findContacts(int cellIndex, bool onlyLaterCells, float stepLength, float maxSpeed, vector<int> &neighbours, priority_queue<Contact> &contacts) {
+	const Cell &cell = cells[cellIndex];
+	if (cell.isDead()) {
+		return;
+	}
+
+	// The grid holds the cells where the step started, they have moved at most maxSpeed * stepLength since.
+	const float cellTime = cellTimes[cellIndex];
+	Vector destination = cell.position + (stepLength - cellTime) * cell.velocity;
+	float reach = cell.radius + maxSpeed * stepLength;
+	Vector minimum(chaos::cell::min(cell.position.x, destination.x) - reach, chaos::cell::min(cell.position.y, destination.y) - reach);
+	Vector maximum(chaos::cell::max(cell.position.x, destination.x) + reach, chaos::cell::max(cell.position.y, destination.y) + reach);
+
+	neighbours.clear();
+	broadphase.query(minimum, maximum, neighbours);
+
+	for (vector<int>::const_iterator neighbour = neighbours.begin(); neighbour != neighbours.end(); ++neighbour) {
+		if (*neighbour == cellIndex || (onlyLaterCells && *neighbour < cellIndex) || cells[*neighbour].isDead()) {
+			continue;
+		}
+
+		// Compare the two cells at the same time.
+		const float startTime = chaos::cell::max(cellTime, cellTimes[*neighbour]);
+		Cell lhs = cell;
+		Cell rhs = cells[*neighbour];
+		moveCell(lhs, startTime - cellTime);
+		moveCell(rhs, startTime - cellTimes[*neighbour]);
+
+		float time = getBiteTime(lhs, rhs, stepLength - startTime);
+		if (0.0f <= time) {
+			Contact contact = { startTime + time, cellIndex, *neighbour, cellVersions[cellIndex], cellVersions[*neighbour] };
+			contacts.push(contact);
+		}
+	}
+}
+
+void Simulator::moveCell(Cell &cell, float time) {
+	cell.position += cell.velocity * time;
 }
 
 bool Simulator::isCellCollidingWithArena(const Cell &cell) const {
@@ -222,7 +822,7 @@ bool Simulator::areCellsColliding(const Cell &lhs, const Cell &rhs) const {
 	return result;
 }
 
-void Simulator::collideCells(Cell &lhs, Cell &rhs) {
+bool Simulator::collideCells(Cell &lhs, Cell &rhs) {
 	float cellCenterDistance = distance(lhs.position, rhs.position);
 	if (cellCenterDistance < lhs.radius + rhs.radius + EPSILON) {
 		// The two cells are colliding. Determine who eats who.
@@ -251,8 +851,62 @@ void Simulator::collideCells(Cell &lhs, Cell &rhs) {
 
 		float biteArea = newHunterArea - oldHunterArea;
 
+		tickGrowth += chaos::cell::max(0.0f, newHunterRadius - hunterCell->radius);
+
 		preyCell->radius = newPreyRadius;
 		hunterCell->radius = newHunterRadius;
 		hunterCell->velocity = (oldHunterArea * hunterCell->velocity + biteArea * preyCell->velocity) / newHunterArea;
+		return true;
+	}
+
+	return false;
+}
+
+// Small bites again and again leave the cells incident where they are closest,
+// unless the smaller one is eaten whole on the way there, at the distance sqrt(lhs.radius^2 + rhs.radius^2).
+float Simulator::getBiteTime(const Cell &lhs, const Cell &rhs, float duration) {
+	Vector relativePosition = rhs.position - lhs.position;
+	Vector relativeVelocity = rhs.velocity - lhs.velocity;
+	float radiusSum = lhs.radius + rhs.radius;
+
+	// |relativePosition + t * relativeVelocity| = radiusSum
+	float a = dot(relativeVelocity, relativeVelocity);
+	float b = dot(relativePosition, relativeVelocity);
+	float c = dot(relativePosition, relativePosition) - radiusSum * radiusSum;
+	if (a < EPSILON * EPSILON || 0.0f <= b) {
+		// Not moving closer.
+		return c < 0.0f ? 0.0f : -1.0f;
+	}
+
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f || duration < (-b - sqrtf(discriminant)) / a) {
+		// They miss each other or touch after duration.
+		return -1.0f;
 	}
+
+	float time = -b / a;
+
+	float wholeBiteDiscriminant = b * b - a * (dot(relativePosition, relativePosition) - lhs.radius * lhs.radius - rhs.radius * rhs.radius);
+	if (0.0f <= wholeBiteDiscriminant) {
+		time = chaos::cell::min(time, (-b - sqrtf(wholeBiteDiscriminant)) / a);
+	}
+
+	return chaos::cell::clamp(time, 0.0f, duration);
+}
+
+float Simulator::getWallTime(const Cell &cell, const Vector &arenaCenter, float arenaRadius) {
+	Vector relativePosition = cell.position - arenaCenter;
+	float reach = arenaRadius - cell.radius;
+
+	// |relativePosition + t * cell.velocity| = reach
+	float a = dot(cell.velocity, cell.velocity);
+	float b = dot(relativePosition, cell.velocity);
+	float c = dot(relativePosition, relativePosition) - reach * reach;
+	if (0.0f <= c) {
+		return 0.0f;
+	} else if (a < EPSILON * EPSILON) {
+		return LARGE_FLOAT;
+	}
+
+	return (-b + sqrtf(b * b - a * c)) / a;
 }
@@ -8,8 +8,11 @@
 
 #pragma once
 
+#include <queue>
 #include <vector>
 
+#include "cell_grid.h"
+
 namespace chaos {
 namespace cell {
 
@@ -27,20 +30,46 @@ public:
 		FINISHED
 	};
 
+	enum Outcome {
+		UNDECIDED,
+		PLAYER_WON,
+		PLAYER_LOST
+	};
+
 	Simulator(const Settings &gameSettings);
+	virtual ~Simulator();
 
 	const std::vector<Cell>& getCells(int &liveCellCount) const;
 	const Cell& getPlayerCell() const;
 	const State& getState() const;
 
-	void populate();
-	void setPlayerAI(const ICellAI *cellAI);
+	// How the game ended. A fast-forwarded game may end before the player dies or wins,
+	// as soon as the outcome cannot change any more. The outcome is projected then.
+	const Outcome& getOutcome() const;
+	bool isOutcomeProjected() const;
 
-	void simulateNextTick();
+	virtual void populate();
+	virtual void setPlayerAI(const ICellAI *cellAI);
+
+	virtual void simulateNextTick();
 
 	void toggleSimulationPause();
 
-private:
+protected:
+	// Two cells at their closest within a step, the time they take a bite.
+	struct Contact {
+		float time;
+		int lhs;
+		int rhs;
+		int lhsVersion;
+		int rhsVersion;
+
+		// The earliest contact first in a priority queue.
+		bool operator<(const Contact &other) const {
+			return other.time < time;
+		}
+	};
+
 	const Settings &settings;
 	
 	std::vector<Cell> cells;
@@ -49,18 +78,98 @@ private:
 	int liveCellsCount;
 
 	State state;
+	Outcome outcome;
+	bool outcomeProjected;
+
+	// The part of the ticks not stepped yet when the physics has a fixed step.
+	float pendingTime;
+
+	// Finds the neighbours of the cells for the swept and continuous collisions.
+	CellGrid broadphase;
+	std::vector<bool> sweptCells;
+
+	// The continuous collision moves each cell to its own time within the step.
+	std::vector<float> cellTimes;
+	std::vector<int> cellVersions;
+
+	// Fast-forward: the cells which cannot collide are quiet, they wake when their events come. A cell
+	// wakes in the tick it may reach the wall or once the cells may have got as much closer as the gap to
+	// its nearest neighbour. The awake cells are tested for collisions until the next schedule.
+	struct WakeEvent {
+		float time; // The tick since the schedule, or how much closer the cells have to get.
+		int slot;
+
+		// The earliest event first in a priority queue.
+		bool operator<(const WakeEvent &other) const {
+			return other.time < time;
+		}
+	};
+
+	// The events refer to the cells by their slots, which stay the same when the cells are sorted.
+	std::vector<int> cellSlots;
+	std::vector<int> slotCells;
+	std::vector<bool> awakeSlots;
+	std::vector<int> awakeSlotList;
+	std::priority_queue<WakeEvent> wallEvents;
+	std::priority_queue<WakeEvent> approachEvents;
+	int ticksSinceSchedule;
+	float quietMaxSpeed; // The speed of the quiet cells doesn't change.
+	float closingDistance; // How much closer any two quiet cells may have got since the schedule.
+	float tickGrowth; // How much the radii have grown in this tick, all together.
+	std::vector<int> activeCells; // The awake cells by index.
+
+	// Used to sort the slots along with the cells.
+	std::vector<int> cellOrder;
+	std::vector<Cell> sortedCells;
+	std::vector<int> sortedSlots;
+
+	bool isSkippingQuietCells() const;
+	void sortCells();
+	void finish(Outcome gameOutcome, bool isProjected);
+	bool isGameDecided();
+	void scheduleQuietCells();
+	void wakeDueCells();
+	void wakeSlot(int slot);
+	void wakeCell(int cellIndex, size_t &firstActiveCell, size_t &secondActiveCell);
+	void closeQuietCells(float time);
 
 	void updateLiveCellCount();
 
 	void accelerateCell(Cell &cell);
 
-	void moveCell(Cell &cell);
+	void resolveCollisions();
+	void resolveAllCollisions();
+	void resolveActiveCollisions();
+	// The cells grown in this tick may reach the quiet cells with the least gap.
+	void wakeApproachedCells(size_t &firstActiveCell, size_t &secondActiveCell);
+	void resolveNearbyCollisions();
+
+	// Moves the cells over a tick, in fixed steps if settings.physicsStepLength is set.
+	// Returns the time they have moved.
+	float advanceCells();
+	// Splits the step in substeps by the speed of the fastest cell. The collisions
+	// at the start of the first substep are resolved already if isResolved is true.
+	void stepCells(float stepLength, bool isResolved);
+	int getSubstepCount(float stepLength, float &maxSpeed, float &maxTravel) const;
+	// Catches the cells still too fast for the substep before they pass through others.
+	void sweepFastCells(float substepLength, float maxSpeed, float speedLimit);
+	// Moves the cells over the step and takes the bites between them in time order.
+	void collideContinuously(float stepLength);
+	void findContacts(int cellIndex, bool onlyLaterCells, float stepLength, float maxSpeed, std::vector<int> &neighbours, std::priority_queue<Contact> &contacts);
+
+	void moveCell(Cell &cell, float time);
 
 	bool isCellCollidingWithArena(const Cell &cell) const;
 	void collideCellWithArena(Cell &cell);
 	
 	bool areCellsColliding(const Cell &lhs, const Cell &rhs) const;
-	void collideCells(Cell &lhs, Cell &rhs);
+	// Returns true if the cells took a bite.
+	bool collideCells(Cell &lhs, Cell &rhs);
+
+	// Returns the time in [0, duration] at which the moving cells take their bite, or -1 if they don't touch before duration.
+	static float getBiteTime(const Cell &lhs, const Cell &rhs, float duration);
+	// Returns the time the cell moving straight reaches the wall, 0 if it is there already or LARGE_FLOAT if it stands still.
+	static float getWallTime(const Cell &cell, const Vector &arenaCenter, float arenaRadius);
 };
 
 }; // namespace cell
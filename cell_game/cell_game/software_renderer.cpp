@@ -0,0 +1,192 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+// Standard headers
+#include <cmath>
+#include <thread>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#include <emmintrin.h>
+	#define CELL_SSE2_SPANS
+#endif
+
+// Project headers
+#include "cell.h"
+#include "software_renderer.h"
+#include "math_utils.h"
+
+using namespace std;
+using namespace chaos::cell;
+
+// Packs a color so its bytes are R, G, B, A in memory on little-endian processors.
+inline unsigned int packColor(unsigned int red, unsigned int green, unsigned int blue) {
+	return red | (green << 8) | (blue << 16) | 0xFF000000u;
+}
+
+static const unsigned int BACKGROUND_COLOR = packColor(0, 0, 0);
+static const unsigned int ARENA_COLOR = packColor(255, 255, 255);
+static const unsigned int PREY_COLOR = packColor(0, 255, 0);
+static const unsigned int PREDATOR_COLOR = packColor(255, 0, 0);
+static const unsigned int PLAYER_COLOR = packColor(0, 0, 255);
+
+// The width of the arena's outline in pixels, as drawn by GLUT.
+static const float ARENA_LINE_WIDTH = 2.0f;
+
+// Each thread fills at least this many rows.
+static const int MIN_BAND_HEIGHT = 16;
+
+////////////////////////////////////////////////////////////
+// SoftwareRenderer implementation
+
+SoftwareRenderer::SoftwareRenderer(int frameSize)
+	: size(frameSize)
+	, pixels(frameSize * frameSize, BACKGROUND_COLOR) {
+}
+
+SoftwareRenderer::~SoftwareRenderer() {
+}
+
+void SoftwareRenderer::render(const vector<Cell> &cells, int liveCellCount, const Cell &playerCell, const Vector &arenaCenter, float arenaRadius) {
+	// 1. Take the scene to pixel coordinates, in the order of drawing.
+	arena = toPixels(arenaCenter, arenaRadius, ARENA_COLOR);
+
+	discs.clear();
+	vector<Cell>::const_iterator liveCellsEnd = cells.begin() + liveCellCount;
+	for (vector<Cell>::const_iterator cellIterator = cells.begin(); cellIterator != liveCellsEnd; ++cellIterator) {
+		// Cells die in place, the live count only shrinks past the dead ones at its end.
+		if (cellIterator->isDead()) {
+			continue;
+		}
+		discs.push_back(toPixels(cellIterator->position, cellIterator->radius, cellIterator->radius < playerCell.radius ? PREY_COLOR : PREDATOR_COLOR));
+	}
+	discs.push_back(toPixels(playerCell.position, playerCell.radius, PLAYER_COLOR));
+
+	// 2. Fill the bands of rows in parallel. The calling thread takes the last one.
+	int bandCount = static_cast<int>(thread::hardware_concurrency());
+	bandCount = clamp(bandCount, 1, chaos::cell::max(1, size / MIN_BAND_HEIGHT));
+
+	vector<thread> workers;
+	workers.reserve(bandCount - 1);
+	for (int band = 0; band < bandCount - 1; ++band) {
+		workers.push_back(thread(&SoftwareRenderer::renderRows, this, band * size / bandCount, (band + 1) * size / bandCount));
+	}
+	renderRows((bandCount - 1) * size / bandCount, size);
+
+	for (vector<thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker) {
+		worker->join();
+	}
+}
+
+int SoftwareRenderer::getSize() const {
+	return size;
+}
+
+const unsigned int* SoftwareRenderer::getPixels() const {
+	return pixels.empty() ? NULL : &pixels[0];
+}
+
+SoftwareRenderer::Disc SoftwareRenderer::toPixels(const Vector &center, float radius, unsigned int color) const {
+	// The y axis points up in the arena and down the rows of the framebuffer.
+	const float pixelsPerUnit = 0.5f * size;
+
+	Disc disc;
+	disc.x = (center.x + 1.0f) * pixelsPerUnit;
+	disc.y = (1.0f - center.y) * pixelsPerUnit;
+	disc.radius = radius * pixelsPerUnit;
+	disc.color = color;
+	return disc;
+}
+
+void SoftwareRenderer::renderRows(int firstRow, int lastRow) {
+	for (int row = firstRow; row < lastRow; ++row) {
+		fillSpan(row, 0.0f, static_cast<float>(size), BACKGROUND_COLOR);
+	}
+
+	fillRing(arena, ARENA_LINE_WIDTH, firstRow, lastRow);
+
+	for (vector<Disc>::const_iterator disc = discs.begin(); disc != discs.end(); ++disc) {
+		fillDisc(*disc, firstRow, lastRow);
+	}
+}
+
+void SoftwareRenderer::fillDisc(const Disc &disc, int firstRow, int lastRow) {
+	// Smaller than a pixel, light the pixel under the center like GLUT's points.
+	if (disc.radius < 0.5f) {
+		int row = static_cast<int>(floorf(disc.y));
+		if (firstRow <= row && row < lastRow) {
+			fillSpan(row, disc.x - 0.5f, disc.x + 0.5f, disc.color);
+		}
+		return;
+	}
+
+	// The rows whose centers the disc covers.
+	int top = chaos::cell::max(firstRow, static_cast<int>(ceilf(disc.y - disc.radius - 0.5f)));
+	int bottom = chaos::cell::min(lastRow - 1, static_cast<int>(floorf(disc.y + disc.radius - 0.5f)));
+
+	const float radiusSquared = disc.radius * disc.radius;
+	for (int row = top; row <= bottom; ++row) {
+		float dy = row + 0.5f - disc.y;
+		float halfWidthSquared = radiusSquared - dy * dy;
+		if (0.0f < halfWidthSquared) {
+			float halfWidth = sqrtf(halfWidthSquared);
+			fillSpan(row, disc.x - halfWidth, disc.x + halfWidth, disc.color);
+		}
+	}
+}
+
+void SoftwareRenderer::fillRing(const Disc &disc, float width, int firstRow, int lastRow) {
+	const float outerRadius = disc.radius + 0.5f * width;
+	const float innerRadius = disc.radius - 0.5f * width;
+
+	int top = chaos::cell::max(firstRow, static_cast<int>(ceilf(disc.y - outerRadius - 0.5f)));
+	int bottom = chaos::cell::min(lastRow - 1, static_cast<int>(floorf(disc.y + outerRadius - 0.5f)));
+
+	for (int row = top; row <= bottom; ++row) {
+		float dy = row + 0.5f - disc.y;
+		float outerHalfWidthSquared = outerRadius * outerRadius - dy * dy;
+		if (outerHalfWidthSquared <= 0.0f) {
+			continue;
+		}
+
+		// Across the hole there are two spans, above and below it one.
+		float outerHalfWidth = sqrtf(outerHalfWidthSquared);
+		float innerHalfWidthSquared = innerRadius * innerRadius - dy * dy;
+		if (0.0f < innerRadius && 0.0f < innerHalfWidthSquared) {
+			float innerHalfWidth = sqrtf(innerHalfWidthSquared);
+			fillSpan(row, disc.x - outerHalfWidth, disc.x - innerHalfWidth, disc.color);
+			fillSpan(row, disc.x + innerHalfWidth, disc.x + outerHalfWidth, disc.color);
+		} else {
+			fillSpan(row, disc.x - outerHalfWidth, disc.x + outerHalfWidth, disc.color);
+		}
+	}
+}
+
+void SoftwareRenderer::fillSpan(int row, float left, float right, unsigned int color) {
+	// The pixels whose centers lie in [left, right].
+	int first = chaos::cell::max(0, static_cast<int>(ceilf(left - 0.5f)));
+	int last = chaos::cell::min(size - 1, static_cast<int>(floorf(right - 0.5f)));
+
+	int count = last - first + 1;
+	if (count <= 0) {
+		return;
+	}
+
+	unsigned int *pixel = &pixels[row * size + first];
+
+#ifdef CELL_SSE2_SPANS
+	// Four pixels per store.
+	const __m128i colors = _mm_set1_epi32(static_cast<int>(color));
+	for (; 4 <= count; count -= 4, pixel += 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixel), colors);
+	}
+#endif
+
+	for (; 0 < count; --count) {
+		*pixel++ = color;
+	}
+}
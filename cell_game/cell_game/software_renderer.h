@@ -0,0 +1,69 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vector2d.h"
+
+namespace chaos {
+namespace cell {
+
+class Cell;
+
+////////////////////////////////////////////////////////////
+// SoftwareRenderer declaration
+
+// Draws the same picture as the GLUT display into a square RGBA framebuffer in memory, without OpenGL.
+// The rows are split in bands which are filled on separate threads, each row of a circle is a span of
+// equal pixels. Used to export games on machines without a display.
+class SoftwareRenderer {
+
+public:
+	// The framebuffer is size x size pixels, the arena [-1, 1] fills it.
+	explicit SoftwareRenderer(int frameSize);
+	~SoftwareRenderer();
+
+	void render(const std::vector<Cell> &cells, int liveCellCount, const Cell &playerCell, const Vector &arenaCenter, float arenaRadius);
+
+	int getSize() const;
+
+	// The pixels of the last render() from the top row down. Each is R, G, B, A in memory.
+	const unsigned int* getPixels() const;
+
+private:
+	SoftwareRenderer(const SoftwareRenderer &);
+	SoftwareRenderer& operator=(const SoftwareRenderer &);
+
+	// A circle in pixel coordinates.
+	struct Disc {
+		float x;
+		float y;
+		float radius;
+		unsigned int color;
+	};
+
+	int size;
+	std::vector<unsigned int> pixels;
+
+	// Filled by render(), read by the threads.
+	std::vector<Disc> discs;
+	Disc arena;
+
+	Disc toPixels(const Vector &center, float radius, unsigned int color) const;
+
+	// Each thread only writes the rows it is given.
+	void renderRows(int firstRow, int lastRow);
+	void fillDisc(const Disc &disc, int firstRow, int lastRow);
+	void fillRing(const Disc &disc, float width, int firstRow, int lastRow);
+	void fillSpan(int row, float left, float right, unsigned int color);
+};
+
+}; // namespace cell
+}; // namespace chaos
@@ -0,0 +1,72 @@
+/*
+	Copyright (C) 2014 Chaos Software
+
+	Distributed under the Boost Software License, Version 1.0.
+	See accompanying file LICENSE_1_0.txt or copy at
+	http://www.boost.org/LICENSE_1_0.txt.
+*/
+
+#pragma once
+
+#include <atomic>
+
+namespace chaos {
+namespace cell {
+
+////////////////////////////////////////////////////////////
+// TripleBuffer declaration
+
+// Passes values from one writer thread to one reader thread without locks.
+// The writer fills the back buffer and publishes it, the reader picks up the latest
+// published buffer. Neither ever waits for the other, values the reader is too slow for are skipped.
+template <typename T>
+class TripleBuffer {
+
+public:
+	TripleBuffer()
+		: backIndex(0)
+		, sharedIndex(1)
+		, frontIndex(2) {
+	}
+
+	// Writer side. The buffer to fill, it keeps whatever it held two publications ago.
+	T& getBack() {
+		return buffers[backIndex];
+	}
+
+	// Writer side. Hands the back buffer over to the reader and takes a free one in its place.
+	void publish() {
+		backIndex = sharedIndex.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Reader side. Picks up the latest published buffer. Returns false if nothing was published since the last call.
+	bool update() {
+		if ((sharedIndex.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+			return false;
+		}
+		frontIndex = sharedIndex.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	// Reader side. The buffer picked up by the last update(), left alone by the writer.
+	const T& getFront() const {
+		return buffers[frontIndex];
+	}
+
+private:
+	TripleBuffer(const TripleBuffer &);
+	TripleBuffer& operator=(const TripleBuffer &);
+
+	// The shared index carries a flag telling whether the buffer was published after the reader's last update().
+	static const int INDEX_MASK = 3;
+	static const int FRESH_BIT = 4;
+
+	T buffers[3];
+
+	int backIndex; // only touched by the writer
+	std::atomic<int> sharedIndex;
+	int frontIndex; // only touched by the reader
+};
+
+}; // namespace cell
+}; // namespace chaos